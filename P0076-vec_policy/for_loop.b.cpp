@@ -0,0 +1,196 @@
+/* for_loop.b.cpp                                                     -*-C++-*-
+ *
+ * Copyright (C) 2016 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Compares the execution policies of `for_loop` on three kernels:
+ *
+ *  - `stencil`: a three-point smoothing stencil over `float`s, with no
+ *    loop-carried dependencies.  The input and output are passed by pointer,
+ *    so a serial loop cannot be vectorized without a run-time alias check.
+ *  - `histogram`: a bin is computed from each input (a square root and a
+ *    scale), then that bin's count is incremented.  Only the increment
+ *    depends on other iterations; under `vec`, it is made an
+ *    `ordered_update` or a `vec_off` region.
+ *  - `sum`: the sum of the input, computed by a serial loop, with a
+ *    `reduction` argument under each vectorizing or parallel policy, and
+ *    with an atomic accumulator under `par`.
+ *
+ * Each row is the best of `reps` runs, in nanoseconds per element.
+ *
+ * Usage: for_loop.b [elements [reps]]   (default: 1000000 20)
+ */
+
+#include "for_loop.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace xpar = std::experimental::parallel;
+namespace chrono = std::chrono;
+
+std::size_t elements = 1000000;
+int         reps     = 20;
+
+// Print the best time of `reps` calls to `f`, in nanoseconds per element.
+template <typename F>
+void row(const char* kernel, const char* policy, F f)
+{
+    double best = 1e300;
+    for (int r = 0; r < reps; ++r) {
+        auto start = chrono::steady_clock::now();
+        f();
+        chrono::duration<double, std::nano> elapsed =
+            chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / elements);
+    }
+    std::cout << "| " << kernel << " | " << policy << " | " << best << " |"
+              << std::endl;
+}
+
+template <typename ExPolicy>
+[[gnu::noinline]]
+void stencil(const ExPolicy& exec, const float* in, float* out, int n)
+{
+    xpar::for_loop(exec, 1, n - 1, [=](int i) {
+        out[i] = 0.25f * in[i - 1] + 0.5f * in[i] + 0.25f * in[i + 1];
+    });
+}
+
+constexpr int bins = 64;
+
+inline int bin_of(float x)
+{
+    return std::min(int(std::sqrt(x) * bins), bins - 1);
+}
+
+[[gnu::noinline]]
+void histogram_seq(const float* in, int* hist, int n)
+{
+    xpar::for_loop(xpar::seq, 0, n, [=](int i) { ++hist[bin_of(in[i])]; });
+}
+
+[[gnu::noinline]]
+void histogram_ordered_update(const float* in, int* hist, int n)
+{
+    xpar::for_loop(xpar::vec, 0, n, [=](auto cookie, int i) {
+        int b = bin_of(in[i]);
+        ++cookie.ordered_update(hist[b]);
+    });
+}
+
+[[gnu::noinline]]
+void histogram_vec_off(const float* in, int* hist, int n)
+{
+    xpar::for_loop(xpar::vec, 0, n, [=](auto cookie, int i) {
+        int b = bin_of(in[i]);
+        cookie.vec_off([=] { ++hist[b]; });
+    });
+}
+
+[[gnu::noinline]]
+double sum_seq(const float* in, int n)
+{
+    double sum = 0;
+    xpar::for_loop(xpar::seq, 0, n, [&](int i) { sum += in[i]; });
+    return sum;
+}
+
+template <typename ExPolicy>
+[[gnu::noinline]]
+double sum_reduction(const ExPolicy& exec, const float* in, int n)
+{
+    double sum = 0;
+    xpar::for_loop(exec, 0, n, xpar::reduction(sum, 0.0, std::plus<>()),
+                   [=](int i, double& acc) { acc += in[i]; });
+    return sum;
+}
+
+[[gnu::noinline]]
+double sum_atomic(const float* in, int n)
+{
+    std::atomic<double> sum = 0;
+    xpar::for_loop(xpar::par, 0, n, [&](int i) {
+        sum.fetch_add(in[i], std::memory_order_relaxed);
+    });
+    return sum;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        elements = std::atol(argv[1]);
+    if (argc > 2)
+        reps = std::atoi(argv[2]);
+
+    int n = int(elements);
+    std::vector<float> in(n), out(n);
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (float& x : in)
+        x = dist(gen);
+
+    std::cout << "| Kernel | Policy | Time (ns/elem) |\n"
+              << "| ------ | ------ | -------------: |" << std::endl;
+
+    std::vector<float> expected(n);
+    auto check_stencil = [&] {
+        if (out != expected)
+            std::abort();
+    };
+    stencil(xpar::seq, in.data(), expected.data(), n);
+    row("`stencil`", "`seq`",
+        [&] { stencil(xpar::seq, in.data(), out.data(), n); });
+    check_stencil();
+    row("`stencil`", "`vec`",
+        [&] { stencil(xpar::vec, in.data(), out.data(), n); });
+    check_stencil();
+    row("`stencil`", "`unseq`",
+        [&] { stencil(xpar::unseq, in.data(), out.data(), n); });
+    check_stencil();
+
+    std::vector<int> hist(bins), expected_hist(bins);
+    histogram_seq(in.data(), expected_hist.data(), n);
+    auto histogram = [&](const char* policy, auto f) {
+        row("`histogram`", policy, [&] {
+            std::fill(hist.begin(), hist.end(), 0);
+            f(in.data(), hist.data(), n);
+        });
+        if (hist != expected_hist)
+            std::abort();
+    };
+    histogram("`seq`", histogram_seq);
+    histogram("`vec` + `ordered_update`", histogram_ordered_update);
+    histogram("`vec` + `vec_off`", histogram_vec_off);
+
+    // The input's elements are multiples of 2^-24, so every order of
+    // summation gives the same `double`.
+    for (float& x : in)
+        x = std::ldexp(std::floor(std::ldexp(x, 24)), -24);
+    double expected_sum = sum_seq(in.data(), n);
+    auto sum = [&](const char* policy, auto f) {
+        double result = 0;
+        row("`sum`", policy, [&] { result = f(); });
+        if (result != expected_sum)
+            std::abort();
+    };
+    sum("`seq`", [&] { return sum_seq(in.data(), n); });
+    sum("`unseq` + `reduction`",
+        [&] { return sum_reduction(xpar::unseq, in.data(), n); });
+    sum("`par` + atomic", [&] { return sum_atomic(in.data(), n); });
+    sum("`par` + `reduction`",
+        [&] { return sum_reduction(xpar::par, in.data(), n); });
+    sum("`par_unseq` + `reduction`",
+        [&] { return sum_reduction(xpar::par_unseq, in.data(), n); });
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,818 @@
+/* for_loop.h                                                         -*-C++-*-
+ *
+ * Copyright (C) 2016 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Prototype of `for_loop` and the execution policies of P0076, including the
+ * `vector_execution_policy` cookie through which a loop body can request
+ * `vec_off` and `ordered_update` regions.
+ *
+ * Under `vec`, `unseq` and `par_unseq`, a loop over integers or random-access
+ * iterators is executed as an OpenMP `simd` loop, whose semantics (lanes in
+ * lock step, statements in lexical order) are those of `vec`.  A `vec_off`
+ * region is an OpenMP `ordered simd` region: only the marked region is
+ * executed one lane at a time, in lane order.  Compile with `-fopenmp-simd`
+ * (or `-fopenmp`); otherwise, every loop is executed serially, which is also
+ * a valid execution under each policy.
+ *
+ * Under `par` and `par_unseq`, such a loop is divided into chunks, which are
+ * run on the threads of `thread_pool` (under `par_unseq`, each chunk as a
+ * `simd` loop).  The policy's `loop_schedule`, set with `with`, chooses how:
+ *
+ *  - `static_chunks` (the default) gives each thread one contiguous block
+ *    or, if `grain` is nonzero, chunks of `grain` iterations dealt round
+ *    robin, and
+ *  - `guided_chunks` has each thread repeatedly claim the next chunk, of
+ *    `remaining / (2 * threads)` iterations but no fewer than `grain`.
+ *
+ * Either way, the chunk boundaries depend only on the trip count, `grain`
+ * and the number of threads, never on timing.  As for the standard parallel
+ * algorithms, an exception escaping the body of a parallel loop calls
+ * `std::terminate`.
+ *
+ * As in the Parallelism TS, `reduction(var, identity, op)` and
+ * `induction(var, stride)` arguments may precede the body, which then takes
+ * a reference to a private accumulator for each reduction and the current
+ * value of each induction, after the index.  Each SIMD lane and each thread
+ * has its own accumulators, which are combined pairwise, in a tree, after
+ * the loop.  The grouping of those combinations depends only on the chunk
+ * boundaries, except under `guided_chunks`, where it also depends on which
+ * thread claimed each chunk; a reduction whose operation is not associative
+ * (e.g., floating-point addition) therefore gives the same result on every
+ * run except under `guided_chunks`.
+ */
+
+#pragma once
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace std {
+namespace experimental {
+namespace parallel {
+inline namespace v2 {
+
+struct sequential_execution_policy
+{
+    struct cookie_type { };
+    cookie_type make_cookie() const { return cookie_type{}; }
+};
+
+struct vector_execution_policy
+{
+    struct cookie_type {
+        template <typename F>
+        auto vec_off(F&& f) const -> decltype(f());
+
+        template <class T> class ordered_update_t;
+
+        template <class T>
+        ordered_update_t<T> ordered_update(T& ref) const;
+    };
+    cookie_type make_cookie() const { return cookie_type{}; }
+};
+
+namespace detail {
+
+// Holds the result of a call made within an OpenMP structured block, which
+// cannot be left by a `return` statement.
+template <typename R>
+class block_result
+{
+    optional<R> m_value;
+
+public:
+    template <typename F>
+    void call(F& f) { m_value.emplace(f()); }
+
+    R get() { return std::move(*m_value); }
+};
+
+template <typename R>
+class block_result<R&>
+{
+    R* m_ptr = nullptr;
+
+public:
+    template <typename F>
+    void call(F& f) { m_ptr = &f(); }
+
+    R& get() { return *m_ptr; }
+};
+
+template <>
+class block_result<void>
+{
+public:
+    template <typename F>
+    void call(F& f) { f(); }
+
+    void get() { }
+};
+
+} // close namespace detail
+
+template <typename F>
+inline
+auto vector_execution_policy::cookie_type::vec_off(F&& f) const -> decltype(f())
+{
+    detail::block_result<decltype(f())> result;
+#pragma omp ordered simd
+    result.call(f);
+    return result.get();
+}
+
+template<class T>
+class vector_execution_policy::cookie_type::ordered_update_t {
+  typedef vector_execution_policy::cookie_type cookie_type;
+  const cookie_type* cookie;
+  T& ref;
+public:
+  ordered_update_t(const cookie_type* c, T& loc) : cookie(c), ref(loc) { }
+  template <class U>
+  auto operator=(U rhs) { return cookie->vec_off([&]{ return ref=std::move(rhs); }); }
+  template <class U>
+    auto operator+=(U rhs){ return cookie->vec_off([&]{return ref+=std::move(rhs);}); }
+  template <class U>
+    auto operator-=(U rhs){ return cookie->vec_off([&]{return ref-=std::move(rhs);}); }
+  template <class U>
+    auto operator*=(U rhs){ return cookie->vec_off([&]{return ref*=std::move(rhs);}); }
+  template <class U>
+    auto operator/=(U rhs){ return cookie->vec_off([&]{return ref/=std::move(rhs);}); }
+  template <class U>
+    auto operator%=(U rhs){ return cookie->vec_off([&]{return ref%=std::move(rhs);}); }
+  template <class U>
+    auto operator>>=(U rhs){return cookie->vec_off([&]{return ref>>=std::move(rhs);});}
+  template <class U>
+    auto operator<<=(U rhs){return cookie->vec_off([&]{return ref<<=std::move(rhs);});}
+  template <class U>
+    auto operator&=(U rhs){ return cookie->vec_off([&]{return ref&=std::move(rhs);}); }
+  template <class U>
+    auto operator^=(U rhs){ return cookie->vec_off([&]{return ref^=std::move(rhs);}); }
+  template <class U>
+    auto operator|=(U rhs){ return cookie->vec_off([&]{return ref|=std::move(rhs);}); }
+  auto operator++() { return cookie->vec_off([&]{ return ++ref; }); }
+  auto operator++(int) { return cookie->vec_off([&]{ return ref++; }); }
+  auto operator--() { return cookie->vec_off([&]{ return --ref; }); }
+  auto operator--(int) { return cookie->vec_off([&]{ return ref--; }); }
+};
+
+template <class T>
+inline
+vector_execution_policy::cookie_type::ordered_update_t<T>
+vector_execution_policy::cookie_type::ordered_update(T& ref) const
+{
+    return ordered_update_t<T>(this, ref);
+}
+
+struct unsequenced_execution_policy
+{
+    struct cookie_type { };
+    cookie_type make_cookie() const { return cookie_type{}; }
+};
+
+// How the iterations of a `par` or `par_unseq` loop are divided among threads.
+struct loop_schedule
+{
+    enum kind_t { static_chunks, guided_chunks };
+
+    kind_t      kind    = static_chunks;
+    size_t      grain   = 0;  // Chunk size (static) or minimum (guided).
+    unsigned    threads = 0;  // Most threads to use; 0 for the whole pool.
+};
+
+struct parallel_execution_policy
+{
+    struct cookie_type { };
+    cookie_type make_cookie() const { return cookie_type{}; }
+
+    // A copy of this policy whose loops use the schedule `s`.
+    constexpr parallel_execution_policy with(loop_schedule s) const
+    {
+        parallel_execution_policy p;
+        p.m_schedule = s;
+        return p;
+    }
+    constexpr const loop_schedule& schedule() const { return m_schedule; }
+
+private:
+    loop_schedule m_schedule;
+};
+struct parallel_unsequenced_execution_policy
+{
+    struct cookie_type { };
+    cookie_type make_cookie() const { return cookie_type{}; }
+
+    // A copy of this policy whose loops use the schedule `s`.
+    constexpr parallel_unsequenced_execution_policy with(loop_schedule s) const
+    {
+        parallel_unsequenced_execution_policy p;
+        p.m_schedule = s;
+        return p;
+    }
+    constexpr const loop_schedule& schedule() const { return m_schedule; }
+
+private:
+    loop_schedule m_schedule;
+};
+
+constexpr sequential_execution_policy seq{};
+constexpr vector_execution_policy vec{};
+constexpr unsequenced_execution_policy unseq{};
+constexpr parallel_execution_policy par{};
+constexpr parallel_unsequenced_execution_policy par_unseq{};
+
+namespace detail {
+
+// A `reduction` argument to `for_loop`.  Each thread and SIMD lane
+// accumulates into a private copy of `identity`; after the loop, the copies
+// are combined with `op`, and the result is combined into `var`.
+template <typename T, typename Op>
+class reduction_object
+{
+    T&  m_var;
+    T   m_identity;
+    Op  m_op;
+
+public:
+    using state_type = T;
+
+    reduction_object(T& var, const T& identity, Op op)
+        : m_var(var), m_identity(identity), m_op(std::move(op)) { }
+
+    state_type make_state() const { return m_identity; }
+
+    template <typename Diff>
+    T& arg(state_type& acc, Diff) const { return acc; }
+
+    void combine(state_type& a, state_type& b) const
+        { a = m_op(std::move(a), std::move(b)); }
+
+    template <typename Diff>
+    void finish(state_type& acc, Diff) const
+        { m_var = m_op(std::move(m_var), std::move(acc)); }
+};
+
+// The private state of an argument that needs none.
+struct no_state { };
+
+// An `induction` argument to `for_loop`: iteration `k` of the loop, counting
+// from zero, is passed `start + stride * k`.  If the argument was a
+// modifiable lvalue, it is set to `start + stride * n` after a loop of `n`
+// iterations.
+template <typename T, typename S>
+class induction_object
+{
+    T   m_start;
+    S   m_stride;
+    T*  m_var;
+
+public:
+    using state_type = no_state;
+
+    induction_object(T start, S stride, T* var)
+        : m_start(start), m_stride(stride), m_var(var) { }
+
+    state_type make_state() const { return { }; }
+
+    template <typename Diff>
+    T arg(state_type&, Diff k) const { return T(m_start + m_stride * k); }
+
+    void combine(state_type&, state_type&) const { }
+
+    template <typename Diff>
+    void finish(state_type&, Diff n) const
+    {
+        if (m_var)
+            *m_var = T(m_start + m_stride * n);
+    }
+};
+
+} // close namespace detail
+
+template <class T, class BinaryOperation>
+detail::reduction_object<T, BinaryOperation>
+reduction(T& var, const T& identity, BinaryOperation combiner)
+{
+    return { var, identity, std::move(combiner) };
+}
+
+template <class T, class S>
+detail::induction_object<decay_t<T>, S> induction(T&& var, S stride)
+{
+    if constexpr (is_lvalue_reference_v<T> &&
+                  !is_const_v<remove_reference_t<T>>)
+        return { var, stride, &var };
+    else
+        return { var, stride, nullptr };
+}
+
+template <class T>
+detail::induction_object<decay_t<T>, int> induction(T&& var)
+{
+    return induction(std::forward<T>(var), 1);
+}
+
+namespace detail {
+
+// True if iterations of a loop under `ExPolicy` may run in SIMD lanes.
+template <typename ExPolicy>
+constexpr bool is_simd_policy =
+    is_same_v<ExPolicy, vector_execution_policy>      ||
+    is_same_v<ExPolicy, unsequenced_execution_policy> ||
+    is_same_v<ExPolicy, parallel_unsequenced_execution_policy>;
+
+// True if a loop under `ExPolicy` may run on more than one thread.
+template <typename ExPolicy>
+constexpr bool is_parallel_policy =
+    is_same_v<ExPolicy, parallel_execution_policy> ||
+    is_same_v<ExPolicy, parallel_unsequenced_execution_policy>;
+
+// True if a loop over `I` has a trip count that is known on entry and can
+// therefore be expressed as an OpenMP canonical loop.
+template <typename I>
+constexpr bool is_simd_index = integral<I> || random_access_iterator<I>;
+
+// The private state of the reduction and induction arguments `E...`, for one
+// thread or SIMD lane.
+template <typename... E>
+using loop_states = tuple<typename E::state_type...>;
+
+// The number of private copies of `loop_states` kept by a loop, one for each
+// SIMD lane if it runs as a SIMD loop with reductions or inductions.
+template <bool Simd, typename... E>
+constexpr size_t lane_count = (Simd && sizeof...(E) > 0) ? 8 : 1;
+
+template <bool Simd, typename... E>
+using lane_states = array<loop_states<E...>, lane_count<Simd, E...>>;
+
+template <bool Simd, typename... E>
+lane_states<Simd, E...> make_lane_states(const tuple<E...>& extras)
+{
+    auto make = [&] {
+        return apply([](const E&... e) {
+            return loop_states<E...>(e.make_state()...);
+        }, extras);
+    };
+    return [&]<size_t... L>(index_sequence<L...>) {
+        return lane_states<Simd, E...>{ { ((void) L, make())... } };
+    }(make_index_sequence<lane_count<Simd, E...>>{});
+}
+
+// Combine `states[0, n)` into `states[0]`, pairwise, so that the grouping of
+// the combinations depends only on `n`.
+template <typename... E>
+void tree_combine(const tuple<E...>& extras, loop_states<E...>* states,
+                  size_t n)
+{
+    for (size_t step = 1; step < n; step *= 2) {
+        for (size_t i = 0; i + step < n; i += 2 * step) {
+            [&]<size_t... J>(index_sequence<J...>) {
+                (get<J>(extras).combine(get<J>(states[i]),
+                                        get<J>(states[i + step])), ...);
+            }(index_sequence_for<E...>{});
+        }
+    }
+}
+
+template <typename Diff, typename... E>
+void finish(const tuple<E...>& extras, loop_states<E...>& states, Diff n)
+{
+    [&]<size_t... J>(index_sequence<J...>) {
+        (get<J>(extras).finish(get<J>(states), n), ...);
+    }(index_sequence_for<E...>{});
+}
+
+// The index of iteration `k` of a loop that starts at `first` and advances by
+// `stride` (by one if `Stride` is `unit_stride`).
+struct unit_stride { };
+
+template <typename I, typename Stride = unit_stride>
+struct index_map
+{
+    using difference_type = iter_difference_t<I>;
+
+    I       first;
+    Stride  stride;
+
+    I operator()(difference_type k) const
+    {
+        if constexpr (is_same_v<Stride, unit_stride>)
+            return I(first + k);
+        else
+            return I(first + k * stride);
+    }
+};
+
+// Call `body` for iteration `k`, with index `i`, passing the cookie if the
+// body accepts one, then `i`, then an argument for each of `extras`.
+template <typename Cookie, typename F, typename I, typename Diff,
+          typename... E>
+inline void invoke_body(const Cookie& cookie, F& body, I i, Diff k,
+                        const tuple<E...>& extras, loop_states<E...>& states)
+{
+    [&]<size_t... J>(index_sequence<J...>) {
+        if constexpr (is_invocable_v<F&, const Cookie&, I,
+                                     decltype(get<J>(extras).arg(
+                                                  get<J>(states), k))...>)
+            body(cookie, i, get<J>(extras).arg(get<J>(states), k)...);
+        else
+            body(i, get<J>(extras).arg(get<J>(states), k)...);
+    }(index_sequence_for<E...>{});
+}
+
+// Run iterations `[lo, hi)` of a loop whose indexes are given by `index`.  A
+// SIMD loop with reductions or inductions runs in blocks of `lane_count`
+// iterations, each lane using its own private state.
+template <bool Simd, typename Cookie, typename Index, typename F,
+          typename... E>
+inline void run_range(const Cookie& cookie, const Index& index,
+                      typename Index::difference_type lo,
+                      typename Index::difference_type hi, F& body,
+                      const tuple<E...>& extras,
+                      lane_states<Simd, E...>& lanes)
+{
+    using diff_t = typename Index::difference_type;
+    constexpr diff_t lanes_n = lane_count<Simd, E...>;
+
+    if constexpr (Simd && lanes_n > 1) {
+        diff_t k = lo;
+        for ( ; hi - k >= lanes_n; k += lanes_n) {
+#pragma omp simd
+            for (diff_t l = 0; l < lanes_n; ++l)
+                invoke_body(cookie, body, index(k + l), k + l, extras,
+                            lanes[l]);
+        }
+        for (diff_t l = 0; l < hi - k; ++l)
+            invoke_body(cookie, body, index(k + l), k + l, extras, lanes[l]);
+    }
+    else if constexpr (Simd) {
+#pragma omp simd
+        for (diff_t k = lo; k < hi; ++k)
+            invoke_body(cookie, body, index(k), k, extras, lanes[0]);
+    }
+    else {
+        for (diff_t k = lo; k < hi; ++k)
+            invoke_body(cookie, body, index(k), k, extras, lanes[0]);
+    }
+}
+
+// Run the `n` iterations of a loop whose indexes are given by `index` on the
+// thread pool, and return the combined private state of all threads and
+// lanes.
+template <bool Simd, typename Cookie, typename Index, typename F,
+          typename... E>
+loop_states<E...> run_parallel(const loop_schedule& sched,
+                               const Cookie& cookie, const Index& index,
+                               typename Index::difference_type n, F& body,
+                               const tuple<E...>& extras)
+{
+    using diff_t = typename Index::difference_type;
+
+    thread_pool& pool = thread_pool::instance();
+    diff_t threads = pool.size();
+    if (sched.threads)
+        threads = min(threads, diff_t(sched.threads));
+    threads = min(threads, n);
+    const diff_t grain = diff_t(sched.grain);
+
+    if (threads <= 1) {
+        auto lanes = make_lane_states<Simd>(extras);
+        run_range<Simd>(cookie, index, 0, n, body, extras, lanes);
+        tree_combine(extras, lanes.data(), lanes.size());
+        return std::move(lanes[0]);
+    }
+
+    // Each thread combines its lanes into its own slot of `results`.
+    vector<loop_states<E...>> results;
+    results.reserve(threads);
+    for (diff_t t = 0; t < threads; ++t)
+        results.push_back(make_lane_states<false>(extras)[0]);
+    auto run_share = [&](unsigned t, auto chunks) {
+        auto lanes = make_lane_states<Simd>(extras);
+        chunks([&](diff_t lo, diff_t hi) {
+            run_range<Simd>(cookie, index, lo, hi, body, extras, lanes);
+        });
+        tree_combine(extras, lanes.data(), lanes.size());
+        results[t] = std::move(lanes[0]);
+    };
+
+    if (loop_schedule::static_chunks == sched.kind) {
+        auto job = [&](unsigned t) {
+            run_share(t, [&](auto run_chunk) {
+                if (grain > 0) {
+                    for (diff_t lo = t * grain; lo < n;
+                         lo += threads * grain)
+                        run_chunk(lo, min(n, lo + grain));
+                }
+                else {
+                    // Blocks differ in size by at most one iteration.
+                    diff_t q = n / threads, r = n % threads;
+                    diff_t lo = t * q + min(diff_t(t), r);
+                    run_chunk(lo, lo + q + (diff_t(t) < r));
+                }
+            });
+        };
+        pool.run(unsigned(threads), job);
+    }
+    else {
+        // Each chunk's size is computed from where it starts, so the
+        // sequence of chunks is the same whichever thread claims each one.
+        atomic<diff_t> next{0};
+        auto job = [&](unsigned t) {
+            run_share(t, [&](auto run_chunk) {
+                diff_t lo = next.load(memory_order_relaxed), hi;
+                for (;;) {
+                    do {
+                        if (lo >= n)
+                            return;
+                        hi = lo + max({ diff_t(1), grain,
+                                        (n - lo) / (2 * threads) });
+                        hi = min(hi, n);
+                    } while (!next.compare_exchange_weak(
+                                 lo, hi, memory_order_relaxed));
+                    run_chunk(lo, hi);
+                    lo = next.load(memory_order_relaxed);
+                }
+            });
+        };
+        pool.run(unsigned(threads), job);
+    }
+
+    tree_combine(extras, results.data(), results.size());
+    return std::move(results[0]);
+}
+
+// Advance `it` by `stride`, but not past `last`.  A negative `stride`
+// requires a bidirectional iterator.
+template <typename I, typename Stride>
+void advance_toward(I& it, const I& last, Stride stride)
+{
+    if constexpr (is_same_v<Stride, unit_stride>)
+        ++it;
+    else {
+        if constexpr (!bidirectional_iterator<I>)
+            assert(stride > 0 && "negative stride over a forward iterator");
+        ranges::advance(it, iter_difference_t<I>(stride), last);
+    }
+}
+
+// The number of iterations of a loop from `first` toward `last` by `stride`.
+template <typename I, typename Stride>
+iter_difference_t<I> trip_count(const I& first, const I& last, Stride stride)
+{
+    using diff_t = iter_difference_t<I>;
+    diff_t distance = last - first;
+    if constexpr (is_same_v<Stride, unit_stride>)
+        return distance;
+    else if (stride > 0)
+        return distance > 0 ? (distance - 1) / diff_t(stride) + 1 : 0;
+    else
+        return distance < 0 ? (distance + 1) / diff_t(stride) + 1 : 0;
+}
+
+template <typename ExPolicy, typename I, typename Stride, typename F,
+          typename... E>
+void for_loop_imp(const ExPolicy& exec, I first, I last, Stride stride,
+                  F& body, const tuple<E...>& extras)
+{
+    const auto cookie = exec.make_cookie();
+    constexpr bool simd = is_simd_policy<ExPolicy>;
+    if constexpr (!is_simd_index<I>) {
+        auto states = make_lane_states<false>(extras);
+        iter_difference_t<I> k = 0;
+        for ( ; first != last; advance_toward(first, last, stride), ++k)
+            invoke_body(cookie, body, first, k, extras, states[0]);
+        finish(extras, states[0], k);
+    }
+    else {
+        const index_map<I, Stride> index{ first, stride };
+        const iter_difference_t<I> n = trip_count(first, last, stride);
+        if constexpr (is_parallel_policy<ExPolicy>) {
+            auto states = run_parallel<simd>(exec.schedule(), cookie, index,
+                                             n, body, extras);
+            finish(extras, states, n);
+        }
+        else {
+            auto lanes = make_lane_states<simd>(extras);
+            run_range<simd>(cookie, index, 0, n, body, extras, lanes);
+            tree_combine(extras, lanes.data(), lanes.size());
+            finish(extras, lanes[0], n);
+        }
+    }
+}
+
+// Split `rest`, the arguments of `for_loop` after the bounds, into the
+// reductions and inductions, which are copied, and the body.
+template <typename... Rest, typename Run>
+void split_loop_args(Run run, Rest&... rest)
+{
+    static_assert(sizeof...(Rest) > 0, "for_loop requires a loop body");
+    auto args = tie(rest...);
+    constexpr size_t n_extras = sizeof...(Rest) - 1;
+    [&]<size_t... J>(index_sequence<J...>) {
+        using extras_t = tuple<decay_t<tuple_element_t<J, tuple<Rest...>>>...>;
+        run(get<n_extras>(args), extras_t(get<J>(args)...));
+    }(make_index_sequence<n_extras>{});
+}
+
+} // close namespace detail
+
+// Run `body` for each index in `[first, last)`.  The arguments before the
+// body are `reduction` and `induction` objects, in the order in which the
+// body takes the corresponding arguments after the index.
+template <typename ExPolicy, typename I, typename... Rest>
+void for_loop(ExPolicy&& exec, decay_t<I> first, I last, Rest&&... rest)
+{
+    detail::split_loop_args([&](auto& body, const auto& extras) {
+        detail::for_loop_imp<remove_cvref_t<ExPolicy>, decay_t<I>>(
+            exec, first, last, detail::unit_stride{ }, body, extras);
+    }, rest...);
+}
+
+// Run `body` for `first`, `first + stride`, ..., for each index before
+// `last` (after `last`, if `stride` is negative).  `stride` must not be
+// zero.
+template <typename ExPolicy, typename I, typename S, typename... Rest>
+void for_loop_strided(ExPolicy&& exec, decay_t<I> first, I last, S stride,
+                      Rest&&... rest)
+{
+    detail::split_loop_args([&](auto& body, const auto& extras) {
+        detail::for_loop_imp<remove_cvref_t<ExPolicy>, decay_t<I>>(
+            exec, first, last, stride, body, extras);
+    }, rest...);
+}
+
+// The extents of an N-dimensional iteration space, in the manner of
+// `std::dextents`: a loop over `loop_extents(e0, ..., eN-1)` runs its body
+// for every index `(i0, ..., iN-1)` in `[0, e0) x ... x [0, eN-1)`.  Any type
+// with the same `index_type`, `rank()` and `extent(r)` members, such as
+// `std::extents`, can be used instead.
+template <typename IndexType, size_t Rank>
+class loop_extents
+{
+    array<IndexType, Rank> m_extents;
+
+public:
+    using index_type = IndexType;
+
+    template <typename... E>
+        requires (sizeof...(E) == Rank &&
+                  (is_convertible_v<E, IndexType> && ...))
+    constexpr explicit loop_extents(E... e) : m_extents{ IndexType(e)... } { }
+
+    static constexpr size_t rank() { return Rank; }
+    constexpr index_type extent(size_t r) const { return m_extents[r]; }
+};
+
+template <typename... E>
+loop_extents(E...) -> loop_extents<common_type_t<E...>, sizeof...(E)>;
+
+// The tile size for each dimension of an N-dimensional loop, zero leaving a
+// dimension untiled.
+template <size_t Rank>
+struct loop_tiling
+{
+    array<size_t, Rank> sizes;
+};
+
+template <typename... S>
+constexpr loop_tiling<sizeof...(S)> tile(S... sizes)
+{
+    return { { size_t(sizes)... } };
+}
+
+namespace detail {
+
+template <typename E>
+concept extents_like = requires(const E& e, size_t r) {
+    typename E::index_type;
+    { E::rank() } -> convertible_to<size_t>;
+    { e.extent(r) } -> convertible_to<typename E::index_type>;
+};
+
+template <typename Cookie, typename F, typename... Ix>
+inline void invoke_md_body(const Cookie& cookie, F& body, Ix... ix)
+{
+    if constexpr (is_invocable_v<F&, const Cookie&, Ix...>)
+        body(cookie, ix...);
+    else
+        body(ix...);
+}
+
+// Run the iterations of the tile `[lo[d], hi[d])`, for each dimension `d`,
+// from dimension `D` inward.  `outer` holds the indexes of the enclosing
+// dimensions.
+template <bool Simd, size_t D, typename Cookie, typename F, typename Index,
+          size_t Rank, typename... Outer>
+inline void run_tile(const Cookie& cookie, F& body,
+                     const array<Index, Rank>& lo,
+                     const array<Index, Rank>& hi, Outer... outer)
+{
+    const Index l = lo[D], h = hi[D];
+    if constexpr (D + 1 < Rank) {
+        for (Index i = l; i < h; ++i)
+            run_tile<Simd, D + 1>(cookie, body, lo, hi, outer..., i);
+    }
+    else if constexpr (Simd) {
+#pragma omp simd
+        for (Index i = l; i < h; ++i)
+            invoke_md_body(cookie, body, outer..., i);
+    }
+    else {
+        for (Index i = l; i < h; ++i)
+            invoke_md_body(cookie, body, outer..., i);
+    }
+}
+
+// Run an N-dimensional loop tile by tile, with the tiles in row-major order.
+// A parallel policy divides the tiles among threads.
+template <typename ExPolicy, typename Ext, typename F>
+void for_loop_md(const ExPolicy& exec, const Ext& ext,
+                 const loop_tiling<Ext::rank()>& tiling, F& body)
+{
+    using index_t = typename Ext::index_type;
+    constexpr size_t rank = Ext::rank();
+    constexpr bool simd = is_simd_policy<ExPolicy>;
+    const auto cookie = exec.make_cookie();
+
+    array<index_t, rank> size, count;
+    ptrdiff_t tiles = 1;
+    for (size_t d = 0; d < rank; ++d) {
+        index_t e = ext.extent(d);
+        size[d] = tiling.sizes[d] ? index_t(tiling.sizes[d])
+                                  : max(e, index_t(1));
+        count[d] = (e + size[d] - 1) / size[d];
+        tiles *= count[d];
+    }
+
+    auto run_one = [&](ptrdiff_t t) {
+        array<index_t, rank> lo, hi;
+        for (size_t d = rank; d-- > 0; ) {
+            lo[d] = index_t(t % count[d] * size[d]);
+            hi[d] = min(index_t(ext.extent(d) - lo[d]), size[d]) + lo[d];
+            t /= count[d];
+        }
+        run_tile<simd, 0>(cookie, body, lo, hi);
+    };
+
+    if constexpr (is_parallel_policy<ExPolicy>)
+        run_parallel<false>(exec.schedule(),
+                            sequential_execution_policy::cookie_type{ },
+                            index_map<ptrdiff_t>{ 0, {} }, tiles, run_one,
+                            tuple<>{ });
+    else {
+        for (ptrdiff_t t = 0; t < tiles; ++t)
+            run_one(t);
+    }
+}
+
+} // close namespace detail
+
+// Run `body` for each index in the N-dimensional space `ext`, passing the
+// cookie, if the body accepts one, then one index per dimension.  The space
+// is divided into tiles of the sizes given by `tiling`, which run one after
+// another in row-major order, or on several threads under a parallel policy.
+// Within a tile, the innermost dimension is a SIMD loop under `vec`, `unseq`
+// and `par_unseq`.
+template <typename ExPolicy, detail::extents_like Ext, typename F>
+void for_loop(ExPolicy&& exec, const Ext& ext,
+              const loop_tiling<Ext::rank()>& tiling, F&& body)
+{
+    detail::for_loop_md(exec, ext, tiling, body);
+}
+
+// Without a tiling, each index of the outermost dimension is its own tile,
+// so the iterations run in the order of nested loops.
+template <typename ExPolicy, detail::extents_like Ext, typename F>
+void for_loop(ExPolicy&& exec, const Ext& ext, F&& body)
+{
+    using index_t = typename Ext::index_type;
+    if constexpr (Ext::rank() == 1)
+        for_loop(exec, index_t(0), ext.extent(0), body);
+    else {
+        loop_tiling<Ext::rank()> rows{ };
+        rows.sizes[0] = 1;
+        detail::for_loop_md(exec, ext, rows, body);
+    }
+}
+
+} // close namespace v2
+} // close namespace parallel
+} // close namespace experimental
+} // close namespace std
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
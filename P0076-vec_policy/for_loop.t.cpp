@@ -0,0 +1,361 @@
+/* for_loop.t.cpp                                                     -*-C++-*-
+ *
+ * Copyright (C) 2016 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ */
+
+#include "for_loop.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <forward_list>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace xpar = std::experimental::parallel;
+
+constexpr int N = 1000;
+
+// Every iteration is executed exactly once under `exec`, for integer and
+// iterator indexes, with and without a cookie.
+template <typename ExPolicy>
+void test_policy(const ExPolicy& exec)
+{
+    std::vector<int> a(N, -1);
+    xpar::for_loop(exec, 0, N, [&](int i) { a[i] = 2 * i; });
+    for (int i = 0; i < N; ++i)
+        assert(2 * i == a[i]);
+
+    xpar::for_loop(exec, 0, N, [&](auto, int i) { a[i] = 3 * i; });
+    for (int i = 0; i < N; ++i)
+        assert(3 * i == a[i]);
+
+    xpar::for_loop(exec, 7u, 7u, [&](unsigned) { assert(false); });
+
+    // Random-access iterators are vectorized; other iterators are not.
+    xpar::for_loop(exec, a.begin(), a.end(),
+                   [](std::vector<int>::iterator it) { *it += 1; });
+    std::list<int> l(10, 5);
+    xpar::for_loop(exec, l.begin(), l.end(),
+                   [](std::list<int>::iterator it) { *it += 1; });
+    for (int i = 0; i < N; ++i)
+        assert(3 * i + 1 == a[i]);
+    for (int x : l)
+        assert(6 == x);
+}
+
+// Each schedule runs every iteration once, on as many threads as it asks
+// for, and a parallel loop nested in another runs serially.
+void test_schedules()
+{
+    using sched = xpar::loop_schedule;
+    for (sched s : { sched{ },
+                     sched{ sched::static_chunks, 7 },
+                     sched{ sched::guided_chunks },
+                     sched{ sched::guided_chunks, 5 },
+                     sched{ sched::guided_chunks, 0, 2 } }) {
+        test_policy(xpar::par.with(s));
+        test_policy(xpar::par_unseq.with(s));
+    }
+
+    unsigned threads = xpar::thread_pool::instance().size();
+    std::mutex mutex;
+    std::set<std::thread::id> ids;
+    xpar::for_loop(xpar::par, 0, 100, [&](int) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ids.insert(std::this_thread::get_id());
+    });
+    assert(threads == ids.size());
+
+    ids.clear();
+    xpar::for_loop(xpar::par.with(sched{ sched::static_chunks, 1, 1 }), 0, 100,
+                   [&](int) { ids.insert(std::this_thread::get_id()); });
+    assert(1 == ids.size() && ids.count(std::this_thread::get_id()));
+
+    std::vector<int> a(100 * 100);
+    xpar::for_loop(xpar::par, 0, 100, [&](int i) {
+        xpar::for_loop(xpar::par_unseq, 0, 100, [&](int j) {
+            a[i * 100 + j] = i + j;
+        });
+    });
+    for (int i = 0; i < 100; ++i)
+        for (int j = 0; j < 100; ++j)
+            assert(i + j == a[i * 100 + j]);
+}
+
+// Reductions combine every iteration's contributions into the original
+// variable, and inductions pass and finally store `start + stride * k`.
+template <typename ExPolicy>
+void test_reductions(const ExPolicy& exec)
+{
+    long sum = 100;
+    int lo = INT_MAX, hi = INT_MIN, stepped = 5;
+    std::vector<int> a(N), order(N);
+    std::vector<const int*> ptrs(N);
+    for (int i = 0; i < N; ++i)
+        a[i] = (i * 7919) % N;
+    auto min_op = [](int x, int y) { return std::min(x, y); };
+    auto max_op = [](int x, int y) { return std::max(x, y); };
+    xpar::for_loop(exec, 0, N,
+                   xpar::reduction(sum, 0L, std::plus<>()),
+                   xpar::reduction(lo, INT_MAX, min_op),
+                   xpar::reduction(hi, INT_MIN, max_op),
+                   xpar::induction(stepped, 3),
+                   xpar::induction(a.data()),
+                   [&](int i, long& s, int& mn, int& mx, int j, const int* q) {
+                       s += a[i];
+                       mn = std::min(mn, a[i]);
+                       mx = std::max(mx, a[i]);
+                       order[i] = j;
+                       ptrs[i] = q;
+                   });
+    assert(100 + long(N) * (N - 1) / 2 == sum);
+    assert(0 == lo && N - 1 == hi);
+    assert(5 + 3 * N == stepped);
+    for (int i = 0; i < N; ++i)
+        assert(5 + 3 * i == order[i] && &a[i] == ptrs[i]);
+
+    // An rvalue induction is not stored back.  An empty loop leaves a
+    // reduction unchanged.
+    int limit = 0;
+    xpar::for_loop(exec, 10, 20, xpar::induction(limit + 0, 2),
+                   [&](auto, int i, int j) { order[i] = j; });
+    assert(0 == limit && 18 == order[19]);
+    xpar::for_loop(exec, 0, 0, xpar::reduction(sum, 0L, std::plus<>()),
+                   [](int, long& s) { s += 1; });
+    assert(100 + long(N) * (N - 1) / 2 == sum);
+
+    // Iterators that cannot be vectorized also take reductions.
+    std::list<int> l(10, 5);
+    int total = 0;
+    xpar::for_loop(exec, l.begin(), l.end(),
+                   xpar::reduction(total, 0, std::plus<>()),
+                   [](std::list<int>::iterator it, int& t) { t += *it; });
+    assert(50 == total);
+}
+
+// A floating-point sum with a fixed schedule is the same on every run.
+void test_deterministic_reduction()
+{
+    std::vector<float> x(100000);
+    for (std::size_t i = 0; i < x.size(); ++i)
+        x[i] = 1.0f / float(i + 1);
+    using sched = xpar::loop_schedule;
+    for (sched s : { sched{ }, sched{ sched::static_chunks, 1000 } }) {
+        auto exec = xpar::par_unseq.with(s);
+        float first = 0;
+        xpar::for_loop(exec, 0, int(x.size()),
+                       xpar::reduction(first, 0.0f, std::plus<>()),
+                       [&](int i, float& acc) { acc += x[i]; });
+        for (int r = 0; r < 20; ++r) {
+            float again = 0;
+            xpar::for_loop(exec, 0, int(x.size()),
+                           xpar::reduction(again, 0.0f, std::plus<>()),
+                           [&](int i, float& acc) { acc += x[i]; });
+            assert(first == again);
+        }
+    }
+}
+
+// A strided loop visits `first`, `first + stride`, ... up to, but not
+// including or passing, `last`.
+template <typename ExPolicy>
+void test_strided(const ExPolicy& exec)
+{
+    for (int stride : { 1, 3, 7, -1, -4 }) {
+        int first = stride > 0 ? 2 : 97, last = stride > 0 ? 97 : 2;
+        std::vector<int> hits(100), expected(100);
+        int n = 0;
+        for (int i = first; stride > 0 ? i < last : i > last; i += stride, ++n)
+            expected[i] = n;
+
+        long sum = 0;
+        int k = 0;
+        xpar::for_loop_strided(exec, first, last, stride,
+                               xpar::reduction(sum, 0L, std::plus<>()),
+                               xpar::induction(k),
+                               [&](int i, long& s, int j) {
+                                   hits[i] = j;
+                                   s += 1;
+                               });
+        assert(expected == hits && n == sum && n == k);
+
+        // The same loop over random-access and bidirectional iterators.
+        std::vector<int> v(100);
+        std::list<int> l(100);
+        auto vfirst = v.begin() + first, vlast = v.begin() + last;
+        auto lfirst = std::next(l.begin(), first);
+        auto llast = std::next(l.begin(), last);
+        xpar::for_loop_strided(exec, vfirst, vlast, stride,
+                               xpar::induction(0),
+                               [](auto it, int j) { *it = j; });
+        xpar::for_loop_strided(exec, lfirst, llast, stride,
+                               xpar::induction(0),
+                               [](auto it, int j) { *it = j; });
+        assert(expected == v);
+        assert(std::equal(l.begin(), l.end(), expected.begin()));
+
+        // Forward iterators support only positive strides.
+        if (stride > 0) {
+            std::forward_list<int> fl(100);
+            auto ffirst = std::next(fl.begin(), first);
+            auto flast = std::next(fl.begin(), last);
+            xpar::for_loop_strided(exec, ffirst, flast, stride,
+                                   xpar::induction(0),
+                                   [](auto it, int j) { *it = j; });
+            assert(std::equal(fl.begin(), fl.end(), expected.begin()));
+        }
+    }
+}
+
+// An N-dimensional loop visits every index once, whatever the tiling, and
+// without a tiling, in the order of nested loops.
+template <typename ExPolicy>
+void test_multidimensional(const ExPolicy& exec)
+{
+    constexpr int X = 13, Y = 17, Z = 19;
+    xpar::loop_extents ext(X, Y, Z);
+    static_assert(3 == ext.rank());
+
+    for (auto tiling : { xpar::tile(0, 0, 0), xpar::tile(4, 4, 8),
+                         xpar::tile(1, 5, 0), xpar::tile(64, 1, 3) }) {
+        std::vector<int> count(X * Y * Z);
+        xpar::for_loop(exec, ext, tiling, [&](int x, int y, int z) {
+            ++count[(x * Y + y) * Z + z];
+        });
+        for (int c : count)
+            assert(1 == c);
+    }
+
+    std::vector<int> order(X * Y * Z, -1);
+    int next = 0;
+    xpar::for_loop(xpar::seq, ext, [&](int x, int y, int z) {
+        order[(x * Y + y) * Z + z] = next++;
+    });
+    for (int i = 0; i < X * Y * Z; ++i)
+        assert(i == order[i]);
+
+    std::vector<long> image(X * Y);
+    xpar::for_loop(exec, xpar::loop_extents(X, Y), [&](auto, long x, long y) {
+        image[x * Y + y] = x * 1000 + y;
+    });
+    for (int x = 0; x < X; ++x)
+        for (int y = 0; y < Y; ++y)
+            assert(x * 1000 + y == image[x * Y + y]);
+
+    std::vector<int> line(X);
+    xpar::for_loop(exec, xpar::loop_extents(X), [&](int x) { line[x] = x; });
+    xpar::for_loop(exec, xpar::loop_extents(0, Y), xpar::tile(2, 2),
+                   [](int, int) { assert(false); });
+    for (int x = 0; x < X; ++x)
+        assert(x == line[x]);
+}
+
+// `vec_off` regions run one at a time, in iteration order, even when the
+// rest of the loop body runs in SIMD lanes.
+void test_vec_off()
+{
+    std::vector<int> order, x(N);
+    order.reserve(N);
+    xpar::for_loop(xpar::vec, 0, N, [&](auto cookie, int i) {
+        x[i] = i * i;
+        cookie.vec_off([&] { order.push_back(i); });
+    });
+    for (int i = 0; i < N; ++i)
+        assert(i == order[i] && i * i == x[i]);
+
+    // A value or reference returned from the region is returned by `vec_off`.
+    int last = -1;
+    std::vector<int> prev(N);
+    xpar::for_loop(xpar::vec, 0, N, [&](auto cookie, int i) {
+        prev[i] = cookie.vec_off([&] { int p = last; last = i; return p; });
+        int& r = cookie.vec_off([&]() -> int& { return x[i]; });
+        r = -r;
+    });
+    for (int i = 0; i < N; ++i)
+        assert(i - 1 == prev[i] && -i * i == x[i]);
+}
+
+// `ordered_update` applies each update in iteration order.
+void test_ordered_update()
+{
+    long sum = 0;
+    int hist[8] = { };
+    std::vector<int> running(N);
+    xpar::for_loop(xpar::vec, 0, N, [&](auto cookie, int i) {
+        running[i] = cookie.ordered_update(sum) += i;
+        ++cookie.ordered_update(hist[i % 8]);
+    });
+    assert(long(N) * (N - 1) / 2 == sum);
+    for (int i = 0; i < N; ++i)
+        assert(long(i) * (i + 1) / 2 == running[i]);
+    for (int h : hist)
+        assert(N / 8 == h);
+
+    unsigned bits = 0, product = 1;
+    xpar::for_loop(xpar::vec, 0, 4, [&](auto cookie, int i) {
+        cookie.ordered_update(bits) |= 1u << i;
+        cookie.ordered_update(product) *= unsigned(i + 1);
+    });
+    assert(0xfu == bits && 24 == product);
+
+    // Reductions and `ordered_update` can be used in the same body.
+    long total = 0;
+    std::vector<int> seen;
+    xpar::for_loop(xpar::vec, 0, N, xpar::reduction(total, 0L, std::plus<>()),
+                   [&](auto cookie, int i, long& t) {
+                       t += i;
+                       cookie.vec_off([&] { seen.push_back(i); });
+                   });
+    assert(long(N) * (N - 1) / 2 == total && N == int(seen.size()));
+    assert(std::is_sorted(seen.begin(), seen.end()));
+
+    // In an N-dimensional loop, `vec_off` regions run in iteration order.
+    std::vector<int> cells;
+    xpar::for_loop(xpar::vec, xpar::loop_extents(5, 40),
+                   [&](auto cookie, int x, int y) {
+                       cookie.vec_off([&] { cells.push_back(x * 40 + y); });
+                   });
+    assert(200 == cells.size() && std::is_sorted(cells.begin(), cells.end()));
+}
+
+int main()
+{
+    if (!std::getenv("FOR_LOOP_THREADS"))
+        setenv("FOR_LOOP_THREADS", "4", 1);
+
+    test_policy(xpar::seq);
+    test_policy(xpar::vec);
+    test_policy(xpar::unseq);
+    test_policy(xpar::par);
+    test_policy(xpar::par_unseq);
+    test_schedules();
+    test_reductions(xpar::seq);
+    test_reductions(xpar::vec);
+    test_reductions(xpar::unseq);
+    test_reductions(xpar::par);
+    test_reductions(xpar::par_unseq);
+    test_reductions(xpar::par.with({ xpar::loop_schedule::guided_chunks }));
+    test_deterministic_reduction();
+    test_strided(xpar::seq);
+    test_strided(xpar::vec);
+    test_strided(xpar::par);
+    test_strided(xpar::par_unseq.with({ xpar::loop_schedule::guided_chunks }));
+    test_multidimensional(xpar::seq);
+    test_multidimensional(xpar::vec);
+    test_multidimensional(xpar::unseq);
+    test_multidimensional(xpar::par);
+    test_multidimensional(xpar::par_unseq);
+    test_vec_off();
+    test_ordered_update();
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
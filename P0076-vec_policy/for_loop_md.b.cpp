@@ -0,0 +1,159 @@
+/* for_loop_md.b.cpp                                                  -*-C++-*-
+ *
+ * Copyright (C) 2016 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Two-dimensional `for_loop`s, with and without tiling, compared with plain
+ * nested loops:
+ *
+ *  - `transpose`: `out[j][i] = in[i][j]` for a square matrix of `float`s.
+ *    Untiled, every store touches a different cache line; tiles keep the
+ *    lines being written in cache.
+ *  - `blur`: a 3x3 box blur of a square image of `float`s.  Its innermost
+ *    dimension is contiguous and vectorizes under `unseq` and `par_unseq`.
+ *
+ * Each row is the best of `reps` runs, in nanoseconds per element.  Set
+ * `FOR_LOOP_THREADS` to change the number of threads used by `par_unseq`.
+ *
+ * Usage: for_loop_md.b [size [tile [reps]]]   (default: 2048 32 5)
+ */
+
+#include "for_loop.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace xpar = std::experimental::parallel;
+namespace chrono = std::chrono;
+
+int size = 2048;
+int tile = 32;
+int reps = 5;
+
+// Print the best time of `reps` calls to `f`, in nanoseconds per element.
+template <typename F>
+void row(const char* kernel, const char* loop, F f)
+{
+    double best = 1e300;
+    for (int r = 0; r < reps; ++r) {
+        auto start = chrono::steady_clock::now();
+        f();
+        chrono::duration<double, std::nano> elapsed =
+            chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / (double(size) * size));
+    }
+    std::cout << "| " << kernel << " | " << loop << " | " << best << " |"
+              << std::endl;
+}
+
+[[gnu::noinline]]
+void transpose_nested(const float* in, float* out, int n)
+{
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            out[j * n + i] = in[i * n + j];
+}
+
+template <typename ExPolicy, typename... Tiling>
+[[gnu::noinline]]
+void transpose(const ExPolicy& exec, const float* in, float* out, int n,
+               Tiling... tiling)
+{
+    xpar::for_loop(exec, xpar::loop_extents(n, n), tiling...,
+                   [=](int i, int j) { out[j * n + i] = in[i * n + j]; });
+}
+
+[[gnu::noinline]]
+void blur_nested(const float* in, float* out, int n)
+{
+    for (int i = 1; i < n - 1; ++i)
+        for (int j = 1; j < n - 1; ++j)
+            out[i * n + j] = (in[(i - 1) * n + j - 1] + in[(i - 1) * n + j] +
+                              in[(i - 1) * n + j + 1] + in[i * n + j - 1] +
+                              in[i * n + j] + in[i * n + j + 1] +
+                              in[(i + 1) * n + j - 1] + in[(i + 1) * n + j] +
+                              in[(i + 1) * n + j + 1]) * (1.0f / 9.0f);
+}
+
+template <typename ExPolicy, typename... Tiling>
+[[gnu::noinline]]
+void blur(const ExPolicy& exec, const float* in, float* out, int n,
+          Tiling... tiling)
+{
+    xpar::for_loop(exec, xpar::loop_extents(n - 2, n - 2), tiling...,
+                   [=](int i, int j) {
+        ++i, ++j;
+        out[i * n + j] = (in[(i - 1) * n + j - 1] + in[(i - 1) * n + j] +
+                          in[(i - 1) * n + j + 1] + in[i * n + j - 1] +
+                          in[i * n + j] + in[i * n + j + 1] +
+                          in[(i + 1) * n + j - 1] + in[(i + 1) * n + j] +
+                          in[(i + 1) * n + j + 1]) * (1.0f / 9.0f);
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        size = std::atoi(argv[1]);
+    if (argc > 2)
+        tile = std::atoi(argv[2]);
+    if (argc > 3)
+        reps = std::atoi(argv[3]);
+
+    int n = size;
+    std::vector<float> in(std::size_t(n) * n), out(in.size()),
+                       expected(in.size());
+    for (std::size_t i = 0; i < in.size(); ++i)
+        in[i] = float(i % 1009);
+    auto t = xpar::tile(tile, tile);
+
+    std::cout << "Threads: " << xpar::thread_pool::instance().size()
+              << ", tile: " << tile << " x " << tile << "\n\n"
+              << "| Kernel | Loop | Time (ns/elem) |\n"
+              << "| ------ | ---- | -------------: |" << std::endl;
+
+    auto check = [&] {
+        if (out != expected)
+            std::abort();
+    };
+    transpose_nested(in.data(), expected.data(), n);
+    row("`transpose`", "nested loops",
+        [&] { transpose_nested(in.data(), out.data(), n); });
+    check();
+    row("`transpose`", "`seq`",
+        [&] { transpose(xpar::seq, in.data(), out.data(), n); });
+    check();
+    row("`transpose`", "`seq`, tiled",
+        [&] { transpose(xpar::seq, in.data(), out.data(), n, t); });
+    check();
+    row("`transpose`", "`unseq`, tiled",
+        [&] { transpose(xpar::unseq, in.data(), out.data(), n, t); });
+    check();
+    row("`transpose`", "`par_unseq`, tiled",
+        [&] { transpose(xpar::par_unseq, in.data(), out.data(), n, t); });
+    check();
+
+    blur_nested(in.data(), expected.data(), n);
+    row("`blur`", "nested loops",
+        [&] { blur_nested(in.data(), out.data(), n); });
+    check();
+    row("`blur`", "`seq`",
+        [&] { blur(xpar::seq, in.data(), out.data(), n); });
+    check();
+    row("`blur`", "`unseq`",
+        [&] { blur(xpar::unseq, in.data(), out.data(), n); });
+    check();
+    row("`blur`", "`unseq`, tiled",
+        [&] { blur(xpar::unseq, in.data(), out.data(), n, t); });
+    check();
+    row("`blur`", "`par_unseq`",
+        [&] { blur(xpar::par_unseq, in.data(), out.data(), n); });
+    check();
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,138 @@
+/* for_loop_scaling.b.cpp                                             -*-C++-*-
+ *
+ * Copyright (C) 2016 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Strong scaling of `par` and `par_unseq` loops: a fixed amount of work is
+ * run on 1, 2, ... `thread_pool::instance().size()` threads, with each
+ * `loop_schedule` kind.  There are two kernels:
+ *
+ *  - `uniform`: every iteration does the same, modest amount of arithmetic.
+ *  - `triangular`: iteration `i` does work proportional to `i`, so equal
+ *    contiguous blocks are badly balanced and guided chunks should win.
+ *
+ * Each row is the best of `reps` runs, in milliseconds, and the speedup over
+ * the same policy and schedule on one thread.  Set `FOR_LOOP_THREADS` to
+ * change the size of the pool.
+ *
+ * Usage: for_loop_scaling.b [elements [reps]]   (default: 4000000 5)
+ */
+
+#include "for_loop.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace xpar = std::experimental::parallel;
+namespace chrono = std::chrono;
+
+std::size_t elements = 4000000;
+int         reps     = 5;
+
+// Best time of `reps` calls to `f`, in milliseconds.
+template <typename F>
+double best_time(F f)
+{
+    double best = 1e300;
+    for (int r = 0; r < reps; ++r) {
+        auto start = chrono::steady_clock::now();
+        f();
+        chrono::duration<double, std::milli> elapsed =
+            chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+inline float uniform_work(float x)
+{
+    for (int k = 0; k < 8; ++k)
+        x = x * 0.999f + 0.5f / (1.0f + x * x);
+    return x;
+}
+
+template <typename ExPolicy>
+[[gnu::noinline]]
+void uniform(const ExPolicy& exec, const float* in, float* out, int n)
+{
+    xpar::for_loop(exec, 0, n, [=](int i) { out[i] = uniform_work(in[i]); });
+}
+
+// The triangular kernel has `n / 1024` iterations, so that its total work is
+// comparable to that of the uniform kernel.
+template <typename ExPolicy>
+[[gnu::noinline]]
+void triangular(const ExPolicy& exec, const float* in, float* out, int n)
+{
+    int m = n / 1024;
+    xpar::for_loop(exec, 0, m, [=](int i) {
+        float x = in[i];
+        for (int k = 0; k < 2 * i; ++k)
+            x = x * 0.999f + 0.5f / (1.0f + x * x);
+        out[i] = x;
+    });
+}
+
+template <typename ExPolicy, typename Kernel>
+void scaling(const char* kernel, const char* policy, const ExPolicy& exec,
+             Kernel run, const std::vector<float>& in,
+             const std::vector<float>& expected)
+{
+    using sched = xpar::loop_schedule;
+    unsigned max_threads = xpar::thread_pool::instance().size();
+    std::vector<float> out(in.size());
+    for (auto kind : { sched::static_chunks, sched::guided_chunks }) {
+        double one = 0;
+        for (unsigned t = 1; t <= max_threads; ++t) {
+            auto e = exec.with(sched{ kind, 0, t });
+            double ms = best_time([&] {
+                run(e, in.data(), out.data(), int(in.size()));
+            });
+            if (out != expected)
+                std::abort();
+            if (t == 1)
+                one = ms;
+            std::cout << "| " << kernel << " | " << policy << " | "
+                      << (kind == sched::static_chunks ? "static" : "guided")
+                      << " | " << t << " | " << ms << " | " << one / ms
+                      << " |" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        elements = std::atol(argv[1]);
+    if (argc > 2)
+        reps = std::atoi(argv[2]);
+
+    std::vector<float> in(elements);
+    for (std::size_t i = 0; i < elements; ++i)
+        in[i] = float(i % 1000) / 1000.0f;
+
+    std::cout << "| Kernel | Policy | Schedule | Threads | Time (ms) "
+                 "| Speedup |\n"
+              << "| ------ | ------ | -------- | ------: | --------: "
+                 "| ------: |" << std::endl;
+
+    std::vector<float> expected(elements);
+    uniform(xpar::seq, in.data(), expected.data(), int(elements));
+    scaling("`uniform`", "`par`", xpar::par,
+            [](auto& e, auto... a) { uniform(e, a...); }, in, expected);
+    scaling("`uniform`", "`par_unseq`", xpar::par_unseq,
+            [](auto& e, auto... a) { uniform(e, a...); }, in, expected);
+
+    std::fill(expected.begin(), expected.end(), 0.0f);
+    triangular(xpar::seq, in.data(), expected.data(), int(elements));
+    scaling("`triangular`", "`par`", xpar::par,
+            [](auto& e, auto... a) { triangular(e, a...); }, in, expected);
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,150 @@
+/* thread_pool.h                                                      -*-C++-*-
+ *
+ * Copyright (C) 2016 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * The persistent pool of threads on which `par` and `par_unseq` loops run.
+ * `run(n, f)` calls `f(i)` for each `i` in `[0, n)`, with `f(0)` called on
+ * the calling thread and the others on pool threads, and returns when every
+ * call has returned.  A job is handed to the pool by bumping a generation
+ * counter; idle pool threads block in `atomic::wait` on that counter, so the
+ * pool costs nothing between loops.
+ *
+ * The pool runs one job at a time.  A `run` that is nested in a job, or that
+ * is called while another thread's job is running, makes all of its calls
+ * serially on the calling thread.
+ *
+ * The pool has `std::thread::hardware_concurrency()` threads, counting the
+ * caller, unless the environment variable `FOR_LOOP_THREADS` says otherwise.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace std {
+namespace experimental {
+namespace parallel {
+inline namespace v2 {
+
+class thread_pool
+{
+    using job_fn = void(void* ctx, unsigned index) noexcept;
+
+    vector<thread>          m_threads;
+    mutex                   m_job_mutex;     // Held while a job is running.
+    atomic<uint32_t>        m_generation{0}; // Incremented to start a job.
+    atomic<unsigned>        m_pending{0};    // Pool threads yet to finish.
+    atomic<bool>            m_stop{false};
+
+    // The current job, published by the release increment of `m_generation`.
+    job_fn*                 m_job = nullptr;
+    void*                   m_job_ctx = nullptr;
+    unsigned                m_job_threads = 0;
+
+    // True on pool threads, and on a caller while its job is running.
+    static bool& in_job()
+    {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    // Every pool thread acknowledges every job, even one it does not take
+    // part in, so no thread can miss a generation or see a later job's
+    // parameters.
+    void worker_loop(unsigned index)
+    {
+        in_job() = true;
+        uint32_t seen = 0;
+        for (;;) {
+            m_generation.wait(seen, memory_order_acquire);
+            seen = m_generation.load(memory_order_acquire);
+            if (m_stop.load(memory_order_relaxed))
+                return;
+            if (index < m_job_threads)
+                m_job(m_job_ctx, index);
+            if (1 == m_pending.fetch_sub(1, memory_order_acq_rel))
+                m_pending.notify_one();
+        }
+    }
+
+    thread_pool()
+    {
+        unsigned n = thread::hardware_concurrency();
+        if (const char* env = getenv("FOR_LOOP_THREADS"))
+            n = unsigned(atoi(env));
+        for (unsigned i = 1; i < max(n, 1u); ++i)
+            m_threads.emplace_back([this, i] { worker_loop(i); });
+    }
+
+public:
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool()
+    {
+        m_stop.store(true, memory_order_relaxed);
+        m_generation.fetch_add(1, memory_order_release);
+        m_generation.notify_all();
+        for (thread& t : m_threads)
+            t.join();
+    }
+
+    static thread_pool& instance()
+    {
+        static thread_pool pool;
+        return pool;
+    }
+
+    // Number of threads that can run a job, including the caller.
+    unsigned size() const { return unsigned(m_threads.size()) + 1; }
+
+    // Call `f(i)` for each `i` in `[0, n)`, on up to `n` threads.  An
+    // exception escaping `f` calls `std::terminate`.
+    template <typename F>
+    void run(unsigned n, F& f)
+    {
+        auto call = [&f](unsigned i) noexcept { f(i); };
+        unique_lock<mutex> lock;
+        if (n > 1 && !in_job())
+            lock = unique_lock<mutex>(m_job_mutex, try_to_lock);
+        if (!lock.owns_lock()) {
+            for (unsigned i = 0; i < n; ++i)
+                call(i);
+            return;
+        }
+
+        m_job = [](void* ctx, unsigned i) noexcept {
+            (*static_cast<decltype(call)*>(ctx))(i);
+        };
+        m_job_ctx = &call;
+        m_job_threads = min(n, size());
+        m_pending.store(unsigned(m_threads.size()), memory_order_relaxed);
+        m_generation.fetch_add(1, memory_order_release);
+        m_generation.notify_all();
+
+        // Call 0, and any calls beyond the pool's size, run on this thread.
+        in_job() = true;
+        call(0);
+        for (unsigned i = size(); i < n; ++i)
+            call(i);
+        in_job() = false;
+        for (unsigned p; 0 != (p = m_pending.load(memory_order_acquire)); )
+            m_pending.wait(p, memory_order_acquire);
+    }
+};
+
+} // close namespace v2
+} // close namespace parallel
+} // close namespace experimental
+} // close namespace std
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
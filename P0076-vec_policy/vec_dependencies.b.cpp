@@ -0,0 +1,119 @@
+/* vec_dependencies.b.cpp                                             -*-C++-*-
+ *
+ * Copyright (C) 2016 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Measures whether `vec`, whose `ordered_update` and `vec_off` regions keep
+ * a loop-carried dependency in iteration order, lets loops vectorize that
+ * `unseq` cannot express.  The kernels, in `vec_dependencies_kernels.cpp`,
+ * are
+ *
+ *  - `prefix_sum`: running sum of squares, with `ordered_update` under
+ *    `vec`,
+ *  - `histogram`: a bin computed from each input, then incremented, with
+ *    `ordered_update` under `vec` and lane-private histograms combined by a
+ *    `reduction` under `unseq`, and
+ *  - `compaction`: the inputs that pass a test, copied in order, with a
+ *    `vec_off` region under `vec`.
+ *
+ * `prefix_sum` and `compaction` have no single-pass form under `unseq`,
+ * where their dependency would be a data race.
+ *
+ * Each build times one kernel under one policy (see `KERNEL` and `POLICY`
+ * in the Makefile) and prints one table row: the best of `reps` runs, in
+ * nanoseconds per element and millions of elements per second, and the
+ * vectorization result passed in by `make vec-bench`, which summarizes the
+ * compiler's `-fopt-info-vec` report on the kernel.
+ *
+ * Usage: vec_dependencies.b [vectorization [elements [reps]]]
+ *        (default: "?", 1000000, 20)
+ */
+
+#include "vec_dependencies.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if !defined(KERNEL) || !defined(POLICY)
+#error "Define KERNEL and POLICY; see vec_dependencies_kernels.cpp"
+#endif
+
+#define VEC_DEPENDENCIES_STR2(x) #x
+#define VEC_DEPENDENCIES_STR(x) VEC_DEPENDENCIES_STR2(x)
+
+namespace chrono = std::chrono;
+
+histogram_t add_histograms(histogram_t a, const histogram_t& b)
+{
+    for (int k = 0; k < bins; ++k)
+        a[k] += b[k];
+    return a;
+}
+
+// The result of the kernel, computed by a plain serial loop.  Returns the
+// size of `out`.
+int reference(const std::string& kernel, const std::vector<int>& in,
+              std::vector<int>& out)
+{
+    int n = int(in.size()), sum = 0, count = 0;
+    if (kernel == "prefix_sum") {
+        for (int i = 0; i < n; ++i)
+            out[i] = sum += in[i] * in[i];
+        return n;
+    }
+    else if (kernel == "histogram") {
+        for (int i = 0; i < n; ++i)
+            ++out[bin_of(in[i])];
+        return bins;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (keep(in[i]))
+            out[count++] = in[i];
+    }
+    return count;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* vectorization = argc > 1 ? argv[1] : "?";
+    std::size_t elements = argc > 2 ? std::atol(argv[2]) : 1000000;
+    int reps = argc > 3 ? std::atoi(argv[3]) : 20;
+
+    const std::string kernel = VEC_DEPENDENCIES_STR(KERNEL);
+    int n = int(elements);
+    // `histogram` writes `bins` counts, however few the elements.
+    std::vector<int> in(n), out(std::max(n, bins)), expected(out.size());
+    std::mt19937 gen(1);
+    for (int& x : in)
+        x = int(gen() % 1024);
+    int expected_size = reference(kernel, in, expected);
+
+    double best = 1e300;
+    for (int r = 0; r < reps; ++r) {
+        std::fill(out.begin(), out.end(), 0);
+        auto start = chrono::steady_clock::now();
+        int count = run_kernel(in.data(), out.data(), n);
+        chrono::duration<double, std::nano> elapsed =
+            chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / n);
+
+        if (kernel == "compaction" && count != expected_size)
+            std::abort();
+        if (!std::equal(expected.begin(), expected.begin() + expected_size,
+                        out.begin()))
+            std::abort();
+    }
+
+    std::cout << "| `" << kernel << "` | `" VEC_DEPENDENCIES_STR(POLICY)
+              << "` | " << best << " | " << 1000.0 / best << " | "
+              << vectorization << " |" << std::endl;
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
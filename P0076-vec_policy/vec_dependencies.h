@@ -0,0 +1,44 @@
+/* vec_dependencies.h                                                 -*-C++-*-
+ *
+ * Copyright (C) 2016 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Declarations shared by `vec_dependencies.b.cpp` and the kernel it times,
+ * `vec_dependencies_kernels.cpp`.
+ */
+
+#pragma once
+
+#include <array>
+
+constexpr int bins = 64;
+
+// The histogram bin of an input in `[0, 1024)`: its square, scaled to
+// `[0, bins)`.  Integer arithmetic keeps the bin computation free of calls
+// and branches, so that only the increment can stop vectorization.
+inline int bin_of(int x)
+{
+    return (x * x) >> 14;
+}
+
+// True for the inputs kept by `compaction`: about 30% of them.
+inline bool keep(int x)
+{
+    return x * 7 % 10 < 3;
+}
+
+using histogram_t = std::array<int, bins>;
+
+// Return the bin-by-bin sum of `a` and `b`.  Defined with the benchmark
+// harness, so that the compiler's vectorization report on the kernels does
+// not include this loop.
+histogram_t add_histograms(histogram_t a, const histogram_t& b);
+
+// Run the kernel named by `KERNEL` under the policy named by `POLICY` on the
+// `n` elements of `in`.  Return the number of elements written to `out` by
+// `compaction`, and zero for the other kernels.
+int run_kernel(const int* in, int* out, int n);
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
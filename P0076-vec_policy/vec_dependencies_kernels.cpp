@@ -0,0 +1,102 @@
+/* vec_dependencies_kernels.cpp                                       -*-C++-*-
+ *
+ * Copyright (C) 2016 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * The kernels timed by `vec_dependencies.b.cpp`, each a loop with a
+ * loop-carried dependency.  Every build defines `KERNEL` as one of the
+ * kernel names below and `POLICY` as `seq`, `vec` or `unseq`, and this file
+ * is compiled on its own so that `-fopt-info-vec` reports only on that
+ * kernel's loop and the library code it instantiates.
+ */
+
+#include "vec_dependencies.h"
+
+#include "for_loop.h"
+
+#include <algorithm>
+#include <type_traits>
+
+namespace xpar = std::experimental::parallel;
+
+namespace {
+
+template <typename ExPolicy>
+constexpr bool is_vec = std::is_same_v<ExPolicy,
+                                       xpar::vector_execution_policy>;
+
+// `out[i]` is the sum of the squares of `in[0]` through `in[i]`.  The
+// dependency is on every iteration; only the squaring can run in lanes.
+template <typename ExPolicy>
+int prefix_sum(const ExPolicy& exec, const int* in, int* out, int n)
+{
+    int sum = 0;
+    if constexpr (is_vec<ExPolicy>)
+        xpar::for_loop(exec, 0, n, [&](auto cookie, int i) {
+            int square = in[i] * in[i];
+            out[i] = cookie.ordered_update(sum) += square;
+        });
+    else
+        xpar::for_loop(exec, 0, n, [&](int i) {
+            sum += in[i] * in[i];
+            out[i] = sum;
+        });
+    return 0;
+}
+
+// `out[b]` counts the inputs in bin `b`.  Computing the bin is independent
+// work; only the increment depends on other iterations.  Under `unseq`, each
+// lane counts into a private histogram, and the histograms are summed after
+// the loop.
+template <typename ExPolicy>
+int histogram(const ExPolicy& exec, const int* in, int* out, int n)
+{
+    if constexpr (is_vec<ExPolicy>)
+        xpar::for_loop(exec, 0, n, [&](auto cookie, int i) {
+            int b = bin_of(in[i]);
+            ++cookie.ordered_update(out[b]);
+        });
+    else if constexpr (std::is_same_v<ExPolicy,
+                                      xpar::unsequenced_execution_policy>) {
+        histogram_t hist{ };
+        xpar::for_loop(exec, 0, n,
+                       xpar::reduction(hist, histogram_t{ }, add_histograms),
+                       [&](int i, histogram_t& h) { ++h[bin_of(in[i])]; });
+        std::copy(hist.begin(), hist.end(), out);
+    }
+    else
+        xpar::for_loop(exec, 0, n, [&](int i) { ++out[bin_of(in[i])]; });
+    return 0;
+}
+
+// Copy the inputs that satisfy `keep` to `out`, in order, and return how
+// many there are.  Testing the input is independent work; only the copy
+// depends on other iterations.
+template <typename ExPolicy>
+int compaction(const ExPolicy& exec, const int* in, int* out, int n)
+{
+    int count = 0;
+    if constexpr (is_vec<ExPolicy>)
+        xpar::for_loop(exec, 0, n, [&](auto cookie, int i) {
+            int x = in[i];
+            if (keep(x))
+                cookie.vec_off([&] { out[count++] = x; });
+        });
+    else
+        xpar::for_loop(exec, 0, n, [&](int i) {
+            if (keep(in[i]))
+                out[count++] = in[i];
+        });
+    return count;
+}
+
+} // close unnamed namespace
+
+int run_kernel(const int* in, int* out, int n)
+{
+    return KERNEL(xpar::POLICY, in, out, n);
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
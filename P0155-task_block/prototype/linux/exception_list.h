@@ -0,0 +1,60 @@
+/* exception_list.h                                                   -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * `exception_list`, as described in N4507, thrown by a task region when one
+ * or more of its tasks exited with an exception, and
+ * `task_canceled_exception`.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <vector>
+
+class exception_list : public std::exception
+{
+public:
+    typedef std::exception_ptr value_type;
+    typedef const value_type& reference;
+    typedef const value_type& const_reference;
+    typedef std::size_t size_type;
+    typedef std::vector<std::exception_ptr>::const_iterator iterator;
+    typedef std::vector<std::exception_ptr>::const_iterator const_iterator;
+
+    exception_list(std::vector<std::exception_ptr> exceptions)
+        : exceptions_(std::move(exceptions)) {}
+
+    size_type size() const noexcept {
+        return exceptions_.size();
+    }
+    const_iterator begin() const noexcept {
+        return exceptions_.begin();
+    }
+    const_iterator end() const noexcept {
+        return exceptions_.end();
+    }
+
+    const char* what() const noexcept override {
+        return "exception_list";
+    }
+
+private:
+    std::vector<std::exception_ptr> exceptions_;
+};
+
+// Thrown by `task_region_handle::run` in a region that has been canceled
+// because a task failed.  `task_region` discards it.
+class task_canceled_exception : public std::exception
+{
+public:
+    const char* what() const noexcept override {
+        return "task region canceled";
+    }
+};
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
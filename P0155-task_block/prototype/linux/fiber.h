@@ -0,0 +1,462 @@
+/* fiber.h                                                            -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Stackful fibers for the continuation-stealing mode of `task_region`.
+ *
+ * A `fiber` is a `task_base`, so a suspended fiber can sit in a worker's
+ * deque and be stolen like any other task; executing it resumes the fiber
+ * on the executing thread.  Control moves between fibers in three ways:
+ *
+ *  - `fiber::resume(f)` runs `f` as if it were a function call: when `f`
+ *    (or whichever fiber it switches to) next suspends or exits, control
+ *    returns to the caller of `resume`, on the same thread.
+ *  - `fiber::switch_to(f, ...)` transfers control from the current fiber
+ *    directly to `f`, leaving the current fiber suspended.
+ *  - `fiber::suspend(...)` and `fiber::exit_to(...)` give control back to
+ *    the innermost `resume` on the current thread (or to `f`, for
+ *    `exit_to(f)`).
+ *
+ * Each switch can carry a "post-switch action", which is run by the
+ * destination as soon as it gains control.  It is the way to publish the
+ * fiber that was just suspended (e.g., push it onto a deque) only once its
+ * context has been saved, and to recycle a fiber that has exited once its
+ * stack is no longer in use.
+ *
+ * A suspended fiber may be resumed on a different thread.  Code that might
+ * run on a fiber therefore reads thread-local variables only through
+ * out-of-line accessors (`TASK_BLOCK_TLS_ACCESSOR`), since a compiler may
+ * otherwise reuse a thread-local address computed before a switch.
+ *
+ * On x86-64 the context switch saves only the callee-saved registers and
+ * the floating-point control words.  Elsewhere it falls back to
+ * `swapcontext`, which also saves and restores the signal mask with a system
+ * call and is more than ten times slower.
+ */
+
+#pragma once
+
+#include "../task_arena.h"
+#include "task_scheduler.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Define `TASK_BLOCK_UCONTEXT_FIBERS` to use `swapcontext` even on x86-64.
+#if defined(__x86_64__) && !defined(TASK_BLOCK_UCONTEXT_FIBERS)
+#define TASK_BLOCK_ASM_FIBERS 1
+#else
+#include <ucontext.h>
+#endif
+
+// ThreadSanitizer must be told about every switch, or it takes the stacks of
+// different fibers for one and reports false races.
+#if defined(__SANITIZE_THREAD__)
+#define TASK_BLOCK_TSAN_FIBERS 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define TASK_BLOCK_TSAN_FIBERS 1
+#endif
+#endif
+
+#ifdef TASK_BLOCK_TSAN_FIBERS
+extern "C" {
+void* __tsan_get_current_fiber();
+void* __tsan_create_fiber(unsigned flags);
+void  __tsan_destroy_fiber(void* fiber);
+void  __tsan_switch_to_fiber(void* fiber, unsigned flags);
+}
+#endif
+
+// Saved execution context: a stack pointer (x86-64) or a `ucontext_t`.
+struct fiber_context
+{
+#ifdef TASK_BLOCK_ASM_FIBERS
+    void*       sp = nullptr;
+#else
+    ucontext_t  uc;
+#endif
+#ifdef TASK_BLOCK_TSAN_FIBERS
+    void*       tsan_fiber = nullptr;
+#endif
+};
+
+inline void fiber_switch_annotate(fiber_context& to)
+{
+#ifdef TASK_BLOCK_TSAN_FIBERS
+    __tsan_switch_to_fiber(to.tsan_fiber, 0);
+#else
+    (void) to;
+#endif
+}
+
+#ifdef TASK_BLOCK_ASM_FIBERS
+
+extern "C" void task_block_switch_context(void** save_sp, void* new_sp);
+extern "C" void task_block_fiber_trampoline();
+
+// `task_block_switch_context` pushes the callee-saved registers and the SSE
+// and x87 control words onto the current stack, saves the stack pointer in
+// `*save_sp`, and pops the same from `new_sp`.  A new context is prepared
+// so that the final `ret` enters `task_block_fiber_trampoline`, which calls
+// the function in `r13` with the argument in `r12`.  Both are emitted in a
+// COMDAT group, so that this header can be included in any number of
+// translation units.
+asm(R"(
+    .pushsection .text.task_block_switch_context,"axG",@progbits,task_block_switch_context,comdat
+    .weak   task_block_switch_context
+    .hidden task_block_switch_context
+    .type   task_block_switch_context, @function
+    .p2align 4
+task_block_switch_context:
+    pushq   %rbp
+    pushq   %rbx
+    pushq   %r12
+    pushq   %r13
+    pushq   %r14
+    pushq   %r15
+    subq    $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw  4(%rsp)
+    movq    %rsp, (%rdi)
+    movq    %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw   4(%rsp)
+    addq    $8, %rsp
+    popq    %r15
+    popq    %r14
+    popq    %r13
+    popq    %r12
+    popq    %rbx
+    popq    %rbp
+    ret
+    .size   task_block_switch_context, .-task_block_switch_context
+
+    .weak   task_block_fiber_trampoline
+    .hidden task_block_fiber_trampoline
+    .type   task_block_fiber_trampoline, @function
+task_block_fiber_trampoline:
+    movq    %r12, %rdi
+    callq   *%r13
+    ud2
+    .size   task_block_fiber_trampoline, .-task_block_fiber_trampoline
+    .popsection
+)");
+
+inline void fiber_switch(fiber_context& from, fiber_context& to)
+{
+    fiber_switch_annotate(to);
+    task_block_switch_context(&from.sp, to.sp);
+}
+
+// Prepare `ctx` to call `entry(arg)` on the stack `[base, base + size)`.
+// `entry` must never return.
+inline void fiber_prepare(fiber_context& ctx, void* base, std::size_t size,
+                          void (*entry)(void*), void* arg)
+{
+    auto top = (reinterpret_cast<std::uintptr_t>(base) + size) & ~std::uintptr_t(15);
+    auto frame = reinterpret_cast<std::uint64_t*>(top) - 10;
+    frame[0] = 0x0000037f00001f80;  // Default MXCSR and x87 control word
+    frame[1] = 0;                   // r15
+    frame[2] = 0;                   // r14
+    frame[3] = reinterpret_cast<std::uint64_t>(entry);    // r13
+    frame[4] = reinterpret_cast<std::uint64_t>(arg);      // r12
+    frame[5] = 0;                   // rbx
+    frame[6] = 0;                   // rbp
+    frame[7] = reinterpret_cast<std::uint64_t>(&task_block_fiber_trampoline);
+    ctx.sp = frame;
+}
+
+#else
+
+inline void fiber_switch(fiber_context& from, fiber_context& to)
+{
+    fiber_switch_annotate(to);
+    swapcontext(&from.uc, &to.uc);
+}
+
+// `makecontext` passes only `int` arguments, so the entry point and its
+// argument are handed over through the thread that first switches to the
+// new context.
+struct fiber_start_args
+{
+    void (*entry)(void*);
+    void* arg;
+};
+
+TASK_BLOCK_TLS_ACCESSOR inline fiber_start_args& fiber_start_slot()
+{
+    static thread_local fiber_start_args args;
+    return args;
+}
+
+inline void fiber_prepare(fiber_context& ctx, void* base, std::size_t size,
+                          void (*entry)(void*), void* arg)
+{
+    getcontext(&ctx.uc);
+    ctx.uc.uc_stack.ss_sp = base;
+    ctx.uc.uc_stack.ss_size = size;
+    ctx.uc.uc_link = nullptr;
+    makecontext(&ctx.uc, +[] {
+        fiber_start_args args = fiber_start_slot();
+        args.entry(args.arg);
+    }, 0);
+
+    // Only valid until the next `fiber_prepare` on this thread, which is
+    // enough: a prepared fiber is always switched to immediately.
+    fiber_start_slot() = { entry, arg };
+}
+
+#endif
+
+class fiber : public task_base
+{
+public:
+    // Usable stack size.  Stack memory is reserved, not committed, so only
+    // the pages actually touched cost memory.
+    static constexpr std::size_t stack_size = std::size_t(256) << 10;
+
+    // Largest number of idle fibers kept by each thread for reuse.
+    static constexpr std::size_t max_pooled = 64;
+
+private:
+    struct post_action
+    {
+        void (*fn)(void*) = nullptr;
+        void* arg = nullptr;
+    };
+
+    struct pool
+    {
+        fiber*      head = nullptr;
+        std::size_t count = 0;
+
+        ~pool()
+        {
+            while (head) {
+                fiber* f = head;
+                head = f->m_next_free;
+                destroy(f);
+            }
+        }
+    };
+
+    // Per-thread state.  `return_ctx` is the context of the innermost
+    // `resume` on this thread, and `current` the fiber running on it (null
+    // when not on a fiber).
+    struct thread_state
+    {
+        fiber_context*  return_ctx = nullptr;
+        fiber*          current = nullptr;
+        post_action     post;
+        pool            free_fibers;
+    };
+
+    fiber_context   m_ctx;
+    void*           m_stack = nullptr;     // Including the guard page
+    std::size_t     m_mapped = 0;
+    void          (*m_entry)(fiber*, void*) = nullptr;
+    void*           m_data = nullptr;
+    fiber*          m_next_free = nullptr;
+
+    static inline std::atomic<std::size_t> s_stacks_allocated{0};
+    static inline std::atomic<std::size_t> s_live{0};        // Created, not exited
+    static inline std::atomic<std::size_t> s_peak_live{0};
+
+    TASK_BLOCK_TLS_ACCESSOR static thread_state& this_thread()
+    {
+        static thread_local thread_state state;
+        return state;
+    }
+
+    fiber() : task_base{&execute_fiber} {}
+
+    static void execute_fiber(task_base* t)
+    {
+        resume(static_cast<fiber*>(t));
+    }
+
+    static fiber* allocate()
+    {
+        pool& p = this_thread().free_fibers;
+        if (fiber* f = p.head) {
+            p.head = f->m_next_free;
+            --p.count;
+            return f;
+        }
+
+        std::size_t page = std::size_t(sysconf(_SC_PAGESIZE));
+        std::size_t mapped = stack_size + page;
+        void* stack = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                           MAP_STACK, -1, 0);
+        if (stack == MAP_FAILED)
+            throw std::bad_alloc();
+        mprotect(stack, page, PROT_NONE);   // Guard page (stacks grow down)
+        s_stacks_allocated.fetch_add(1, std::memory_order_relaxed);
+
+        fiber* f = new fiber;
+        f->m_stack = stack;
+        f->m_mapped = mapped;
+#ifdef TASK_BLOCK_TSAN_FIBERS
+        f->m_ctx.tsan_fiber = __tsan_create_fiber(0);
+#endif
+        return f;
+    }
+
+    static void destroy(fiber* f)
+    {
+#ifdef TASK_BLOCK_TSAN_FIBERS
+        __tsan_destroy_fiber(f->m_ctx.tsan_fiber);
+#endif
+        munmap(f->m_stack, f->m_mapped);
+        delete f;
+    }
+
+    static void recycle(void* p)
+    {
+        s_live.fetch_sub(1, std::memory_order_relaxed);
+        auto f = static_cast<fiber*>(p);
+        pool& pl = this_thread().free_fibers;
+        if (pl.count == max_pooled) {
+            destroy(f);
+            return;
+        }
+        f->m_next_free = pl.head;
+        pl.head = f;
+        ++pl.count;
+    }
+
+    static void run_post_action()
+    {
+        post_action& post = this_thread().post;
+        if (post.fn)
+            std::exchange(post.fn, nullptr)(post.arg);
+    }
+
+    static void fiber_main(void* p)
+    {
+        run_post_action();
+        auto f = static_cast<fiber*>(p);
+        f->m_entry(f, f->m_data);
+        std::abort();   // `m_entry` must end with `exit_to`
+    }
+
+public:
+    fiber(const fiber&) = delete;
+    fiber& operator=(const fiber&) = delete;
+
+    // Return a fiber that, when first switched to, calls `entry(f, data)`.
+    // `entry` must end by calling `exit_to`.
+    static fiber* create(void (*entry)(fiber*, void*), void* data)
+    {
+        fiber* f = allocate();
+        std::size_t live = s_live.fetch_add(1, std::memory_order_relaxed) + 1;
+        std::size_t peak = s_peak_live.load(std::memory_order_relaxed);
+        while (live > peak &&
+               !s_peak_live.compare_exchange_weak(peak, live,
+                                                  std::memory_order_relaxed))
+            ;
+        f->m_entry = entry;
+        f->m_data = data;
+        std::size_t guard = f->m_mapped - stack_size;
+        fiber_prepare(f->m_ctx, static_cast<char*>(f->m_stack) + guard,
+                      stack_size, &fiber_main, f);
+        return f;
+    }
+
+    // The fiber running on the calling thread, or null.
+    static fiber* current() { return this_thread().current; }
+
+    // Number of fiber stacks mapped so far, for instrumentation.
+    static std::size_t stacks_allocated()
+    {
+        return s_stacks_allocated.load(std::memory_order_relaxed);
+    }
+
+    // Largest number of fibers that have been created and have not yet
+    // exited at any one time since the last `reset_peak_live`, for
+    // instrumentation.  Each has a stack, so this bounds the stack memory in
+    // use, apart from the idle fibers pooled by each thread for reuse (at
+    // most `max_pooled` per thread).
+    static std::size_t peak_live()
+    {
+        return s_peak_live.load(std::memory_order_relaxed);
+    }
+
+    static void reset_peak_live()
+    {
+        s_peak_live.store(s_live.load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+    }
+
+    // Run `f` until it, or a fiber it switches to, suspends or exits.
+    static void resume(fiber* f)
+    {
+        thread_state& ts = this_thread();
+        fiber_context here;
+#ifdef TASK_BLOCK_TSAN_FIBERS
+        here.tsan_fiber = __tsan_get_current_fiber();
+#endif
+        fiber_context* saved_return = ts.return_ctx;
+        fiber* saved_current = ts.current;
+        ts.return_ctx = &here;
+        ts.current = f;
+        fiber_switch(here, f->m_ctx);
+
+        // Back on the same thread.
+        run_post_action();
+        ts.return_ctx = saved_return;
+        ts.current = saved_current;
+    }
+
+    // Suspend the current fiber and switch to `to`, which runs
+    // `post(arg)` first.  Return when the current fiber is resumed,
+    // possibly on another thread.
+    static void switch_to(fiber* to, void (*post)(void*), void* arg)
+    {
+        thread_state& ts = this_thread();
+        fiber* self = ts.current;
+        ts.post = { post, arg };
+        ts.current = to;
+        fiber_switch(self->m_ctx, to->m_ctx);
+        run_post_action();
+    }
+
+    // Suspend the current fiber and return to the innermost `resume` on
+    // this thread, which runs `post(arg)` first.
+    static void suspend(void (*post)(void*), void* arg)
+    {
+        thread_state& ts = this_thread();
+        fiber* self = ts.current;
+        ts.post = { post, arg };
+        fiber_switch(self->m_ctx, *ts.return_ctx);
+        run_post_action();
+    }
+
+    // End the current fiber and switch to `to` or, if null, return to the
+    // innermost `resume` on this thread.  The fiber is recycled.
+    [[noreturn]] static void exit_to(fiber* to)
+    {
+        thread_state& ts = this_thread();
+        fiber* self = ts.current;
+        ts.post = { &recycle, self };
+        if (to) {
+            ts.current = to;
+            fiber_switch(self->m_ctx, to->m_ctx);
+        }
+        else
+            fiber_switch(self->m_ctx, *ts.return_ctx);
+        std::abort();   // An exited fiber is never resumed.
+    }
+};
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
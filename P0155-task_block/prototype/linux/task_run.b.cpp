@@ -0,0 +1,206 @@
+/* task_run.b.cpp                                                     -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Compares the two `task_region_policy` values, and a serial baseline, on
+ * three recursive divide-and-conquer workloads:
+ *
+ *  - `fib`: naive Fibonacci with one region per call, all overhead.
+ *  - `quicksort`: parallel quicksort of random `int`s, with a serial cutoff.
+ *  - `tree`: sum of the values in a complete binary tree, one region per
+ *    node.
+ *
+ * Times are the best of five runs, in milliseconds.  "Peak fibers" is the
+ * largest number of fibers alive at once during the continuation-stealing
+ * runs of that row, each with its own stack, which bounds their stack memory
+ * (apart from the idle fibers each thread keeps for reuse).  Set
+ * `TASK_BLOCK_WORKERS` to change the number of pool threads.
+ *
+ * Usage: task_run.b [fib-n [sort-size [tree-depth]]]
+ *        (default: 30, 4000000, 22)
+ */
+
+#include "task_run.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace chrono = std::chrono;
+
+task_region_options options;
+
+long fib(int n)
+{
+    if (n < 2)
+        return n;
+    long x, y;
+    task_region(options, [&](task_region_handle& trh) {
+        trh.run([&] { x = fib(n - 1); });
+        y = fib(n - 2);
+    });
+    return x + y;
+}
+
+long serial_fib(int n)
+{
+    return n < 2 ? n : serial_fib(n - 1) + serial_fib(n - 2);
+}
+
+constexpr std::ptrdiff_t sort_cutoff = 2048;
+
+template <typename Spawn>
+void quicksort(int* first, int* last, Spawn spawn)
+{
+    while (last - first > sort_cutoff) {
+        int pivot = std::max(std::min(first[0], first[(last - first) / 2]),
+                             std::min(std::max(first[0],
+                                               first[(last - first) / 2]),
+                                      last[-1]));
+        int* mid1 = std::partition(first, last,
+                                   [=](int x) { return x < pivot; });
+        int* mid2 = std::partition(mid1, last,
+                                   [=](int x) { return !(pivot < x); });
+        if (spawn(first, mid1, mid2, last))
+            return;
+        first = mid2;
+    }
+    std::sort(first, last);
+}
+
+void parallel_quicksort(int* first, int* last)
+{
+    quicksort(first, last, [](int* a, int* b, int* c, int* d) {
+        task_region(options, [&](task_region_handle& trh) {
+            trh.run([=] { parallel_quicksort(a, b); });
+            parallel_quicksort(c, d);
+        });
+        return true;
+    });
+}
+
+void serial_quicksort(int* first, int* last)
+{
+    quicksort(first, last, [](int* a, int* b, int*, int*) {
+        serial_quicksort(a, b);
+        return false;
+    });
+}
+
+struct tree_node
+{
+    long                        value;
+    std::unique_ptr<tree_node>  left, right;
+};
+
+std::unique_ptr<tree_node> make_tree(int depth, long& next)
+{
+    if (depth == 0)
+        return nullptr;
+    auto node = std::make_unique<tree_node>();
+    node->value = next++;
+    node->left = make_tree(depth - 1, next);
+    node->right = make_tree(depth - 1, next);
+    return node;
+}
+
+long tree_sum(const tree_node* node)
+{
+    if (!node)
+        return 0;
+    long left, right;
+    task_region(options, [&](task_region_handle& trh) {
+        trh.run([&] { left = tree_sum(node->left.get()); });
+        right = tree_sum(node->right.get());
+    });
+    return node->value + left + right;
+}
+
+long serial_tree_sum(const tree_node* node)
+{
+    return node ? node->value + serial_tree_sum(node->left.get()) +
+        serial_tree_sum(node->right.get()) : 0;
+}
+
+// Best of five runs of `f`, in milliseconds.  `check` is called with each
+// result, so that the work cannot be discarded.
+template <typename F, typename Check>
+double best_time(F f, Check check)
+{
+    double best = 1e300;
+    for (int i = 0; i < 5; ++i) {
+        auto start = chrono::steady_clock::now();
+        auto result = f();
+        auto elapsed = chrono::steady_clock::now() - start;
+        check(result);
+        best = std::min(best,
+                        chrono::duration<double, std::milli>(elapsed).count());
+    }
+    return best;
+}
+
+// Print a row: serial, child-stealing and continuation-stealing times.
+template <typename Serial, typename Parallel, typename Check>
+void row(const char* name, Serial serial, Parallel parallel, Check check)
+{
+    double t_serial = best_time(serial, check);
+    options.policy = task_region_policy::child_stealing;
+    double t_child = best_time(parallel, check);
+    options.policy = task_region_policy::continuation_stealing;
+    fiber::reset_peak_live();
+    double t_cont = best_time(parallel, check);
+    std::cout << "| " << name << " | " << t_serial << " | " << t_child
+              << " | " << t_cont << " | " << fiber::peak_live() << " |"
+              << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    int fib_n = argc > 1 ? std::atoi(argv[1]) : 30;
+    std::size_t sort_size = argc > 2 ? std::atol(argv[2]) : 4000000;
+    int tree_depth = argc > 3 ? std::atoi(argv[3]) : 22;
+
+    std::cout << "Pool threads: " << task_scheduler::instance().pool_size()
+              << "\n\n"
+              << "| Benchmark | Serial | Child stealing "
+                 "| Continuation stealing | Peak fibers |\n"
+              << "| :-------- | -----: | -------------: "
+                 "| --------------------: | ----------: |" << std::endl;
+
+    long expected_fib = serial_fib(fib_n);
+    row("`fib`", [=] { return serial_fib(fib_n); },
+        [=] { return fib(fib_n); },
+        [=](long r) { if (r != expected_fib) std::abort(); });
+
+    std::vector<int> input(sort_size);
+    std::mt19937 gen(1);
+    for (int& x : input)
+        x = int(gen());
+    std::vector<int> v;
+    auto sorted = [&](bool) {
+        if (!std::is_sorted(v.begin(), v.end()))
+            std::abort();
+    };
+    row("`quicksort`",
+        [&] { v = input; serial_quicksort(v.data(), v.data() + v.size());
+              return true; },
+        [&] { v = input; parallel_quicksort(v.data(), v.data() + v.size());
+              return true; },
+        sorted);
+
+    long next = 0;
+    auto tree = make_tree(tree_depth, next);
+    long expected_sum = next * (next - 1) / 2;
+    row("`tree`", [&] { return serial_tree_sum(tree.get()); },
+        [&] { return tree_sum(tree.get()); },
+        [=](long r) { if (r != expected_sum) std::abort(); });
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
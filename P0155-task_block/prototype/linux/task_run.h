@@ -0,0 +1,489 @@
+/* task_run.h                                                         -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Linux (and other POSIX) implementation of the `task_region` prototype.
+ * The interface is that of `../windows/task_run.h`, but tasks are run by the
+ * native work-stealing scheduler in `task_scheduler.h` instead of by ConcRT.
+ *
+ * Each region uses one of two policies, chosen through `task_region_options`:
+ *
+ *  - Child stealing (the default): `task_region_handle::run` pushes the new
+ *    task onto the calling thread's deque, where it may be stolen, and the
+ *    caller continues.  `wait` and the end of the region are help-first:
+ *    the waiting thread executes queued and stolen tasks until every task
+ *    spawned in the region has finished.
+ *
+ *  - Continuation stealing (work first): the region's body runs on a
+ *    `fiber`.  `run` switches to a new fiber that executes the task at once,
+ *    after pushing the body's continuation onto the deque, where another
+ *    thread may steal and resume it.  If it has not been stolen when the
+ *    task finishes, the same thread resumes it, much as if the task had
+ *    been an ordinary function call.  `wait` and the end of the region
+ *    suspend the body until its outstanding tasks have finished; the last
+ *    of them resumes it.  A deep recursion thus keeps at most a couple of
+ *    fibers per level per thread, rather than a deque full of pending
+ *    tasks.  Code in the body may find itself on a different thread after
+ *    a call to `run` or `wait`.
+ *
+ * Under either policy the thread that enters a region is the one that
+ * leaves it, so `task_region_final` (`define_task_block_restore_thread` in
+ * P0155) behaves like `task_region`.
+ *
+ * A region can also be asked to stop running its tasks once one of them has
+ * failed.
+ *
+ * Tasks are allocated from the region's `task_arena`.  A task destroys its
+ * function object as soon as it has run, but its memory is reclaimed only
+ * when the region ends.
+ */
+
+#pragma once
+
+#include "../task_arena.h"
+#include "exception_list.h"
+#include "fiber.h"
+#include "task_scheduler.h"
+
+#include <atomic>
+#include <cassert>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class task_region_policy
+{
+    child_stealing,
+    continuation_stealing
+};
+
+// Options for a task region, e.g., `task_region({.cancel_on_failure = true},
+// f)`.
+struct task_region_options
+{
+    // Continuation stealing is available only on a thread that has a
+    // worker (see `task_scheduler::max_workers`); elsewhere the region uses
+    // child stealing.
+    task_region_policy policy = task_region_policy::child_stealing;
+
+    // Once a task or the body has exited with an exception, tasks of the
+    // region that have not started are skipped, and `run` throws
+    // `task_canceled_exception` instead of spawning.  The region still
+    // waits for the tasks already running and throws an `exception_list`.
+    bool cancel_on_failure = false;
+};
+
+// An exception recorded in a region.  Nodes are not allocated when an
+// exception is caught: each task has one, allocated with it in the region's
+// arena, and the region has one for its body.
+struct exception_list_node
+{
+    std::exception_ptr   data;
+    exception_list_node* next = nullptr;
+};
+
+class task_region_state
+{
+    // A task of a continuation-stealing region, run on its own fiber.
+    template <typename F>
+    struct fiber_task
+    {
+        F                    m_f;
+        task_region_state*   m_region;
+        exception_list_node* m_exception;   // Outlives the task
+
+        static void main(fiber*, void* p)
+        {
+            auto self = static_cast<fiber_task*>(p);
+            task_region_state* region = self->m_region;
+            try
+            {
+                if (!region->canceled())
+                    self->m_f();
+            }
+            catch (...)
+            {
+                region->add_exception(self->m_exception,
+                                      std::current_exception());
+            }
+            self->~fiber_task();
+            region->fiber_task_finished();
+        }
+    };
+
+    std::atomic<std::size_t>             m_pending{0};
+    std::atomic<exception_list_node*>    m_exception_list_head{nullptr};
+    std::atomic<bool>                    m_canceled{false};
+    const bool                           m_cancel_on_failure;
+    const task_region_policy             m_policy;
+    exception_list_node                  m_body_exception;
+    task_arena                           m_arena;
+
+    // Continuation stealing only: the fiber running the body, the number of
+    // outstanding tasks plus one for the body until it waits, and whether
+    // the body has finished.
+    fiber*                               m_body_fiber = nullptr;
+    std::atomic<std::size_t>             m_join{1};
+    std::atomic<bool>                    m_done{false};
+
+    // Post-switch actions
+    static void push_body(void* p)
+    {
+        auto self = static_cast<task_region_state*>(p);
+        task_scheduler::instance().spawn(self->m_body_fiber);
+    }
+
+    static void release_body_join(void* p)
+    {
+        auto self = static_cast<task_region_state*>(p);
+        fiber* body = self->m_body_fiber;
+        if (self->m_join.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            task_scheduler::instance().spawn(body);
+    }
+
+    // Called on a task's fiber when the task has finished.  Resume the body
+    // if its continuation has not been stolen or if it is waiting for this
+    // task alone; otherwise return to the scheduler.
+    [[noreturn]] void fiber_task_finished()
+    {
+        fiber* body = m_body_fiber;
+        task_worker* w = task_scheduler::instance().current_worker_ptr();
+        task_base* next = w->deque.pop();
+        if (next == body) {
+            m_join.fetch_sub(1, std::memory_order_acq_rel);
+            fiber::exit_to(body);
+        }
+        if (next)
+            w->deque.push(next);    // Not ours; leave it for the scheduler.
+
+        // Once the count is released, the region may end at any moment.
+        if (m_join.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            fiber::exit_to(body);
+        fiber::exit_to(nullptr);
+    }
+
+public:
+    explicit task_region_state(const task_region_options& options = {})
+        : m_cancel_on_failure(options.cancel_on_failure)
+        , m_policy(options.policy) {}
+
+    task_region_state(const task_region_state&) = delete;
+    task_region_state& operator=(const task_region_state&) = delete;
+
+    // The nodes themselves are reclaimed with the arena and the region.
+    ~task_region_state()
+    {
+        auto node = m_exception_list_head.load(std::memory_order_relaxed);
+        while (node) {
+            node->data = nullptr;
+            node = node->next;
+        }
+    }
+
+    // Record `ex` in `node`, which must not already be in the list.
+    void add_exception(exception_list_node* node, std::exception_ptr ex)
+    {
+        node->data = std::move(ex);
+        node->next = m_exception_list_head.load(std::memory_order_relaxed);
+
+        while (!m_exception_list_head.compare_exchange_weak(node->next,
+            node,
+            std::memory_order_release,
+            std::memory_order_relaxed))
+            ;
+
+        if (m_cancel_on_failure)
+            m_canceled.store(true, std::memory_order_relaxed);
+    }
+
+    void add_body_exception(std::exception_ptr ex)
+    {
+        add_exception(&m_body_exception, std::move(ex));
+    }
+
+    bool have_exceptions() const
+    {
+        return m_exception_list_head.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    bool canceled() const
+    {
+        return m_canceled.load(std::memory_order_relaxed);
+    }
+
+    [[noreturn]] void throw_exception_list()
+    {
+        std::vector<std::exception_ptr> vec;
+        auto node = m_exception_list_head.load(std::memory_order_acquire);
+        while (node) {
+            vec.push_back(node->data);
+            node = node->next;
+        }
+        throw exception_list(std::move(vec));
+    }
+
+    // Only the thread executing the region's body may allocate.
+    task_arena& arena() { return m_arena; }
+
+    void task_started()  { m_pending.fetch_add(1, std::memory_order_relaxed); }
+    void task_finished() { m_pending.fetch_sub(1, std::memory_order_release); }
+
+    bool idle() const
+    {
+        return m_pending.load(std::memory_order_acquire) == 0;
+    }
+
+    // Execute tasks until every task started in this region has finished.
+    void wait()
+    {
+        task_scheduler::instance().help_until([this] { return idle(); });
+    }
+
+    bool continuation_stealing() const
+    {
+        return m_policy == task_region_policy::continuation_stealing;
+    }
+
+    // Continuation stealing: the fiber that runs the body.
+    fiber* body_fiber() const { return m_body_fiber; }
+
+    // Continuation stealing: run `body` on a new fiber, and execute tasks
+    // until it has finished.
+    template <typename Body>
+    void run_body_on_fiber(Body& body)
+    {
+        struct entry
+        {
+            static void main(fiber*, void* p)
+            {
+                auto& [body, region] =
+                    *static_cast<std::pair<Body*, task_region_state*>*>(p);
+                (*body)();
+                region->m_done.store(true, std::memory_order_release);
+                fiber::exit_to(nullptr);
+            }
+        };
+
+        std::pair<Body*, task_region_state*> args(&body, this);
+        m_body_fiber = fiber::create(&entry::main, &args);
+        fiber::resume(m_body_fiber);
+        task_scheduler::instance().help_until([this] {
+            return m_done.load(std::memory_order_acquire);
+        });
+    }
+
+    // Continuation stealing: called from the body to run `f` at once,
+    // making the rest of the body available for stealing.
+    template <typename F>
+    void spawn_on_fiber(F&& f)
+    {
+        using Task = fiber_task<std::decay_t<F>>;
+        auto node = m_arena.create<exception_list_node>();
+        Task* task = m_arena.create<Task>(
+            Task{std::decay_t<F>(std::forward<F>(f)), this, node});
+        fiber* child = fiber::create(&Task::main, task);
+        m_join.fetch_add(1, std::memory_order_relaxed);
+        fiber::switch_to(child, &push_body, this);
+    }
+
+    // Continuation stealing: called from the body to wait for its tasks.
+    void sync()
+    {
+        if (m_join.load(std::memory_order_acquire) == 1)
+            return;
+        fiber::suspend(&release_body_join, this);
+        m_join.store(1, std::memory_order_relaxed);
+    }
+};
+
+// The region whose body (not one of its tasks) is running on this thread.
+// Reached only through this out-of-line accessor, since a continuation-
+// stealing body and the tasks it runs may move to another thread (see
+// `fiber.h`).
+TASK_BLOCK_TLS_ACCESSOR inline task_region_state*& current_task_region()
+{
+    static thread_local task_region_state* region = nullptr;
+    return region;
+}
+
+template <typename F>
+struct task_region_task : task_base
+{
+    F                    m_f;
+    task_region_state*   m_region;
+    exception_list_node* m_exception;   // Outlives the task
+
+    task_region_task(F&& f, task_region_state* region,
+                     exception_list_node* exception)
+        : task_base{&run_and_destroy}
+        , m_f(std::move(f)), m_region(region), m_exception(exception) {}
+
+    static void run_and_destroy(task_base* base)
+    {
+        auto self = static_cast<task_region_task*>(base);
+        task_region_state* region = self->m_region;
+
+        // A task is not the body of any region, even if it runs on a thread
+        // that is waiting in one.
+        auto saved = std::exchange(current_task_region(), nullptr);
+        try
+        {
+            if (!region->canceled())
+                self->m_f();
+        }
+        catch (...)
+        {
+            region->add_exception(self->m_exception, std::current_exception());
+        }
+        current_task_region() = saved;
+
+        self->~task_region_task();
+        region->task_finished();  // `region` may be destroyed after this
+    }
+};
+
+class task_region_handle
+{
+private:
+    task_region_state * pstate_;
+
+    template<typename F>
+    friend void task_region(const task_region_options& options, F&& f);
+
+
+    task_region_handle(task_region_state *pstate)
+        : pstate_(pstate){}
+
+    ~task_region_handle() {}
+
+public:
+    task_region_handle(const task_region_handle&) = delete;
+    task_region_handle& operator=(const task_region_handle&) = delete;
+    task_region_handle* operator&() const = delete;
+
+    template<typename F>
+    void run(F&& f)
+    {
+        if (pstate_->continuation_stealing()) {
+            // User error: `run` called from outside the region's body
+            assert(fiber::current() == pstate_->body_fiber());
+
+            if (pstate_->canceled())
+                throw task_canceled_exception();
+            pstate_->spawn_on_fiber(std::forward<F>(f));
+            return;
+        }
+
+        // User error: `run` called from outside the region's body
+        assert(current_task_region() == pstate_);
+
+        if (pstate_->canceled())
+            throw task_canceled_exception();
+
+        using Task = task_region_task<std::decay_t<F>>;
+        task_arena& arena = pstate_->arena();
+        auto node = arena.create<exception_list_node>();
+        Task* task = arena.create<Task>(
+            std::decay_t<F>(std::forward<F>(f)), pstate_, node);
+        pstate_->task_started();
+        task_scheduler::instance().spawn(task);
+    }
+
+    void wait()
+    {
+        if (pstate_->continuation_stealing()) {
+            assert(fiber::current() == pstate_->body_fiber());
+            pstate_->sync();
+            return;
+        }
+
+        assert(current_task_region() == pstate_);
+        pstate_->wait();
+    }
+};
+
+template<typename F>
+void task_region(const task_region_options& options, F && f)
+{
+    struct restore_tls {
+        task_region_state* m_old_state = current_task_region();
+        ~restore_tls()
+        {
+            current_task_region() = m_old_state;
+        }
+    }_;
+
+    task_region_options effective = options;
+    if (!task_scheduler::instance().current_worker_ptr())
+        effective.policy = task_region_policy::child_stealing;
+
+    task_region_state state(effective);
+    current_task_region() = &state;
+    task_region_handle trh(&state);
+
+    auto body = [&] {
+        try
+        {
+            f(trh);
+        }
+        catch (const task_canceled_exception&)
+        {
+            // Thrown by `run` after the failure that canceled the region,
+            // which has already been recorded.
+            if (!state.canceled())
+                state.add_body_exception(std::current_exception());
+        }
+        catch (...)
+        {
+            state.add_body_exception(std::current_exception());
+        }
+    };
+
+    if (state.continuation_stealing())
+    {
+        auto body_and_sync = [&] {
+            body();
+            state.sync();
+        };
+        state.run_body_on_fiber(body_and_sync);
+    }
+    else
+    {
+        body();
+
+        // This cannot throw, because task exceptions have been wrapped and
+        // handled
+        state.wait();
+    }
+
+    if (state.have_exceptions())
+    {
+        state.throw_exception_list();
+    }
+}
+
+template<typename F>
+void task_region(F && f)
+{
+    task_region(task_region_options{}, std::forward<F>(f));
+}
+
+// With child stealing, the thread that calls `task_region_final` is always
+// the one that returns from it.
+template<typename F>
+void task_region_final(const task_region_options& options, F && f)
+{
+    task_region(options, std::forward<F>(f));
+}
+
+template<typename F>
+void task_region_final(F && f)
+{
+    task_region(std::forward<F>(f));
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
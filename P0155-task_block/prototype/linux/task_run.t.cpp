@@ -0,0 +1,298 @@
+/* task_run.t.cpp                                                     -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Tests for the Linux `task_region` prototype and its work-stealing deque.
+ * The tests of regions are run once for each `task_region_policy`.
+ */
+
+#include "task_run.h"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Single-threaded LIFO/FIFO behavior, then one owner racing several thieves:
+// every pushed element is taken exactly once.
+void test_deque()
+{
+    work_stealing_deque<int*> d(2);
+    int v[5] = {};
+    assert(d.empty() && !d.pop() && !d.steal());
+    for (int& i : v)
+        d.push(&i);                 // Grows from 2 to 8
+    assert(&v[0] == d.steal());
+    assert(&v[4] == d.pop());
+    assert(&v[1] == d.steal());
+    assert(&v[3] == d.pop());
+    assert(&v[2] == d.pop());
+    assert(d.empty() && !d.pop());
+
+    constexpr int n = 100000, thieves = 3;
+    std::vector<int> items(n);
+    std::vector<std::atomic<int>> taken(n);
+    std::atomic<bool> done{false};
+    work_stealing_deque<int*> shared(4);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thieves; ++t)
+        threads.emplace_back([&] {
+            while (!done.load()) {
+                if (int* p = shared.steal())
+                    ++taken[p - items.data()];
+            }
+        });
+    for (int i = 0; i < n; ++i) {
+        shared.push(&items[i]);
+        if (i % 3 == 0)
+            if (int* p = shared.pop())
+                ++taken[p - items.data()];
+    }
+    while (int* p = shared.pop())
+        ++taken[p - items.data()];
+    done = true;
+    for (auto& t : threads)
+        t.join();
+    for (auto& t : taken)
+        assert(1 == t.load());
+}
+
+// Allocations are aligned and disjoint, and a later arena on the same
+// thread reuses the chunks of an earlier one.
+void test_arena()
+{
+    void* first;
+    {
+        task_arena arena;
+        first = arena.allocate(1, 1);
+    }
+    {
+        task_arena arena;
+        assert(first == arena.allocate(1, 1));
+
+        struct alignas(64) wide { char c[200]; };
+        std::vector<wide*> v;
+        for (int i = 0; i < 1000; ++i) {
+            v.push_back(arena.create<wide>());
+            assert(0 == reinterpret_cast<std::uintptr_t>(v.back()) % 64);
+            std::memset(v.back()->c, i % 128, sizeof(wide));
+        }
+        for (int i = 0; i < 1000; ++i)
+            assert(i % 128 == v[i]->c[0] && i % 128 == v[i]->c[199]);
+
+        // Larger than any chunk so far
+        void* big = arena.allocate(3 * task_arena::max_chunk_size, 8);
+        std::memset(big, 0, 3 * task_arena::max_chunk_size);
+    }
+}
+
+// Policy used by the region tests
+task_region_options options;
+
+long fib(int n)
+{
+    if (n < 2)
+        return n;
+    long x, y;
+    task_region(options, [&](task_region_handle& trh) {
+        trh.run([&] { x = fib(n - 1); });
+        y = fib(n - 2);
+    });
+    return x + y;
+}
+
+void test_fib()
+{
+    assert(6765 == fib(20));
+}
+
+void test_wait()
+{
+    std::vector<int> v(1000);
+    task_region(options, [&](task_region_handle& trh) {
+        for (std::size_t i = 0; i < v.size(); ++i)
+            trh.run([&v, i] { v[i] = int(i); });
+        trh.wait();
+
+        // All tasks above have finished.
+        assert(999 * 1000 / 2 == std::accumulate(v.begin(), v.end(), 0));
+        for (std::size_t i = 0; i < v.size(); ++i)
+            trh.run([&v, i] { v[i] *= 2; });
+    });
+    assert(999 * 1000 == std::accumulate(v.begin(), v.end(), 0));
+}
+
+// Tasks run on more than one thread when the pool has workers.
+void test_threads()
+{
+    std::mutex mutex;
+    std::set<std::thread::id> ids;
+    task_region_final(options, [&](task_region_handle& trh) {
+        for (int i = 0; i < 64; ++i)
+            trh.run([&] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::lock_guard<std::mutex> lock(mutex);
+                ids.insert(std::this_thread::get_id());
+            });
+    });
+    assert(task_scheduler::instance().pool_size() == 0 || ids.size() > 1);
+}
+
+void test_exceptions()
+{
+    std::atomic<int> ran{0};
+    try {
+        task_region(options, [&](task_region_handle& trh) {
+            for (int i = 0; i < 10; ++i)
+                trh.run([&ran, i] {
+                    ++ran;
+                    if (i % 3 == 0)
+                        throw std::runtime_error(std::to_string(i));
+                });
+            throw std::logic_error("body");
+        });
+        assert(false);
+    }
+    catch (const exception_list& el) {
+        assert(5 == el.size());     // Tasks 0, 3, 6 and 9, and the body
+        int logic = 0;
+        for (auto& e : el) {
+            try { std::rethrow_exception(e); }
+            catch (const std::logic_error&) { ++logic; }
+            catch (const std::runtime_error&) { }
+        }
+        assert(1 == logic);
+    }
+    assert(10 == ran);
+}
+
+// With `cancel_on_failure`, the first failure stops the region: tasks not yet
+// started are skipped and `run` stops spawning.
+void test_cancel()
+{
+    constexpr int n = 1000;
+    std::atomic<int> ran{0};
+    int spawned = 0;
+    task_region_options cancel = options;
+    cancel.cancel_on_failure = true;
+    try {
+        task_region(cancel, [&](task_region_handle& trh) {
+            for (int i = 0; i < n; ++i, ++spawned)
+                trh.run([&ran] {
+                    ++ran;
+                    throw std::runtime_error("task");
+                });
+        });
+        assert(false);
+    }
+    catch (const exception_list& el) {
+        // Only tasks that started before the cancellation was seen ran.
+        assert(ran == int(el.size()));
+        assert(1 <= ran && ran < n);
+    }
+    assert(0 < spawned && spawned <= n);
+
+    // Without a failure, nothing is canceled.
+    ran = 0;
+    task_region(cancel, [&](task_region_handle& trh) {
+        for (int i = 0; i < n; ++i)
+            trh.run([&ran] { ++ran; });
+    });
+    assert(n == ran);
+}
+
+// Capture-heavy tasks, more than fit in the first few chunks
+void test_large_tasks()
+{
+    struct payload { std::array<long, 64> v; };
+    std::atomic<long> sum{0};
+    task_region(options, [&](task_region_handle& trh) {
+        for (int i = 0; i < 2000; ++i) {
+            payload p;
+            p.v.fill(i);
+            trh.run([&sum, p] { sum += p.v[0] + p.v[63]; });
+        }
+    });
+    assert(2 * 1999 * 2000 / 2 == sum);
+}
+
+// Regions nest, and tasks spawned from other threads' tasks are counted in
+// their own regions.
+void test_nested()
+{
+    std::atomic<int> leaves{0};
+    task_region(options, [&](task_region_handle& outer) {
+        for (int i = 0; i < 8; ++i)
+            outer.run([&] {
+                task_region(options, [&](task_region_handle& inner) {
+                    for (int j = 0; j < 8; ++j)
+                        inner.run([&] { ++leaves; });
+                });
+            });
+    });
+    assert(64 == leaves);
+}
+
+// The thread that enters a region leaves it, and, with continuation
+// stealing, a long loop of `run` calls needs only a few fibers, since each
+// task's fiber is recycled when it finishes.
+void test_continuations()
+{
+    std::thread::id entered = std::this_thread::get_id();
+    std::size_t stacks = fiber::stacks_allocated();
+    fiber::reset_peak_live();
+    std::atomic<int> count{0};
+    task_region_final(options, [&](task_region_handle& trh) {
+        for (int i = 0; i < 10000; ++i)
+            trh.run([&count] { ++count; });
+        trh.wait();
+        assert(10000 == count);
+        trh.run([&count] { ++count; });
+    });
+    assert(10001 == count);
+    assert(entered == std::this_thread::get_id());
+    assert(fiber::stacks_allocated() - stacks < 100);
+    if (options.policy == task_region_policy::continuation_stealing)
+        assert(0 < fiber::peak_live() && fiber::peak_live() < 100);
+    else
+        assert(0 == fiber::peak_live());
+}
+
+int main()
+{
+    // Exercise stealing even on a machine with a single hardware thread.
+    if (!std::getenv("TASK_BLOCK_WORKERS"))
+        setenv("TASK_BLOCK_WORKERS", "3", 1);
+
+    test_deque();
+    test_arena();
+
+    for (auto policy : { task_region_policy::child_stealing,
+                         task_region_policy::continuation_stealing }) {
+        options.policy = policy;
+        test_fib();
+        test_wait();
+        test_threads();
+        test_exceptions();
+        test_cancel();
+        test_large_tasks();
+        test_nested();
+        test_continuations();
+    }
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,450 @@
+/* task_scheduler.h                                                   -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Work-stealing scheduler underlying the Linux `task_region` prototype.
+ *
+ * Each participating thread owns a `task_worker`, which holds a Chase-Lev
+ * deque of ready tasks.  A thread pushes the tasks it spawns onto the bottom
+ * of its own deque and pops from there (LIFO, for locality); an idle thread
+ * steals from the top of a randomly chosen victim's deque (FIFO, so it takes
+ * the oldest and typically largest piece of work).  The scheduler starts a
+ * pool of worker threads on first use; any other thread that spawns tasks is
+ * registered as an additional, non-pool worker so that its tasks can be
+ * stolen, and it executes tasks itself while it waits ("help-first" wait).
+ *
+ * The pool size is `std::thread::hardware_concurrency() - 1`, since the
+ * thread that enters a task region also works, unless overridden by the
+ * `TASK_BLOCK_WORKERS` environment variable, which is read once, when the
+ * scheduler is first used.
+ *
+ * With `TASK_BLOCK_STATS` defined, the scheduler also keeps the per-worker
+ * counters and trace described in `task_stats.h`.
+ */
+
+#pragma once
+
+#include "../task_arena.h"   // TASK_BLOCK_TLS_ACCESSOR
+#include "task_stats.h"
+#include "work_stealing_deque.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A unit of work.  `execute` runs the task and then destroys it.
+struct task_base
+{
+    void (*execute)(task_base*);
+};
+
+struct task_worker
+{
+    work_stealing_deque<task_base*>  deque;
+    std::minstd_rand                 rng;
+    std::atomic<bool>                in_use{false};
+    std::size_t                      index;
+
+    // Instrumentation only; written by the thread that owns the worker.
+    task_worker_stats                stats;
+    std::vector<task_span>           spans;
+
+    explicit task_worker(std::size_t i) : rng(unsigned(i + 1)), index(i) {}
+};
+
+class task_scheduler
+{
+public:
+    // Maximum number of threads (pool and others) with a worker at once.
+    // Further threads run the tasks they spawn immediately.
+    static constexpr std::size_t max_workers = 256;
+
+private:
+    std::array<std::atomic<task_worker*>, max_workers> m_workers{};
+    std::atomic<std::size_t>    m_num_workers{0};  // High-water mark
+    std::mutex                  m_register_mutex;
+
+    std::vector<std::thread>    m_pool;
+    std::atomic<bool>           m_stop{false};
+
+    // Sleeping pool threads wait for `m_epoch` to change; a spawn advances it
+    // only if there are sleepers.
+    std::atomic<std::uint32_t>  m_epoch{0};
+    std::atomic<int>            m_sleepers{0};
+
+    // Instrumentation only
+    std::atomic<bool>           m_tracing{false};
+    std::uint64_t               m_trace_origin = 0;
+    std::string                 m_trace_path;   // From `TASK_BLOCK_TRACE`
+
+    static inline thread_local task_worker* tls_worker = nullptr;
+
+    // Releases the calling thread's worker, for reuse, at thread exit.
+    struct worker_lease
+    {
+        task_worker* worker = nullptr;
+        ~worker_lease()
+        {
+            if (worker)
+                worker->in_use.store(false, std::memory_order_release);
+        }
+    };
+
+    task_scheduler()
+    {
+        std::size_t pool = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+        if (const char* env = std::getenv("TASK_BLOCK_WORKERS"))
+            pool = std::strtoul(env, nullptr, 10);
+        pool = std::min(pool, max_workers / 2);
+
+        if constexpr (task_block_stats) {
+            if (const char* env = std::getenv("TASK_BLOCK_TRACE")) {
+                m_trace_path = env;
+                start_trace();
+            }
+        }
+
+        m_pool.reserve(pool);
+        for (std::size_t i = 0; i < pool; ++i)
+            m_pool.emplace_back([this] { worker_loop(); });
+    }
+
+    // Give the calling thread a worker, reusing a released one if possible.
+    // Return null if all `max_workers` are in use.
+    task_worker* acquire_worker()
+    {
+        std::lock_guard<std::mutex> lock(m_register_mutex);
+        std::size_t n = m_num_workers.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < n; ++i) {
+            task_worker* w = m_workers[i].load(std::memory_order_relaxed);
+            bool expected = false;
+            if (w->in_use.compare_exchange_strong(expected, true))
+                return w;
+        }
+        if (n == max_workers)
+            return nullptr;
+
+        // Workers are never freed before the scheduler, since a thief may
+        // be reading a worker's deque at any time.
+        task_worker* w = new task_worker(n);
+        w->in_use.store(true, std::memory_order_relaxed);
+        m_workers[n].store(w, std::memory_order_release);
+        m_num_workers.store(n + 1, std::memory_order_release);
+        return w;
+    }
+
+    // Steal one task from a random victim other than `self`.
+    task_base* steal(task_worker& self)
+    {
+        std::size_t n = m_num_workers.load(std::memory_order_acquire);
+        if (n < 2)
+            return nullptr;
+        std::size_t start = self.rng() % n;
+        for (std::size_t k = 0; k < n; ++k) {
+            std::size_t v = (start + k) % n;
+            if (v == self.index)
+                continue;
+            task_worker* victim = m_workers[v].load(std::memory_order_acquire);
+            if (task_base* t = victim->deque.steal())
+                return t;
+            if constexpr (task_block_stats)
+                self.stats.failed_steals.add(1);
+        }
+        return nullptr;
+    }
+
+    // Pop a task from `self`'s deque or, failing that, steal one.
+    task_base* take(task_worker& self, bool& stolen)
+    {
+        stolen = false;
+        if (task_base* t = self.deque.pop())
+            return t;
+        task_base* t = steal(self);
+        stolen = t != nullptr;
+        return t;
+    }
+
+    // Execute `t`, which `self` has taken.
+    void run(task_worker& self, task_base* t, bool stolen)
+    {
+        if constexpr (task_block_stats) {
+            self.stats.executed.add(1);
+            if (stolen)
+                self.stats.stolen.add(1);
+            if (m_tracing.load(std::memory_order_relaxed)) {
+                std::uint64_t begin = task_stats_now();
+                t->execute(t);
+                self.spans.push_back({ begin, task_stats_now(),
+                    stolen ? task_span::stolen_task : task_span::task });
+                return;
+            }
+        }
+        t->execute(t);
+    }
+
+    void worker_loop()
+    {
+        task_worker& self = current_worker();
+        while (!m_stop.load(std::memory_order_relaxed)) {
+            bool stolen;
+            task_base* t = take(self, stolen);
+
+            // Spin briefly before going to sleep.
+            std::uint64_t idle_begin = 0;
+            if (task_block_stats && !t)
+                idle_begin = task_stats_now();
+            for (int spin = 0; spin < 64 && !t; ++spin) {
+                std::this_thread::yield();
+                t = take(self, stolen);
+            }
+            if (!t) {
+                m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+                std::uint32_t epoch = m_epoch.load(std::memory_order_seq_cst);
+                if (!m_stop.load(std::memory_order_relaxed) &&
+                    !(t = take(self, stolen)))
+                    m_epoch.wait(epoch, std::memory_order_seq_cst);
+                m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+            }
+            if constexpr (task_block_stats) {
+                if (idle_begin)
+                    self.stats.idle_ns.add(task_stats_now() - idle_begin);
+            }
+
+            if (t)
+                run(self, t, stolen);
+        }
+    }
+
+    // `help_until`, counting the time spent with nothing to execute and
+    // recording the whole wait in the trace.
+    template <typename Pred>
+    void help_until_instrumented(task_worker& self, Pred done)
+    {
+        std::uint64_t begin = task_stats_now();
+        std::uint64_t idle_begin = 0;
+        unsigned idle = 0;
+        while (!done()) {
+            bool stolen;
+            if (task_base* t = take(self, stolen)) {
+                if (idle_begin) {
+                    self.stats.wait_ns.add(task_stats_now() - idle_begin);
+                    idle_begin = 0;
+                }
+                run(self, t, stolen);
+                idle = 0;
+            }
+            else {
+                if (!idle_begin)
+                    idle_begin = task_stats_now();
+                if (++idle > 16)
+                    std::this_thread::yield();
+            }
+        }
+
+        std::uint64_t end = task_stats_now();
+        if (idle_begin)
+            self.stats.wait_ns.add(end - idle_begin);
+        if (m_tracing.load(std::memory_order_relaxed))
+            self.spans.push_back({ begin, end, task_span::wait });
+    }
+
+public:
+    static task_scheduler& instance()
+    {
+        static task_scheduler s;
+        return s;
+    }
+
+    ~task_scheduler()
+    {
+        m_stop.store(true, std::memory_order_relaxed);
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        m_epoch.notify_all();
+        for (auto& t : m_pool)
+            t.join();
+        if (!m_trace_path.empty()) {
+            std::ofstream out(m_trace_path);
+            write_trace(out);
+        }
+        for (std::size_t i = 0; i < m_num_workers.load(); ++i)
+            delete m_workers[i].load();
+    }
+
+    task_scheduler(const task_scheduler&) = delete;
+    task_scheduler& operator=(const task_scheduler&) = delete;
+
+    std::size_t pool_size() const { return m_pool.size(); }
+
+    // Return the calling thread's worker, registering the thread on first
+    // use, or null if no worker is available.
+    TASK_BLOCK_TLS_ACCESSOR task_worker* current_worker_ptr()
+    {
+        if (!tls_worker) {
+            static thread_local worker_lease lease;
+            lease.worker = tls_worker = acquire_worker();
+        }
+        return tls_worker;
+    }
+
+    task_worker& current_worker() { return *current_worker_ptr(); }
+
+    // Make `t` available for execution by any worker.
+    void spawn(task_base* t)
+    {
+        task_worker* w = current_worker_ptr();
+        if (!w) {
+            t->execute(t);
+            return;
+        }
+        w->deque.push(t);
+        if constexpr (task_block_stats)
+            w->stats.spawned.add(1);
+
+        // Wake a sleeper.  The fence orders the push before the load of
+        // `m_sleepers`, pairing with the increment in `worker_loop`: either
+        // this thread sees the sleeper, or the sleeper sees the task.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepers.load(std::memory_order_relaxed) > 0) {
+            m_epoch.fetch_add(1, std::memory_order_seq_cst);
+            m_epoch.notify_one();
+        }
+    }
+
+    // Run one task from `self`'s deque or, failing that, one stolen task.
+    // Return false if no task was found.
+    bool try_run_one(task_worker& self)
+    {
+        bool stolen;
+        task_base* t = take(self, stolen);
+        if (!t)
+            return false;
+        run(self, t, stolen);
+        return true;
+    }
+
+    // Execute tasks until `done()` returns true.
+    template <typename Pred>
+    void help_until(Pred done)
+    {
+        task_worker* self = current_worker_ptr();
+        if constexpr (task_block_stats) {
+            if (self) {
+                help_until_instrumented(*self, done);
+                return;
+            }
+        }
+
+        unsigned idle = 0;
+        while (!done()) {
+            if (self && try_run_one(*self))
+                idle = 0;
+            else if (++idle > 16)
+                std::this_thread::yield();
+        }
+    }
+
+    // Instrumentation.  Without `TASK_BLOCK_STATS`, every counter reads as
+    // zero and the trace is empty.
+
+    // Return the counters of every worker so far.
+    std::vector<task_worker_stats_snapshot> stats() const
+    {
+        std::vector<task_worker_stats_snapshot> ret;
+        std::size_t n = m_num_workers.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < n; ++i) {
+            const task_worker_stats& s =
+                m_workers[i].load(std::memory_order_acquire)->stats;
+            ret.push_back({ i, s.spawned.get(), s.executed.get(),
+                            s.stolen.get(), s.failed_steals.get(),
+                            s.idle_ns.get(), s.wait_ns.get() });
+        }
+        return ret;
+    }
+
+    void reset_stats()
+    {
+        std::size_t n = m_num_workers.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < n; ++i)
+            m_workers[i].load(std::memory_order_acquire)->stats.reset();
+    }
+
+    // Print the counters as a Markdown table.
+    void print_stats(std::ostream& os) const
+    {
+        os << "| Worker | Spawned | Executed | Stolen | Failed steals "
+              "| Idle (ms) | Waiting (ms) |\n"
+              "| -----: | ------: | -------: | -----: | ------------: "
+              "| --------: | -----------: |\n";
+        for (const auto& s : stats())
+            os << "| " << s.worker << " | " << s.spawned << " | "
+               << s.executed << " | " << s.stolen << " | "
+               << s.failed_steals << " | " << s.idle_ns / 1e6 << " | "
+               << s.wait_ns / 1e6 << " |\n";
+    }
+
+    // Start recording spans, discarding those recorded before.  Neither
+    // this nor `write_trace` may be called while a task region is running.
+    void start_trace()
+    {
+        std::size_t n = m_num_workers.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < n; ++i)
+            m_workers[i].load(std::memory_order_acquire)->spans.clear();
+        m_trace_origin = task_stats_now();
+        m_tracing.store(true, std::memory_order_relaxed);
+    }
+
+    void stop_trace() { m_tracing.store(false, std::memory_order_relaxed); }
+
+    // Write `ns` nanoseconds as microseconds with three decimals.
+    static void put_microseconds(std::ostream& os, std::uint64_t ns)
+    {
+        char frac[4] = { char('0' + ns / 100 % 10), char('0' + ns / 10 % 10),
+                         char('0' + ns % 10), '\0' };
+        os << ns / 1000 << '.' << frac;
+    }
+
+    // Write the recorded spans as a Chrome trace-event JSON object, with one
+    // track per worker and timestamps in microseconds since `start_trace`.
+    void write_trace(std::ostream& os) const
+    {
+        static constexpr const char* names[] = { "task", "stolen task",
+                                                 "wait" };
+        os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        const char* sep = "\n";
+        std::size_t n = m_num_workers.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < n; ++i) {
+            os << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+               << "\"tid\":" << i << ",\"args\":{\"name\":\"worker " << i
+               << "\"}}";
+            sep = ",\n";
+            const task_worker* w = m_workers[i].load(std::memory_order_acquire);
+            for (const task_span& span : w->spans) {
+                if (span.begin < m_trace_origin)
+                    continue;
+                os << sep << "{\"name\":\"" << names[span.kind]
+                   << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << i
+                   << ",\"ts\":";
+                put_microseconds(os, span.begin - m_trace_origin);
+                os << ",\"dur\":";
+                put_microseconds(os, span.end - span.begin);
+                os << "}";
+            }
+        }
+        os << "\n]}\n";
+    }
+};
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,115 @@
+/* task_stats.h                                                       -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Opt-in instrumentation of the work-stealing scheduler.  Define
+ * `TASK_BLOCK_STATS` before including any of the prototype's headers (or on
+ * the command line) to have every worker count
+ *
+ *  - tasks spawned onto its deque, tasks executed, and of those, tasks
+ *    stolen from another worker,
+ *  - steal attempts that found a victim's deque empty (or lost a race),
+ *  - nanoseconds spent idle in the pool's worker loop, and
+ *  - nanoseconds spent in `wait` (including the end of a region) with
+ *    nothing to execute.
+ *
+ * A continuation-stealing body suspended in `sync` is not counted in
+ * `wait_ns` or traced as a wait: its worker is free while it is suspended,
+ * and that time is counted as whatever the worker does instead (executing
+ * tasks or idling).
+ *
+ * Between `task_scheduler::start_trace` and `stop_trace`, each worker also
+ * records a span for every task it executes and for every wait, which
+ * `write_trace` exports in the Chrome trace-event format (load the file in
+ * chrome://tracing or https://ui.perfetto.dev).  Setting the environment
+ * variable `TASK_BLOCK_TRACE` to a file name traces the whole run and writes
+ * the file at exit.
+ *
+ * Without `TASK_BLOCK_STATS`, none of this code is executed and the
+ * scheduler's fast paths are unchanged.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#ifdef TASK_BLOCK_STATS
+inline constexpr bool task_block_stats = true;
+#else
+inline constexpr bool task_block_stats = false;
+#endif
+
+// A counter written only by its owning worker and readable by any thread.
+class task_stat_counter
+{
+    std::atomic<std::uint64_t> m_value{0};
+
+public:
+    void add(std::uint64_t n)
+    {
+        m_value.store(m_value.load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed);
+    }
+
+    void reset() { m_value.store(0, std::memory_order_relaxed); }
+
+    std::uint64_t get() const
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+};
+
+struct task_worker_stats
+{
+    task_stat_counter spawned;
+    task_stat_counter executed;
+    task_stat_counter stolen;
+    task_stat_counter failed_steals;
+    task_stat_counter idle_ns;
+    task_stat_counter wait_ns;
+
+    void reset()
+    {
+        for (auto c : { &spawned, &executed, &stolen, &failed_steals,
+                        &idle_ns, &wait_ns })
+            c->reset();
+    }
+};
+
+// A snapshot of one worker's counters.
+struct task_worker_stats_snapshot
+{
+    std::size_t   worker;
+    std::uint64_t spawned;
+    std::uint64_t executed;
+    std::uint64_t stolen;
+    std::uint64_t failed_steals;
+    std::uint64_t idle_ns;
+    std::uint64_t wait_ns;
+};
+
+// An interval recorded for the trace, in nanoseconds of `task_stats_now`.
+struct task_span
+{
+    enum kind_t : std::uint8_t { task, stolen_task, wait };
+
+    std::uint64_t begin;
+    std::uint64_t end;
+    kind_t        kind;
+};
+
+// Nanoseconds since an arbitrary, fixed origin.
+inline std::uint64_t task_stats_now()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,125 @@
+/* task_stats.t.cpp                                                   -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Tests for the scheduler instrumentation enabled by `TASK_BLOCK_STATS`.
+ */
+
+#define TASK_BLOCK_STATS
+
+#include "task_run.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+
+struct totals
+{
+    std::uint64_t spawned = 0, executed = 0, stolen = 0, wait_ns = 0;
+};
+
+totals sum_stats()
+{
+    totals t;
+    for (const auto& s : task_scheduler::instance().stats()) {
+        t.spawned += s.spawned;
+        t.executed += s.executed;
+        t.stolen += s.stolen;
+        t.wait_ns += s.wait_ns;
+    }
+    return t;
+}
+
+std::size_t count(const std::string& s, const std::string& what)
+{
+    std::size_t n = 0;
+    for (auto pos = s.find(what); pos != s.npos; pos = s.find(what, pos + 1))
+        ++n;
+    return n;
+}
+
+// Every child-stealing task is counted once as spawned and once as executed.
+void test_counters()
+{
+    task_scheduler& sched = task_scheduler::instance();
+    sched.reset_stats();
+    task_region([](task_region_handle& trh) {
+        for (int i = 0; i < 1000; ++i)
+            trh.run([] { });
+    });
+    totals t = sum_stats();
+    assert(1000 == t.spawned && 1000 == t.executed);
+    assert(t.stolen <= t.executed);
+
+    // Slow tasks are stolen by the pool.
+    sched.reset_stats();
+    task_region([](task_region_handle& trh) {
+        for (int i = 0; i < 32; ++i)
+            trh.run([] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            });
+    });
+    t = sum_stats();
+    assert(32 == t.executed);
+    assert(sched.pool_size() == 0 || t.stolen > 0);
+
+    // A task stolen while the body sleeps outlives the body, so the end of
+    // the region waits for it.
+    if (sched.pool_size() > 0) {
+        sched.reset_stats();
+        task_region([](task_region_handle& trh) {
+            trh.run([] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        });
+        t = sum_stats();
+        assert(1 == t.stolen && t.wait_ns > 0);
+    }
+
+    std::ostringstream table;
+    sched.print_stats(table);
+    assert(1 + 1 + sched.stats().size() == count(table.str(), "\n"));
+}
+
+// Every executed task appears in the trace, as does the wait at the end of
+// the region.
+void test_trace()
+{
+    task_scheduler& sched = task_scheduler::instance();
+    sched.reset_stats();
+    sched.start_trace();
+    task_region([](task_region_handle& trh) {
+        for (int i = 0; i < 100; ++i)
+            trh.run([] { });
+    });
+    sched.stop_trace();
+    task_region([](task_region_handle& trh) { trh.run([] { }); });
+
+    std::ostringstream os;
+    sched.write_trace(os);
+    std::string json = os.str();
+    assert(0 == json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    assert(json.ends_with("]}\n"));
+    assert(100 == count(json, "\"name\":\"task\"") +
+                  count(json, "\"name\":\"stolen task\""));
+    assert(1 <= count(json, "\"name\":\"wait\""));
+    assert(sched.stats().size() == count(json, "\"thread_name\""));
+}
+
+int main()
+{
+    if (!std::getenv("TASK_BLOCK_WORKERS"))
+        setenv("TASK_BLOCK_WORKERS", "3", 1);
+
+    test_counters();
+    test_trace();
+}
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -0,0 +1,156 @@
+/* work_stealing_deque.h                                              -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Chase-Lev work-stealing deque, using the C11 memory-model formulation of
+ * Lê, Pop, Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing
+ * for Weak Memory Models" (PPoPP 2013).
+ *
+ * The owning thread pushes and pops at the bottom without contention; any
+ * other thread may steal from the top.  The only contended operation is a
+ * CAS on `top`, taken by thieves and by the owner when it pops the last
+ * element.  The circular buffer grows geometrically when full.  A buffer
+ * that has been replaced may still be read by a thief that loaded it before
+ * the replacement, so replaced buffers are kept until the deque is
+ * destroyed.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// `T` must be a pointer (or other trivially copyable, lock-free) type; a
+// default-constructed `T` is returned to mean "empty".
+template <typename T>
+class work_stealing_deque
+{
+    struct circular_array
+    {
+        std::int64_t                    mask;   // capacity - 1
+        std::unique_ptr<std::atomic<T>[]> buf;
+
+        explicit circular_array(std::int64_t capacity)
+            : mask(capacity - 1), buf(new std::atomic<T>[capacity]) {}
+
+        std::int64_t capacity() const { return mask + 1; }
+
+        T get(std::int64_t i) const
+        {
+            return buf[i & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(std::int64_t i, T x)
+        {
+            buf[i & mask].store(x, std::memory_order_relaxed);
+        }
+    };
+
+    // `top` and `bottom` are written by different threads; keep them on
+    // separate cache lines.
+    alignas(64) std::atomic<std::int64_t>   m_top{0};
+    alignas(64) std::atomic<std::int64_t>   m_bottom{0};
+    std::atomic<circular_array*>            m_array;
+
+    // Owned by the owning thread: the current buffer and all replaced ones.
+    std::vector<std::unique_ptr<circular_array>> m_buffers;
+
+    circular_array* grow(circular_array* a, std::int64_t b, std::int64_t t)
+    {
+        auto bigger = std::make_unique<circular_array>(2 * a->capacity());
+        for (std::int64_t i = t; i != b; ++i)
+            bigger->put(i, a->get(i));
+        circular_array* ret = bigger.get();
+        m_buffers.push_back(std::move(bigger));
+        m_array.store(ret, std::memory_order_release);
+        return ret;
+    }
+
+public:
+    explicit work_stealing_deque(std::int64_t initial_capacity = 256)
+    {
+        m_buffers.push_back(
+            std::make_unique<circular_array>(initial_capacity));
+        m_array.store(m_buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    work_stealing_deque(const work_stealing_deque&) = delete;
+    work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+    // Owner only.
+    void push(T x)
+    {
+        std::int64_t b = m_bottom.load(std::memory_order_relaxed);
+        std::int64_t t = m_top.load(std::memory_order_acquire);
+        circular_array* a = m_array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity() - 1)
+            a = grow(a, b, t);
+        a->put(b, x);
+
+        // The paper uses a release fence followed by a relaxed store; a
+        // release store is equivalent here, costs the same, and is
+        // understood by ThreadSanitizer.
+        m_bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only.  Return the most recently pushed element, or `T()`.
+    T pop()
+    {
+        std::int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        circular_array* a = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = m_top.load(std::memory_order_relaxed);
+
+        T x{};
+        if (t <= b) {
+            x = a->get(b);
+            if (t == b) {
+                // Last element: race against thieves for it.
+                if (!m_top.compare_exchange_strong(t, t + 1,
+                                                   std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed))
+                    x = T{};
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        return x;
+    }
+
+    // Any thread.  Return the least recently pushed element, or `T()` if the
+    // deque is empty or the steal lost a race.
+    T steal()
+    {
+        std::int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return T{};
+
+        circular_array* a = m_array.load(std::memory_order_acquire);
+        T x = a->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed))
+            return T{};
+        return x;
+    }
+
+    // Approximate when called concurrently with `push`, `pop` or `steal`.
+    bool empty() const
+    {
+        return m_bottom.load(std::memory_order_relaxed) <=
+            m_top.load(std::memory_order_relaxed);
+    }
+};
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
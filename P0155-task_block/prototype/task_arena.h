@@ -0,0 +1,206 @@
+/* task_arena.h                                                       -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Bump-pointer arena for the task handles of one task region, shared by the
+ * Windows and Linux prototypes.
+ *
+ * Memory is carved out of a list of chunks.  Each new chunk is twice the
+ * size of the previous one (up to `max_chunk_size`), so a region that spawns
+ * `n` tasks makes O(log n) chunk allocations; an object too large for the
+ * next chunk gets a chunk of its own.  Nothing is freed individually: when
+ * the arena is destroyed its chunks go to a per-thread cache, from which the
+ * next region on the same thread takes them, so a thread that runs many
+ * regions in sequence (e.g., the recursion of a divide-and-conquer
+ * algorithm) reaches a steady state with no heap allocation at all.
+ *
+ * An arena is not thread safe: only the region's body may allocate from it.
+ * Any thread may use the memory.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#ifdef TRACE_ALLOCATIONS
+#include <cstdio>
+#endif
+
+// Marks a function that returns the address of a thread-local variable.  In
+// the continuation-stealing mode of the Linux prototype, code can move to
+// another thread in the middle of a function, so such addresses must be
+// recomputed on every use rather than inlined and reused.
+#ifndef TASK_BLOCK_TLS_ACCESSOR
+#if defined(__clang__)
+#define TASK_BLOCK_TLS_ACCESSOR [[gnu::noinline]]
+#elif defined(__GNUC__)
+#define TASK_BLOCK_TLS_ACCESSOR [[gnu::noinline, gnu::noipa]]
+#else
+#define TASK_BLOCK_TLS_ACCESSOR
+#endif
+#endif
+
+class task_arena
+{
+public:
+    static constexpr std::size_t initial_chunk_size = 1024;
+    static constexpr std::size_t max_chunk_size = std::size_t(1) << 20;
+
+    // Largest total size of the chunks kept in each thread's cache.
+    static constexpr std::size_t max_cached_bytes = std::size_t(4) << 20;
+
+private:
+    struct alignas(std::max_align_t) chunk
+    {
+        chunk*      next;
+        std::size_t size;   // Usable bytes, which follow the header
+
+        char* begin() { return reinterpret_cast<char*>(this + 1); }
+        char* end()   { return begin() + size; }
+    };
+
+    struct chunk_cache
+    {
+        chunk*      head  = nullptr;
+        std::size_t bytes = 0;
+
+        ~chunk_cache()
+        {
+            while (head) {
+                chunk* c = head;
+                head = c->next;
+                free_chunk(c);
+            }
+        }
+
+        // Remove and return a cached chunk of at least `size` bytes, or null.
+        chunk* take(std::size_t size)
+        {
+            for (chunk** pc = &head; *pc; pc = &(*pc)->next) {
+                chunk* c = *pc;
+                if (c->size >= size) {
+                    *pc = c->next;
+                    bytes -= c->size;
+                    return c;
+                }
+            }
+            return nullptr;
+        }
+
+        void give(chunk* c)
+        {
+            if (bytes + c->size > max_cached_bytes) {
+                free_chunk(c);
+                return;
+            }
+            c->next = head;
+            head = c;
+            bytes += c->size;
+        }
+    };
+
+    TASK_BLOCK_TLS_ACCESSOR static chunk_cache& thread_cache()
+    {
+        static thread_local chunk_cache cache;
+        return cache;
+    }
+
+    chunk*      m_chunks = nullptr;     // Most recent first
+    char*       m_cur = nullptr;
+    char*       m_end = nullptr;
+    std::size_t m_next_size = initial_chunk_size;
+
+    static chunk* new_chunk(std::size_t size)
+    {
+        auto c = static_cast<chunk*>(::operator new(sizeof(chunk) + size));
+        c->size = size;
+#ifdef TRACE_ALLOCATIONS
+        std::printf(":alloc %zu byte chunk at %p\n", size, (void*) c);
+#endif
+        return c;
+    }
+
+    static void free_chunk(chunk* c)
+    {
+#ifdef TRACE_ALLOCATIONS
+        std::printf(":freed %zu byte chunk at %p\n", c->size, (void*) c);
+#endif
+        ::operator delete(c);
+    }
+
+    // Start a new chunk that can hold `size` bytes aligned to `align`.
+    void add_chunk(std::size_t size, std::size_t align)
+    {
+        std::size_t need = size + (align > alignof(chunk) ? align : 0);
+        std::size_t want = need > m_next_size ? need : m_next_size;
+
+        chunk* c = thread_cache().take(want);
+        if (!c)
+            c = new_chunk(want);
+        c->next = m_chunks;
+        m_chunks = c;
+        m_cur = c->begin();
+        m_end = c->end();
+
+        // Grow from the size of the chunk actually obtained, which may be
+        // larger than requested if it came from the cache.
+        if (m_next_size < max_chunk_size)
+            m_next_size = c->size < max_chunk_size / 2 ?
+                2 * c->size : max_chunk_size;
+    }
+
+    static char* align_up(char* p, std::size_t align)
+    {
+        auto n = reinterpret_cast<std::uintptr_t>(p);
+        return p + ((align - n % align) % align);
+    }
+
+public:
+    task_arena() = default;
+    task_arena(const task_arena&) = delete;
+    task_arena& operator=(const task_arena&) = delete;
+
+    ~task_arena() { release(); }
+
+    // Return `size` bytes aligned to `align`, a power of two.
+    void* allocate(std::size_t size, std::size_t align)
+    {
+        char* p = align_up(m_cur, align);
+        if (!m_cur || p > m_end || std::size_t(m_end - p) < size) {
+            add_chunk(size, align);
+            p = align_up(m_cur, align);
+        }
+        m_cur = p + size;
+        return p;
+    }
+
+    // Construct a `T` in the arena.  The arena never calls its destructor.
+    template <typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        void* p = allocate(sizeof(T), alignof(T));
+        return ::new (p) T(std::forward<Args>(args)...);
+    }
+
+    // Make all memory allocated so far available to later regions on the
+    // calling thread.  Nothing allocated from this arena may be used after
+    // this call.
+    void release()
+    {
+        while (m_chunks) {
+            chunk* c = m_chunks;
+            m_chunks = c->next;
+            thread_cache().give(c);
+        }
+        m_cur = m_end = nullptr;
+        m_next_size = initial_chunk_size;
+    }
+};
+
+// Local Variables:
+// c-basic-offset: 4
+// End:
@@ -27,3 +27,13 @@ public:
 private:
     std::vector<std::exception_ptr> exceptions_;
 };
+
+// Thrown by `task_region_handle::run` in a region that has been canceled
+// because a task failed.  `task_region` discards it.
+class task_canceled_exception : public std::exception
+{
+public:
+    const char* what() const noexcept override {
+        return "task region canceled";
+    }
+};
@@ -11,70 +11,98 @@
 #define TRACE_ALLOCATIONS
 #endif
 
+#include "../task_arena.h"
+
+// Options for a task region, e.g., `task_region({.cancel_on_failure = true},
+// f)`.  With `cancel_on_failure`, tasks that have not started when a task or
+// the body fails are skipped, and `run` throws `task_canceled_exception`.
+struct task_region_options
+{
+    bool cancel_on_failure = false;
+};
+
+// An exception recorded in a task group.  Each task handle carries one, so
+// that recording an exception does not allocate.
+struct exception_list_node
+{
+    std::exception_ptr   data;
+    exception_list_node* next = nullptr;
+};
+
 struct task_handler_node_base
 {
-#ifdef TRACE_ALLOCATIONS
-    size_t                      size;
-#endif
     task_handler_node_base*     next;
+    void                      (*destroy)(task_handler_node_base*);
+    exception_list_node         exception;
 };
 
-template<typename T>
-struct task_handler_node : public task_handler_node_base
+class structured_task_groupEx;
+
+// Runs a task's function, recording its exception, if any, in the group.
+template<typename F>
+struct task_wrapper
 {
-    concurrency::task_handle<T>  data;
+    F                           f;
+    structured_task_groupEx*    group;
+    exception_list_node*        exception;
+
+    void operator()() const;
 };
 
-class structured_task_groupEx : public concurrency::structured_task_group
+template<typename F>
+struct task_handler_node : public task_handler_node_base
 {
-    // Arena allocator that attempts to allocate task handles inside the extended task group
-    static const size_t arena_size = 1024;
-    template <std::size_t N>
-    struct allocator
-    {
-        char data[N];
-        void* p;
-        std::size_t sz;
-        allocator() : p(data), sz(N) {}
-        template <typename Ty>
-        Ty* aligned_alloc()
-        {
-            std::size_t a = __alignof(Ty);
-            if (std::align(a, sizeof(Ty), p, sz))
-            {
-                Ty* result = reinterpret_cast<Ty*>(p);
-                p = (char*)p + sizeof(Ty);
-                sz -= sizeof(Ty);
-                return result;
-            }
-            return nullptr;
-        }
-    };
+    concurrency::task_handle<task_wrapper<F>>  data;
 
-    allocator<arena_size>           m_allocator;
+    task_handler_node(const F& f, structured_task_groupEx* group)
+        : task_handler_node_base{nullptr, &destroy_node}
+        , data(task_wrapper<F>{f, group, &this->exception}) {}
 
-    struct exception_list_node
+    static void destroy_node(task_handler_node_base* p)
     {
-        std::exception_ptr data;
-        exception_list_node* next;
-        exception_list_node(const std::exception_ptr& node) : data(node), next(nullptr) {}
-    };
+        static_cast<task_handler_node*>(p)->~task_handler_node();
+    }
+};
+
+class structured_task_groupEx : public concurrency::structured_task_group
+{
+    // Task handles are allocated from a per-group arena that grows as
+    // needed; its memory is recycled by the next group on this thread.
+    task_arena                      m_arena;
 
     std::atomic<exception_list_node*>    m_exception_list_head = nullptr;
     task_handler_node_base*              m_task_list_head = nullptr;
+    exception_list_node                  m_body_exception;
+
+    // Set on the first failure if `cancel_on_failure` was requested.  This
+    // does not use `structured_task_group::cancel`, which would interrupt
+    // the body with ConcRT's own exception.
+    std::atomic<bool>                    m_canceled = false;
+    const bool                           m_cancel_on_failure;
 
 public:
+    explicit structured_task_groupEx(const task_region_options& options = {})
+        : m_cancel_on_failure(options.cancel_on_failure) {}
 
-    void add_exception(const std::exception_ptr& ex)
+    // Record `ex` in `node`, which must not already be in the list.
+    void add_exception(exception_list_node* node, const std::exception_ptr& ex)
     {
-        auto new_node = new exception_list_node(ex);
-        new_node->next = m_exception_list_head.load(std::memory_order_relaxed);
+        node->data = ex;
+        node->next = m_exception_list_head.load(std::memory_order_relaxed);
 
-        while (!m_exception_list_head.compare_exchange_weak(new_node->next,
-            new_node,
+        while (!m_exception_list_head.compare_exchange_weak(node->next,
+            node,
             std::memory_order_release,
             std::memory_order_relaxed))
             ;
+
+        if (m_cancel_on_failure)
+            m_canceled.store(true, std::memory_order_relaxed);
+    }
+
+    void add_body_exception(const std::exception_ptr& ex)
+    {
+        add_exception(&m_body_exception, ex);
     }
 
     bool have_exceptions()
@@ -82,6 +110,11 @@ public:
         return m_exception_list_head.load(std::memory_order_relaxed) != nullptr;
     }
 
+    bool canceled() const
+    {
+        return m_canceled.load(std::memory_order_relaxed);
+    }
+
     void throw_exception_list()
     {
         std::vector<std::exception_ptr> vec;
@@ -94,45 +127,43 @@ public:
         throw el;
     }
 
+    // Construct a task handle for `f` in the arena.  Handles, and the
+    // exceptions recorded in them, are destroyed with the group, after all
+    // of them have run.
     template<typename Ty>
-    task_handler_node<Ty>* alloc()
+    task_handler_node<Ty>* alloc(const Ty& f)
     {
-        task_handler_node_base *p_node;
-        p_node = m_allocator.aligned_alloc<task_handler_node<Ty>>();
-
-        if (p_node == nullptr)
-        {
-            // fall back to ConcRT suballocator and record the pointer for future deallocation
-            auto size = sizeof(task_handler_node<Ty>);
-            p_node = (task_handler_node_base*)concurrency::Alloc(size);
-#ifdef TRACE_ALLOCATIONS
-            p_node->size = size;
-            printf(":alloc %d bytes into 0x%p\n", size, p_node);
-#endif
-            p_node->next = m_task_list_head;
-            m_task_list_head = p_node;
-        }
-
-        return static_cast<task_handler_node<Ty>*>(p_node);
+        auto p_node = m_arena.create<task_handler_node<Ty>>(f, this);
+        p_node->next = m_task_list_head;
+        m_task_list_head = p_node;
+        return p_node;
     }
 
     ~structured_task_groupEx()
     {
         while (m_task_list_head != nullptr)
         {
-            auto pdelete = m_task_list_head;
-#ifdef TRACE_ALLOCATIONS
-            auto size = m_task_list_head->size;
-#endif
+            auto pdestroy = m_task_list_head;
             m_task_list_head = m_task_list_head->next;
-            concurrency::Free(pdelete);
-#ifdef TRACE_ALLOCATIONS
-            printf(":freed %d bytes at 0x%p\n", size, pdelete);
-#endif
+            pdestroy->destroy(pdestroy);
         }
     }
 };
 
+template<typename F>
+void task_wrapper<F>::operator()() const
+{
+    try
+    {
+        if (!group->canceled())
+            f();
+    }
+    catch (...)
+    {
+        group->add_exception(exception, current_exception());
+    }
+}
+
 extern __declspec(thread) structured_task_groupEx* tls_current_task_group;
 
 class task_region_handle
@@ -141,7 +172,7 @@ private:
     structured_task_groupEx * pstg_;
 
     template<typename F>
-    friend void task_region(F&& f);
+    friend void task_region(const task_region_options& options, F&& f);
 
     template<typename F>
     friend void task_region_final(F&& f);
@@ -164,24 +195,10 @@ public:
 
         auto current_task_group = tls_current_task_group;
 
-        auto f_wrapped = [f, current_task_group] {
-            try
-            {
-                f();
-            }
-            catch (...)
-            {
-                assert(current_task_group != nullptr);
-                current_task_group->add_exception(current_exception());
-            }
-        };
+        if (current_task_group->canceled())
+            throw task_canceled_exception();
 
-        typedef decltype(f_wrapped) F_wrapped;
-
-        auto ptask_handler_node = current_task_group->alloc<F_wrapped>();
-
-        // create a task handle in-place
-        new(&ptask_handler_node->data)task_handle<F_wrapped>(make_task(f_wrapped));
+        auto ptask_handler_node = current_task_group->alloc(f);
 
         // Now run the task on the task group
         current_task_group->run(ptask_handler_node->data);
@@ -194,7 +211,7 @@ public:
 };
 
 template<typename F>
-void task_region(F && f)
+void task_region(const task_region_options& options, F && f)
 {
     struct restore_tls {
         structured_task_groupEx* m_old_state = tls_current_task_group;
@@ -204,7 +221,7 @@ void task_region(F && f)
         }
     }_;
 
-    structured_task_groupEx stg;
+    structured_task_groupEx stg(options);
     tls_current_task_group = &stg;
     task_region_handle trh(&stg);
 
@@ -212,9 +229,15 @@ void task_region(F && f)
     {
         f(trh);
     }
+    catch (const task_canceled_exception&)
+    {
+        // Thrown by `run` after the failure that canceled the region
+        if (!stg.canceled())
+            stg.add_body_exception(current_exception());
+    }
     catch (...)
     {
-        stg.add_exception(current_exception());
+        stg.add_body_exception(current_exception());
     }
 
     // This cannot throw, because task exceptions have been wrapped and handled
@@ -225,3 +248,9 @@ void task_region(F && f)
         stg.throw_exception_list();
     }
 }
+
+template<typename F>
+void task_region(F && f)
+{
+    task_region(task_region_options{}, std::forward<F>(f));
+}
@@ -0,0 +1,98 @@
+#! /usr/bin/python3
+
+# Verify that lookups through `get` and the `optional` API cost nothing.
+#
+# Usage: codegen_check.py object-file
+#
+# Disassembles `object-file` (normally compiled from `value_or_codegen.cpp`)
+# and, for every function named `get_<name>`, checks that the function
+# `find_<name>` has the same instruction sequence.  Addresses, jump targets
+# within each function, and the operand order of `cmp` instructions that
+# feed a conditional jump are normalized before comparison.
+# Prints each pair's status and exits with a non-zero status on mismatch.
+#
+# Dependencies: objdump (GNU binutils)
+
+import re
+import subprocess
+import sys
+
+def disassemble(objfile):
+    """Return a dict mapping each function name to its instruction list."""
+    out = subprocess.run(['objdump', '-d', '--no-show-raw-insn', objfile],
+                         check=True, capture_output=True, text=True).stdout
+    funcs = {}
+    insns = None
+    for line in out.splitlines():
+        m = re.match(r'^[0-9a-f]+ <(.+)>:$', line)
+        if m:
+            insns = funcs.setdefault(m.group(1), [])
+            continue
+        m = re.match(r'^\s*[0-9a-f]+:\s+(.*)$', line)
+        if m and insns is not None:
+            insns.append(m.group(1))
+    return funcs
+
+def normalize(name, insns):
+    """Strip addresses and make local jump targets function-relative."""
+    ret = []
+    for insn in insns:
+        insn = re.sub(r'#.*$', '', insn).strip()
+        insn = re.sub(r'\s+', ' ', insn)
+        insn = re.sub(r'[0-9a-f]+ <' + re.escape(name) + r'(\+0x[0-9a-f]+)?>',
+                      lambda m: '<' + (m.group(1) or '+0x0') + '>', insn)
+        if insn.startswith('nop') or insn.startswith('xchg %ax,%ax') or \
+           insn.startswith('data16') or insn.startswith('cs nop'):
+            continue    # Alignment padding
+        ret.append(insn)
+
+    # `cmp a,b` followed by a conditional jump is equivalent to `cmp b,a`
+    # followed by the mirrored jump; put the operands in a canonical order.
+    for i, insn in enumerate(ret[:-1]):
+        m = re.match(r'^cmp (.+)$', insn)
+        j = re.match(r'^j(\w+) (.*)$', ret[i + 1])
+        if not (m and j and j.group(1) in MIRROR):
+            continue
+        # Split at the comma outside of a memory operand's parentheses.
+        a, b = re.match(r'^((?:[^,(]|\([^)]*\))+),(.+)$', m.group(1)).groups()
+        if a > b:
+            ret[i] = 'cmp %s,%s' % (b, a)
+            ret[i + 1] = 'j%s %s' % (MIRROR[j.group(1)], j.group(2))
+    return ret
+
+# Condition codes of a jump after `cmp a,b`, and the equivalent condition
+# after `cmp b,a`.
+MIRROR = { 'e': 'e', 'ne': 'ne', 'l': 'g', 'g': 'l', 'le': 'ge', 'ge': 'le',
+           'b': 'a', 'a': 'b', 'be': 'ae', 'ae': 'be' }
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('Usage: codegen_check.py object-file')
+    funcs = disassemble(sys.argv[1])
+    failures = 0
+    pairs = sorted(name[4:] for name in funcs if name.startswith('get_'))
+    if not pairs:
+        sys.exit('No get_* functions found in ' + sys.argv[1])
+    for name in pairs:
+        get, find = 'get_' + name, 'find_' + name
+        if find not in funcs:
+            print('MISSING', find)
+            failures += 1
+            continue
+        g = normalize(get, funcs[get])
+        f = normalize(find, funcs[find])
+        if g == f:
+            print('SAME    %s (%d instructions)' % (name, len(g)))
+        else:
+            print('DIFFER  %s' % name)
+            width = max(len(insn) for insn in g)
+            for i in range(max(len(g), len(f))):
+                gi = g[i] if i < len(g) else ''
+                fi = f[i] if i < len(f) else ''
+                print('  %s %-*s | %s' % (' ' if gi == fi else '*',
+                                          width, gi, fi))
+            failures += 1
+    sys.exit(1 if failures else 0)
+
+if __name__ == '__main__':
+    main()
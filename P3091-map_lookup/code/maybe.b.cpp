@@ -0,0 +1,111 @@
+/* maybe.b.cpp                                                        -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Benchmark: `value_or` applied to each kind of `maybe` (a raw pointer, a
+ * `std::expected`, a `find` result wrapped by `find_in`, and the
+ * `optional<T&>` returned by `get`) vs. the same operation written with
+ * explicit branches.  Half of the probes succeed.  The `value_or` and
+ * hand-written columns should match to within measurement noise;
+ * `value_or_codegen.cpp` checks the stronger property that the generated
+ * code is identical.
+ *
+ * Usage: maybe.b [entries [lookups]]    (default: 100000 10000000)
+ */
+
+#include <xmap.h>
+#include <chrono>
+#include <cstdlib>
+#include <expected>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace xstd = std::experimental;
+namespace chrono = std::chrono;
+
+using std::experimental::value_or;
+
+// Time `f(p)` for every `p` in `probes`, returning ns per call.
+template <class P, class F>
+double measure(const std::vector<P>& probes, F f)
+{
+  long long checksum = 0;
+  auto start = chrono::steady_clock::now();
+  for (const P& p : probes)
+    checksum += f(p);
+  auto elapsed = chrono::steady_clock::now() - start;
+
+  // Use the checksum, so the calls cannot be discarded.
+  if (checksum == -1)
+    std::cout << checksum;
+  return double(chrono::duration_cast<chrono::nanoseconds>(elapsed).count()) /
+    probes.size();
+}
+
+void printRow(const char* what, double viaValueOr, double byHand)
+{
+  std::cout << "| " << what << " | " << viaValueOr << " | " << byHand
+            << " | " << viaValueOr / byHand << " |" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  std::size_t entries = argc > 1 ? std::atol(argv[1]) : 100000;
+  std::size_t lookups = argc > 2 ? std::atol(argv[2]) : 10000000;
+
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int> dist(0, int(2 * entries - 1));
+
+  // Even keys are present; odd keys are absent.
+  xstd::map<int, int> m;
+  std::vector<int> values(2 * entries);
+  for (std::size_t i = 0; i < entries; ++i) {
+    m.emplace(int(2 * i), int(i));
+    values[2 * i] = int(i);
+  }
+
+  std::vector<int> keys(lookups);
+  std::vector<const int*> ptrs(lookups);
+  std::vector<std::expected<int, int>> exps(lookups);
+  for (std::size_t i = 0; i < lookups; ++i) {
+    int k = dist(gen);
+    keys[i] = k;
+    ptrs[i] = k % 2 ? nullptr : &values[k];
+    exps[i] = k % 2 ? std::expected<int, int>(std::unexpect, k) :
+                      std::expected<int, int>(values[k]);
+  }
+
+  std::cout << "| `maybe` | `value_or` (ns) | by hand (ns) | ratio |\n"
+            << "| :------ | --------------: | -----------: | ----: |"
+            << std::endl;
+
+  printRow("pointer",
+           measure(ptrs, [](const int* p) { return value_or(p, -1); }),
+           measure(ptrs, [](const int* p) { return p ? *p : -1; }));
+
+  printRow("`expected`",
+           measure(exps, [](auto& e) { return value_or(e, -1); }),
+           measure(exps, [](auto& e) { return e.has_value() ? *e : -1; }));
+
+  printRow("`find_in(map)`",
+           measure(keys, [&](int k) {
+             return value_or(xstd::find_in(m, k), -1);
+           }),
+           measure(keys, [&](int k) {
+             auto i = m.find(k);
+             return i == m.end() ? -1 : i->second;
+           }));
+
+  printRow("`map::get`",
+           measure(keys, [&](int k) { return value_or(m.get(k), -1); }),
+           measure(keys, [&](int k) {
+             auto i = m.find(k);
+             return i == m.end() ? -1 : i->second;
+           }));
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -175,6 +175,58 @@ constexpr auto or_invoke(T&& m, I&& invocable) -> decltype(auto)
   return bool(m) ? static_cast<Ret>(*std::forward<T>(m)) : static_cast<Ret>(invocable());
 }
 
+// Adapters
+//
+// Raw pointers, smart pointers, `optional`, and `expected` model `maybe`
+// as-is, so `value_or(p, v)`, `value_or(e, v)`, etc., need no adapter.  The
+// result of a `find` is an iterator that must be compared against a second
+// iterator (or sentinel), so it is wrapped in a `found_element` or
+// `found_mapped` object.  Both are a pair of iterators that dereference to a
+// reference into the container, so no value is copied until the
+// `value_or` return value is initialized.
+
+// A `maybe` referring to `*it`, if `it != end`.
+template <class I, class S = I>
+class found_element
+{
+  I m_it;
+  S m_end;
+
+public:
+  constexpr found_element(I it, S end) : m_it(it), m_end(end) { }
+
+  constexpr explicit operator bool() const { return m_it != m_end; }
+  constexpr decltype(auto) operator*() const { return *m_it; }
+
+  constexpr I iterator() const { return m_it; }
+};
+
+// A `maybe` referring to `it->second`, if `it != end`; e.g., the mapped value
+// found in an associative container.
+template <class I, class S = I>
+class found_mapped
+{
+  I m_it;
+  S m_end;
+
+public:
+  constexpr found_mapped(I it, S end) : m_it(it), m_end(end) { }
+
+  constexpr explicit operator bool() const { return m_it != m_end; }
+  constexpr auto& operator*() const { return m_it->second; }
+
+  constexpr I iterator() const { return m_it; }
+};
+
+// Look up `k` in the associative container `c` using `c.find(k)` and return
+// a `found_mapped` for the result, e.g., `value_or(find_in(m, k), 0)`.
+template <class C, class K>
+constexpr auto find_in(C& c, const K& k)
+  -> found_mapped<decltype(c.find(k)), decltype(c.end())>
+{
+  return { c.find(k), c.end() };
+}
+
 }  // close namespace std::experimental
 
 #endif // ! defined(INCLUDED_MAYBE)
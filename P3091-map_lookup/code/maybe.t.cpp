@@ -5,6 +5,12 @@
  */
 
 #include <xoptional.h>
+#include <algorithm>
+#include <expected>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <cassert>
 
@@ -325,6 +331,162 @@ void test_or_invoke()
   }
 }
 
+// Monadic operations, in constant evaluation
+constexpr xstd::optional<int> half(int i)
+{
+  if (i % 2) return std::nullopt;
+  return i / 2;
+}
+
+constexpr bool test_monadic_value()
+{
+  using Opt = xstd::optional<int>;
+
+  // `and_then` accepts either kind of `optional` and returns it.
+  Opt even(8), odd(7), none;
+  if (even.and_then(half).value_or(-1) != 4) return false;
+  if (odd.and_then(half).has_value() || none.and_then(half).has_value())
+    return false;
+  static_assert(std::is_same_v<Opt, decltype(even.and_then(half))>);
+  auto stdHalf = [](int i) { return std::optional<long>(i / 2); };
+  static_assert(std::is_same_v<std::optional<long>,
+                               decltype(even.and_then(stdHalf))>);
+
+  // `transform` returns `experimental::optional`, which can hold a reference.
+  auto twice = [](int i) { return 2 * i; };
+  static_assert(std::is_same_v<xstd::optional<int>,
+                               decltype(even.transform(twice))>);
+  if (even.transform(twice).value_or(0) != 16 || none.transform(twice))
+    return false;
+  auto self = [](int& i) -> int& { return i; };
+  static_assert(std::is_same_v<xstd::optional<int&>,
+                               decltype(even.transform(self))>);
+  even.transform(self).value() = 10;
+  if (*even != 10) return false;
+
+  // `or_else`
+  if (none.or_else([] { return Opt(3); }).value_or(0) != 3) return false;
+  if (even.or_else([] { return Opt(3); }).value_or(0) != 10) return false;
+  static_assert(std::is_same_v<Opt, decltype(none.or_else([] { return Opt(); }))>);
+
+  // Functors are invoked with the value category they were passed with.
+  struct ByCategory {
+    constexpr Opt operator()(int) & { return Opt(1); }
+    constexpr Opt operator()(int) && { return Opt(2); }
+  } byCategory;
+  if (even.and_then(byCategory).value() != 1 ||
+      even.transform(byCategory).value().value() != 1 ||
+      Opt(even).and_then(byCategory).value() != 1 ||
+      even.and_then(ByCategory()).value() != 2 ||
+      even.transform(ByCategory()).value().value() != 2)
+    return false;
+
+  return Opt(odd).and_then(half).transform(twice).or_else([] {
+    return Opt(-1); }).value() == -1;
+}
+static_assert(test_monadic_value());
+
+constexpr bool test_monadic_ref()
+{
+  int a = 6, b = 0;
+  xstd::optional<int&> ra(a), rnone;
+
+  // Operations test whether the `optional` is engaged, not the referent.
+  xstd::optional<int&> rb(b);
+  if (rb.and_then(half).value_or(-1) != 0) return false;
+  if (rnone.and_then(half) || ! ra.and_then(half)) return false;
+  if (rb.transform([](int i) { return i + 1; }).value_or(0) != 1)
+    return false;
+  if (rnone.transform([](int i) { return i + 1; })) return false;
+
+  // `transform` to a reference yields an `optional` reference
+  struct S { int m; } s{ 4 };
+  xstd::optional<S&> rs(s);
+  auto rm = rs.transform([](S& x) -> int& { return x.m; });
+  static_assert(std::is_same_v<xstd::optional<int&>, decltype(rm)>);
+  if (&*rm != &s.m) return false;
+
+  // `or_else` yields `*this` if engaged, else the result of the functor
+  if (&rnone.or_else([&] { return xstd::optional<int&>(b); }).value() != &b)
+    return false;
+  if (&ra.or_else([&] { return xstd::optional<int&>(b); }).value() != &a)
+    return false;
+
+  // Assignment from `nullopt` and `emplace` return usable results
+  (rb = std::nullopt) = ra;
+  if (&*rb != &a) return false;
+  int& e = rb.emplace(b);
+  return &e == &b && &*rb == &b;
+}
+static_assert(test_monadic_ref());
+
+// `maybe.h` functions applied to pointers, `expected`, and `find` results
+void test_adapters()
+{
+  using xstd::value_or;
+  using xstd::reference_or;
+  using xstd::or_invoke;
+
+  int        dflt = -1;
+  int        i    = 5;
+  const int  ci   = 6;
+  int*       p    = &i;
+  int*       np   = nullptr;
+  const int* cp   = &ci;
+
+  // Raw and smart pointers
+  static_assert(xstd::maybe<int*> && xstd::maybe<std::unique_ptr<int>>);
+  expect<int>(5, value_or(p, 0));
+  expect<int>(0, value_or(np, 0));
+  expect<int>(6, value_or(cp, 0));
+  expect<int*>(&i, &reference_or(p, dflt));
+  expect<int*>(&dflt, &reference_or(np, dflt));
+  expect<const int*>(&ci, &reference_or(cp, dflt));
+  expect<int>(7, or_invoke(np, [] { return 7; }));
+  expect<int>(8, value_or(std::make_unique<int>(8), 0));
+  expect<int>(0, value_or(std::unique_ptr<int>(), 0));
+
+  // `std::expected`
+  using Exp = std::expected<int, std::string>;
+  static_assert(xstd::maybe<Exp>);
+  Exp good(3), bad(std::unexpect, "error");
+  expect<int>(3, value_or(good, 0));
+  expect<int>(0, value_or(bad, 0));
+  expect<int>(3, value_or(Exp(3), 0));
+  expect<int*>(&*good, &reference_or(good, dflt));
+  expect<int*>(&dflt, &reference_or(bad, dflt));
+  expect<int>(9, or_invoke(bad, [] { return 9; }));
+
+  // Iterator pairs
+  std::vector<int> vec{ 1, 2, 3 };
+  auto two   = xstd::found_element(std::find(vec.begin(), vec.end(), 2),
+                                   vec.end());
+  auto four  = xstd::found_element(std::find(vec.begin(), vec.end(), 4),
+                                   vec.end());
+  static_assert(xstd::maybe<decltype(two)>);
+  expect<int>(2, value_or(two, 0));
+  expect<int>(0, value_or(four, 0));
+  expect<int*>(&vec[1], &reference_or(two, dflt));
+  assert(vec.begin() + 1 == two.iterator());
+
+  std::map<std::string, int> m{ { "one", 1 }, { "two", 2 } };
+  const auto& M = m;
+  expect<int>(1, value_or(xstd::find_in(m, "one"), 0));
+  expect<int>(0, value_or(xstd::find_in(M, "three"), 0));
+  expect<int*>(&m.at("two"), &reference_or(xstd::find_in(m, "two"), dflt));
+  expect<const int*>(&m.at("two"), &reference_or(xstd::find_in(M, "two"),
+                                                 dflt));
+  ++reference_or(xstd::find_in(m, "one"), dflt);
+  assert(2 == m.at("one"));
+  expect<int>(3, or_invoke(xstd::find_in(M, "three"), [] { return 3; }));
+
+  std::unordered_map<int, std::string> um{ { 1, "one" } };
+  expect<std::string>("one", value_or(xstd::find_in(um, 1), "none"));
+  expect<std::string>("none", value_or(xstd::find_in(um, 2), "none"));
+  auto found = xstd::found_mapped(um.find(1), um.end());
+  assert(found && &*found == &um.at(1) && um.begin() == found.iterator());
+}
+
 int main()
 {
   // Test `value_or` with one argument
@@ -363,6 +525,8 @@ int main()
   expect<int_vec>(int_vec{1, 2, 3}, value_or(ORV, {1, 2, 3}));
   int_vec v98{9, 8};
   expect<int_vec*>(&v98, &value_or<int_vec&>(ORV, v98));
+
+  test_adapters();
 }
 
 // Local Variables:
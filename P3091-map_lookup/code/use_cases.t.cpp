@@ -54,6 +54,17 @@ void nonZero()
 
   assert(data.size() == 5);  // No new items added
   assert(2 == smallest);     // Correctly computed smallest value
+
+  // Same computation, with the lookups batched so that they overlap
+  int keys[7];
+  for (int i = 0; i < 7; ++i)
+    keys[i] = 2 * i + 1;
+  xstd::optional<unsigned&> values[7];
+  data.get_many(std::span<const int>(keys), std::span(values));
+  smallest = 100;
+  for (auto v : values)
+    smallest = std::min(smallest, value_or(v, 100));
+  assert(2 == smallest);
 }
 
 void constMap()
@@ -210,6 +221,21 @@ void fromPaper()
     assert(3 == theMap.size());  // No growth
   }
 
+  {
+    xstd::map<int, double> theMap = { { 3, -20.0 }, { 90, -90.0 }, { 110, 4.0 } };
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    int keys[100];
+    for (int i = 1; i <= 100; ++i)
+      keys[i - 1] = i;
+    xstd::optional<double&> values[100];
+    theMap.get_many(std::span<const int>(keys), std::span(values));  // Batched
+    double largest = -inf;
+    for (auto v : values)
+      largest = std::max(largest, value_or(v, -inf));
+    assert(-20.0 == largest);    // Expected result.
+    assert(3 == theMap.size());  // No growth
+  }
+
   {
     xstd::map<int, double> theMap = { { 3, -20.0 }, { 90, -90.0 }, { 110, 4.0 } };
     xstd::optional<double&> largest;
@@ -261,6 +287,32 @@ void fromPaper()
     assert(0 == theMap.count("goodbye"));
   }
 
+  {
+    xstd::map<std::string, int> theMap = { { "hello", 2 } };
+    std::vector<std::string> names = { "goodbye", "hello" };
+    // ...
+    // The same, looking up all of `names` in one batch.
+    std::vector<xstd::optional<int&>> found(names.size());
+    theMap.get_many(std::span<const std::string>(names), std::span(found));
+    for (auto entry : found)
+      if (entry)
+        ++*entry;
+    assert(3 == theMap.at("hello"));
+    assert(0 == theMap.count("goodbye"));
+  }
+
+  {
+    xstd::map<std::string, int, std::less<>> theMap = { { "hello", 2 } };
+    std::vector<std::string_view> words = { "goodbye", "hello", "goodbye" };
+    // ...
+    // Count `words`, adding entries as needed.  Each word is looked up once
+    // and converted to `std::string` only when it is first inserted.
+    for (std::string_view word : words)
+      ++theMap.get_or_emplace(word);
+    assert(3 == theMap.at("hello"));
+    assert(2 == theMap.at("goodbye"));
+  }
+
 #if 0 // Test compilation error
   {
     const xstd::map<int, std::string> theMap{};
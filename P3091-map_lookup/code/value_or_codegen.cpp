@@ -0,0 +1,107 @@
+/* value_or_codegen.cpp                                               -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Codegen check: each `get_*` function below is a lookup written using
+ * `get` and the `optional` API, or using `value_or` on another `maybe`
+ * type; the matching `find_*` function is the same lookup written by hand
+ * using `find`, `end`, and explicit branches.  `codegen_check.py` compiles
+ * this file with optimization and verifies that each pair disassembles to
+ * identical instructions, i.e., that `optional<T&>`, the `maybe.h` adapters,
+ * and their operations add no overhead.
+ */
+
+#include <xmap.h>
+#include <expected>
+
+namespace xstd = std::experimental;
+
+using Map  = xstd::map<int, int>;
+using UMap = xstd::unordered_map<int, int>;
+
+using std::experimental::value_or;
+
+extern "C" {
+
+int get_map_value_or(const Map& m, int k, int d)
+{
+  return value_or(m.get(k), d);
+}
+
+int find_map_value_or(const Map& m, int k, int d)
+{
+  auto i = m.find(k);
+  return i == m.end() ? d : i->second;
+}
+
+int get_map_transform(const Map& m, int k)
+{
+  return m.get(k).transform([](int v) { return v + 1; }).value_or(0);
+}
+
+int find_map_transform(const Map& m, int k)
+{
+  auto i = m.find(k);
+  return i == m.end() ? 0 : i->second + 1;
+}
+
+int* get_map_pointer(Map& m, int k)
+{
+  auto v = m.get(k);
+  return v ? &*v : nullptr;
+}
+
+int* find_map_pointer(Map& m, int k)
+{
+  auto i = m.find(k);
+  return i == m.end() ? nullptr : &i->second;
+}
+
+int get_umap_value_or(const UMap& m, int k, int d)
+{
+  return value_or(m.get(k), d);
+}
+
+int find_umap_value_or(const UMap& m, int k, int d)
+{
+  auto i = m.find(k);
+  return i == m.end() ? d : i->second;
+}
+
+int get_pointer_value_or(const int* p, int d)
+{
+  return value_or(p, d);
+}
+
+int find_pointer_value_or(const int* p, int d)
+{
+  return p ? *p : d;
+}
+
+int get_expected_value_or(const std::expected<int, int>& e, int d)
+{
+  return value_or(e, d);
+}
+
+int find_expected_value_or(const std::expected<int, int>& e, int d)
+{
+  return e.has_value() ? *e : d;
+}
+
+int get_find_in_value_or(const Map& m, int k, int d)
+{
+  return value_or(xstd::find_in(m, k), d);
+}
+
+int find_find_in_value_or(const Map& m, int k, int d)
+{
+  auto i = m.find(k);
+  return i == m.end() ? d : i->second;
+}
+
+} // extern "C"
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,103 @@
+/* xflat_map.b.cpp                                                    -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Lookup benchmark: `experimental::flat_map` (Eytzinger layout) vs.
+ * `experimental::map` (red-black tree) vs. a sorted vector searched with
+ * `std::lower_bound`, for maps of 1K to 10M `int` keys.  Each lookup is
+ * `value_or(m.get(k), 0)` for a random key, half of which are present.
+ *
+ * Usage: xflat_map.b [max-size [lookups]]    (default: 10000000 1000000)
+ */
+
+#include <xflat_map.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace xstd = std::experimental;
+namespace chrono = std::chrono;
+
+using std::experimental::value_or;
+
+// Time `lookup(k)` for every `k` in `probes`, returning ns per lookup.
+template <class F>
+double measure(const std::vector<int>& probes, F lookup)
+{
+  long long checksum = 0;
+  auto start = chrono::steady_clock::now();
+  for (int k : probes)
+    checksum += lookup(k);
+  auto elapsed = chrono::steady_clock::now() - start;
+
+  // Use the checksum, so the lookups cannot be discarded.
+  if (checksum == -1)
+    std::cout << checksum;
+  return double(chrono::duration_cast<chrono::nanoseconds>(elapsed).count()) /
+    probes.size();
+}
+
+void benchSize(std::size_t n, std::size_t lookups)
+{
+  std::mt19937 gen(n);
+
+  // Even keys are present; odd keys are absent.
+  std::vector<int> keys(n), values(n);
+  for (std::size_t i = 0; i < n; ++i)
+    keys[i] = int(2 * i);
+  std::shuffle(keys.begin(), keys.end(), gen);
+  for (std::size_t i = 0; i < n; ++i)
+    values[i] = keys[i] / 2 + 1;
+
+  std::uniform_int_distribution<int> dist(0, int(2 * n - 1));
+  std::vector<int> probes(lookups);
+  for (int& k : probes)
+    k = dist(gen);
+
+  double tMap, tSorted, tFlat;
+  {
+    xstd::map<int, int> m;
+    for (std::size_t i = 0; i < n; ++i)
+      m.emplace(keys[i], values[i]);
+    tMap = measure(probes, [&](int k) { return value_or(m.get(k), 0); });
+  }
+  {
+    std::vector<std::pair<int, int>> v(n);
+    for (std::size_t i = 0; i < n; ++i)
+      v[i] = { keys[i], values[i] };
+    std::sort(v.begin(), v.end());
+    tSorted = measure(probes, [&](int k) {
+      auto i = std::lower_bound(v.begin(), v.end(), k,
+                                [](auto& e, int k) { return e.first < k; });
+      return i != v.end() && i->first == k ? i->second : 0;
+    });
+  }
+  {
+    xstd::flat_map<int, int> m(keys, values);
+    tFlat = measure(probes, [&](int k) { return value_or(m.get(k), 0); });
+  }
+
+  std::cout << "| " << n << " | " << tMap << " | " << tSorted << " | "
+            << tFlat << " | " << tMap / tFlat << " |" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  std::size_t maxSize = argc > 1 ? std::atol(argv[1]) : 10000000;
+  std::size_t lookups = argc > 2 ? std::atol(argv[2]) : 1000000;
+
+  std::cout << "| Entries | `map` (ns) | sorted `vector` (ns) | `flat_map` (ns) "
+               "| `map` / `flat_map` |\n"
+            << "| ------: | ---------: | -------------------: | --------------: "
+               "| -----------------: |" << std::endl;
+  for (std::size_t n = 1000; n <= maxSize; n *= 10)
+    benchSize(n, lookups);
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,390 @@
+/* xflat_map.h                                                        -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * A read-optimized sorted map with the P3091 `get` interface.
+ *
+ * `experimental::flat_map` stores its keys and mapped values in two parallel
+ * contiguous containers, so a lookup touches only keys until the final
+ * access to the value.  The keys are kept in Eytzinger (breadth-first) order:
+ * the children of the key at 1-based position `k` are at `2k` and `2k+1`.  A
+ * search is then a branch-free walk down the implicit tree whose next few
+ * levels can be prefetched in a single cache line, rather than a binary
+ * search whose probes are scattered across the array.  Iteration is still in
+ * key order (an in-order walk of the implicit tree).
+ *
+ * Lookups are O(log n); `insert` and `erase` re-lay out the entire map and
+ * are O(n), so this container is meant for maps that are built once (or
+ * rarely) and then read many times.
+ */
+
+#ifndef INCLUDED_XFLAT_MAP
+#define INCLUDED_XFLAT_MAP
+
+#include <xmap.h>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+
+namespace std::experimental {
+
+template <class Key, class T, class Compare = less<Key>,
+          class KeyContainer = vector<Key>, class MappedContainer = vector<T>>
+class flat_map
+{
+  static constexpr bool __is_transparent =
+    requires { typename Compare::is_transparent; };
+
+  KeyContainer                   m_keys;    // Eytzinger order
+  MappedContainer                m_values;  // `m_values[i]` is for `m_keys[i]`
+  [[no_unique_address]] Compare  m_comp;
+
+  // Positions below are 1-based indexes into the implicit tree; 0 means
+  // "none" (and is the position of `end()`).
+
+  // Position of the smallest key in a tree of `n` keys.
+  static constexpr size_t first_pos(size_t n) noexcept
+  {
+    if (n == 0)
+      return 0;
+    size_t k = 1;
+    while (2 * k <= n)
+      k *= 2;
+    return k;
+  }
+
+  // In-order successor of position `k` in a tree of `n` keys.
+  static constexpr size_t next_pos(size_t k, size_t n) noexcept
+  {
+    if (2 * k + 1 <= n) {
+      // Leftmost node of the right subtree
+      k = 2 * k + 1;
+      while (2 * k <= n)
+        k *= 2;
+      return k;
+    }
+    // Climb past every ancestor of which `k` is in the right subtree.
+    while (k & 1)
+      k >>= 1;
+    return k >> 1;
+  }
+
+  // In-order predecessor of position `k` (`0` for `end()`).
+  static constexpr size_t prev_pos(size_t k, size_t n) noexcept
+  {
+    if (k == 0) {
+      // Rightmost node of the whole tree
+      k = n ? 1 : 0;
+      while (k && 2 * k + 1 <= n)
+        k = 2 * k + 1;
+      return k;
+    }
+    if (2 * k <= n) {
+      // Rightmost node of the left subtree
+      k = 2 * k;
+      while (2 * k + 1 <= n)
+        k = 2 * k + 1;
+      return k;
+    }
+    while (k && ! (k & 1))
+      k >>= 1;
+    return k >> 1;
+  }
+
+  // Return `k` if it can be compared directly; otherwise convert it to `Key`
+  // once, rather than at every comparison.
+  template <class K>
+  static decltype(auto) lookup_key(const K& k)
+  {
+    if constexpr (__is_transparent || is_same_v<K, Key>)
+      return (k);
+    else
+      return Key(k);
+  }
+
+  // Position of the first key not less than `x`, or 0 if there is none.
+  // Each step descends one level without branching on the comparison.  The
+  // keys `log2(L)` levels below position `k` are contiguous, starting at
+  // position `k * L`, where `L` keys fit in a cache line, so prefetching
+  // that line hides the latency of the following levels.
+  template <class K>
+  size_t lower_bound_pos(const K& x) const
+  {
+    constexpr size_t cacheLine = 64;
+    constexpr size_t keysPerLine =
+      sizeof(Key) <= cacheLine && cacheLine % sizeof(Key) == 0 ?
+      cacheLine / sizeof(Key) : 0;
+
+    const size_t n    = m_keys.size();
+    const Key*   keys = std::data(m_keys);
+    size_t k = 1;
+    while (k <= n) {
+      // The prefetched address may be past the end, which is harmless.
+      if constexpr (keysPerLine != 0)
+        __builtin_prefetch(reinterpret_cast<const void*>(
+          reinterpret_cast<uintptr_t>(keys) +
+          (k * keysPerLine - 1) * sizeof(Key)));
+      k = 2 * k + size_t(m_comp(keys[k - 1], x));
+    }
+    // Undo the final right turns (and the left turn that preceded them).
+    return k >> (std::countr_one(k) + 1);
+  }
+
+  template <class K>
+  size_t find_pos(const K& x) const
+  {
+    size_t k = lower_bound_pos(x);
+    return k && ! m_comp(x, m_keys[k - 1]) ? k : 0;
+  }
+
+  // Replace the contents of this map with the `n` elements of `keys` and
+  // `values`, which are sorted and unique; `pos(i)` yields the index of the
+  // `i`th element.
+  template <class KC, class MC, class Pos>
+  void layout(KC&& keys, MC&& values, size_t n, Pos pos)
+  {
+    // `order[j]` is the rank of the key to be placed at index `j`.
+    vector<size_t> order(n);
+    for (size_t i = 0, k = first_pos(n); i < n; ++i, k = next_pos(k, n))
+      order[k - 1] = i;
+
+    KeyContainer    newKeys;
+    MappedContainer newValues;
+    newKeys.reserve(n);
+    newValues.reserve(n);
+    for (size_t j = 0; j < n; ++j) {
+      newKeys.push_back(std::move(keys[pos(order[j])]));
+      newValues.push_back(std::move(values[pos(order[j])]));
+    }
+    m_keys   = std::move(newKeys);
+    m_values = std::move(newValues);
+  }
+
+  // Lay out the parallel `keys` and `values`, in any order.  Of
+  // duplicate keys, only the first is kept.
+  void sort_and_layout(KeyContainer& keys, MappedContainer& values)
+  {
+    vector<size_t> byKey(keys.size());
+    std::iota(byKey.begin(), byKey.end(), size_t(0));
+    std::stable_sort(byKey.begin(), byKey.end(), [&](size_t a, size_t b) {
+      return m_comp(keys[a], keys[b]);
+    });
+    auto last = std::unique(byKey.begin(), byKey.end(), [&](size_t a, size_t b) {
+      return ! m_comp(keys[a], keys[b]);
+    });
+    byKey.erase(last, byKey.end());
+    layout(keys, values, byKey.size(), [&](size_t i) { return byKey[i]; });
+  }
+
+  // Lay out the current contents, with the element at position `skip` (if
+  // nonzero) removed and, if `extra` is non-null, `*extra` added.  Return the
+  // new position of `*extra`.
+  size_t relayout(size_t skip, pair<Key, T>* extra)
+  {
+    const size_t n = m_keys.size();
+    vector<size_t> sorted;  // Indexes, in key order
+    sorted.reserve(n);
+    for (size_t k = first_pos(n); k; k = next_pos(k, n))
+      if (k != skip)
+        sorted.push_back(k - 1);
+
+    if (! extra) {
+      layout(m_keys, m_values, sorted.size(),
+             [&](size_t i) { return sorted[i]; });
+      return 0;
+    }
+
+    // Put the new element at the end of the existing containers and splice
+    // its index into the sorted order.
+    m_keys.push_back(std::move(extra->first));
+    m_values.push_back(std::move(extra->second));
+    auto at = std::partition_point(sorted.begin(), sorted.end(),
+                                   [&](size_t i) {
+                                     return m_comp(m_keys[i], m_keys.back());
+                                   });
+    size_t rank = at - sorted.begin();
+    sorted.insert(at, n);
+    layout(m_keys, m_values, sorted.size(),
+           [&](size_t i) { return sorted[i]; });
+
+    size_t k = first_pos(n + 1);
+    while (rank--)
+      k = next_pos(k, n + 1);
+    return k;
+  }
+
+  template <bool IsConst>
+  class Iterator
+  {
+    using Map = conditional_t<IsConst, const flat_map, flat_map>;
+    using Mapped = conditional_t<IsConst, const T, T>;
+
+    Map*   m_map = nullptr;
+    size_t m_pos = 0;
+
+    friend class flat_map;
+
+  public:
+    using iterator_concept  = bidirectional_iterator_tag;
+    using iterator_category = input_iterator_tag;
+    using value_type        = pair<Key, T>;
+    using reference         = pair<const Key&, Mapped&>;
+    using difference_type   = ptrdiff_t;
+
+    struct pointer
+    {
+      reference m_ref;
+      const reference* operator->() const { return addressof(m_ref); }
+    };
+
+    Iterator() = default;
+    Iterator(Map* m, size_t pos) : m_map(m), m_pos(pos) { }
+    template <bool C2>
+      requires (IsConst && ! C2)
+    Iterator(const Iterator<C2>& other)  // Implicit
+      : m_map(other.m_map), m_pos(other.m_pos) { }
+
+    reference operator*() const
+      { return { m_map->m_keys[m_pos - 1], m_map->m_values[m_pos - 1] }; }
+    pointer operator->() const { return { **this }; }
+
+    Iterator& operator++()
+      { m_pos = next_pos(m_pos, m_map->size()); return *this; }
+    Iterator operator++(int) { auto ret = *this; ++*this; return ret; }
+    Iterator& operator--()
+      { m_pos = prev_pos(m_pos, m_map->size()); return *this; }
+    Iterator operator--(int) { auto ret = *this; --*this; return ret; }
+
+    friend bool operator==(const Iterator& a, const Iterator& b)
+      { return a.m_pos == b.m_pos; }
+  };
+
+public:
+  using key_type         = Key;
+  using mapped_type      = T;
+  using value_type       = pair<key_type, mapped_type>;
+  using key_compare      = Compare;
+  using reference        = pair<const key_type&, mapped_type&>;
+  using const_reference  = pair<const key_type&, const mapped_type&>;
+  using size_type        = size_t;
+  using iterator         = Iterator<false>;
+  using const_iterator   = Iterator<true>;
+  using key_container_type    = KeyContainer;
+  using mapped_container_type = MappedContainer;
+
+  flat_map() = default;
+  explicit flat_map(const key_compare& comp) : m_comp(comp) { }
+
+  // Construct from parallel containers of keys and mapped values, in any
+  // order.  Of duplicate keys, only the first is kept.  The behavior is
+  // undefined unless `keys.size() == values.size()`.
+  flat_map(key_container_type keys, mapped_container_type values,
+           const key_compare& comp = key_compare())
+    : m_comp(comp)
+    { sort_and_layout(keys, values); }
+
+  template <input_iterator InputIterator>
+  flat_map(InputIterator first, InputIterator last,
+           const key_compare& comp = key_compare())
+    : m_comp(comp)
+  {
+    key_container_type    keys;
+    mapped_container_type values;
+    for ( ; first != last; ++first) {
+      keys.push_back(first->first);
+      values.push_back(first->second);
+    }
+    sort_and_layout(keys, values);
+  }
+
+  flat_map(initializer_list<value_type> il,
+           const key_compare& comp = key_compare())
+    : flat_map(il.begin(), il.end(), comp) { }
+
+  // iterators (in key order)
+  iterator       begin()        noexcept { return { this, first_pos(size()) }; }
+  const_iterator begin()  const noexcept { return { this, first_pos(size()) }; }
+  iterator       end()          noexcept { return { this, 0 }; }
+  const_iterator end()    const noexcept { return { this, 0 }; }
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend()   const noexcept { return end(); }
+
+  // capacity
+  [[nodiscard]] bool empty() const noexcept { return m_keys.empty(); }
+  size_type size() const noexcept { return m_keys.size(); }
+
+  // observers
+  key_compare key_comp() const { return m_comp; }
+
+  // The underlying containers, in Eytzinger (not key) order.
+  const key_container_type&    keys()   const noexcept { return m_keys; }
+  const mapped_container_type& values() const noexcept { return m_values; }
+
+  // lookup
+  template <class K>
+  iterator find(const K& k) requires _IsMapKeyType<Key, Compare, K>
+    { return { this, find_pos(lookup_key(k)) }; }
+  template <class K>
+  const_iterator find(const K& k) const requires _IsMapKeyType<Key, Compare, K>
+    { return { this, find_pos(lookup_key(k)) }; }
+
+  template <class K>
+  bool contains(const K& k) const requires _IsMapKeyType<Key, Compare, K>
+    { return find_pos(lookup_key(k)) != 0; }
+  template <class K>
+  size_type count(const K& k) const requires _IsMapKeyType<Key, Compare, K>
+    { return contains(k) ? 1 : 0; }
+
+  template <class K>
+  [[nodiscard]] optional<mapped_type&> get(const K& k)
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    if (size_t pos = find_pos(lookup_key(k)))
+      return { m_values[pos - 1] };
+    else
+      return nullopt;
+  }
+
+  template <class K>
+  [[nodiscard]] optional<const mapped_type&> get(const K& k) const
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    if (size_t pos = find_pos(lookup_key(k)))
+      return m_values[pos - 1];
+    else
+      return nullopt;
+  }
+
+  // modifiers (O(n))
+  pair<iterator, bool> insert(value_type v)
+  {
+    if (size_t pos = find_pos(v.first))
+      return { iterator(this, pos), false };
+    return { iterator(this, relayout(0, &v)), true };
+  }
+
+  template <class K>
+  size_type erase(const K& k) requires _IsMapKeyType<Key, Compare, K>
+  {
+    size_t pos = find_pos(lookup_key(k));
+    if (pos == 0)
+      return 0;
+    relayout(pos, nullptr);
+    return 1;
+  }
+
+  void clear() noexcept { m_keys.clear(); m_values.clear(); }
+};
+
+}  // Close namespace std::experimental
+
+#endif // ! defined(INCLUDED_XFLAT_MAP)
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
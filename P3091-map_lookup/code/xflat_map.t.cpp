@@ -0,0 +1,128 @@
+/* xflat_map.t.cpp                                                    -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Tests for `experimental::flat_map`
+ */
+
+#include <xflat_map.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <random>
+#include <cassert>
+
+namespace xstd = std::experimental;
+
+using std::experimental::value_or;
+using std::experimental::reference_or;
+using std::experimental::or_invoke;
+
+// Check a map built from `n` keys `0, 2, 4, ...` against `std::map`.
+void testSize(std::size_t n)
+{
+  std::vector<int> keys(n), values(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    keys[i]   = int(2 * i);
+    values[i] = int(i);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(n));
+  for (std::size_t i = 0; i < n; ++i)
+    values[i] = keys[i] / 2;
+
+  xstd::flat_map<int, int> m(keys, values);
+  assert(n == m.size());
+
+  // Iteration is in key order, forward and backward.
+  int expected = 0;
+  for (auto [k, v] : m) {
+    assert(expected == k && expected / 2 == v);
+    expected += 2;
+  }
+  assert(int(2 * n) == expected);
+  for (auto i = m.end(); i != m.begin(); ) {
+    --i;
+    expected -= 2;
+    assert(expected == i->first);
+  }
+
+  // Every key is found; every gap (and both ends) is not.
+  for (int k = -1; k <= int(2 * n); ++k) {
+    auto v = m.get(k);
+    if (k % 2 == 0 && k < int(2 * n)) {
+      assert(v && *v == k / 2);
+      assert(m.find(k)->first == k);
+    }
+    else {
+      assert(! v);
+      assert(m.find(k) == m.end());
+    }
+  }
+}
+
+void testMaybeApi()
+{
+  xstd::flat_map<std::string, std::string, std::less<>> m{
+    { "hello", "world" }, { "one", "1" }, { "hello", "duplicate" }
+  };
+  const auto& M = m;
+  assert(2 == m.size());
+
+  std::string dummy("dummy");
+  assert("world" == value_or(M.get("hello"), "everybody"));
+  assert("everybody" == value_or(M.get("goodbye"), "everybody"));
+  assert(&m.find(std::string_view("hello"))->second ==
+         &reference_or(m.get(std::string_view("hello")), dummy));
+  assert(&dummy == &reference_or(m.get("goodbye"), dummy));
+  assert("made" == or_invoke(M.get("goodbye"), [] {
+    return std::string("made");
+  }));
+
+  // Modify through the returned reference
+  value_or<std::string&>(m.get("one"), dummy) = "uno";
+  assert("uno" == m.find("one")->second);
+}
+
+void testModifiers()
+{
+  xstd::flat_map<int, std::string> m{ { 5, "five" }, { 1, "one" } };
+
+  auto [i3, inserted] = m.insert({ 3, "three" });
+  assert(inserted && 3 == i3->first && "three" == i3->second);
+  auto [i5, inserted5] = m.insert({ 5, "FIVE" });
+  assert(! inserted5 && "five" == i5->second);
+
+  for (int k = 10; k < 20; ++k) {
+    auto [i, ok] = m.insert({ k, std::to_string(k) });
+    assert(ok && k == i->first);
+  }
+  assert(13 == m.size());
+
+  assert(1 == m.erase(3));
+  assert(0 == m.erase(3));
+  assert(! m.contains(3) && m.contains(5) && 1 == m.count(19));
+  assert("five" == value_or(m.get(5)));
+
+  int prev = -1;
+  for (auto [k, v] : m) {
+    assert(prev < k);
+    assert(v == (k == 1 ? "one" : k == 5 ? "five" : std::to_string(k)));
+    prev = k;
+  }
+
+  m.clear();
+  assert(m.empty() && m.begin() == m.end());
+}
+
+int main()
+{
+  for (std::size_t n : { 0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 100, 1000, 4097 })
+    testSize(n);
+  testMaybeApi();
+  testModifiers();
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
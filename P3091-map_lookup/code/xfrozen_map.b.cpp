@@ -0,0 +1,179 @@
+/* xfrozen_map.b.cpp                                                  -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Read-mostly benchmark: a configuration-style table of `std::string` keys
+ * read by 1, 2, 4, ... threads while a background writer replaces one entry
+ * every few milliseconds.  Compared are
+ *
+ *  - an `experimental::map` behind a `std::mutex` (the current practice),
+ *  - `atomic_frozen_map::get` for every lookup,
+ *  - `frozen_map::get` on a snapshot refreshed every 256 lookups, and
+ *  - the same without the hash index (binary search).
+ *
+ * Throughput is reported in millions of lookups per second, all reader
+ * threads combined.
+ *
+ * Usage: xfrozen_map.b [max-threads [entries [lookups-per-thread]]]
+ *        (default: 2 * hardware concurrency, 10000, 1000000)
+ */
+
+#include <xfrozen_map.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xstd = std::experimental;
+namespace chrono = std::chrono;
+
+using std::experimental::value_or;
+
+using Key = std::string;
+
+std::string makeKey(std::size_t i)
+{
+  return "route/" + std::to_string(i * 7919 % 1000003);
+}
+
+class MutexMap
+{
+  mutable std::mutex    m_mutex;
+  xstd::map<Key, int>   m_map;
+
+public:
+  explicit MutexMap(const xstd::map<Key, int>& m) : m_map(m) { }
+
+  void set(const Key& k, int v)
+  {
+    std::lock_guard lock(m_mutex);
+    m_map.insert_or_assign(k, v);
+  }
+
+  // Reader: returns a function object that looks up one key.
+  auto reader() const
+  {
+    return [this](const Key& k) {
+      std::lock_guard lock(m_mutex);
+      return value_or(m_map.get(k), 0);
+    };
+  }
+};
+
+template <xstd::frozen_index Index, bool Pinned>
+class FrozenMap
+{
+  using Map = xstd::atomic_frozen_map<Key, int>;
+  Map m_map;
+
+public:
+  explicit FrozenMap(const xstd::map<Key, int>& m)
+    : m_map(std::make_shared<const Map::snapshot_type>(m, Index)) { }
+
+  void set(const Key& k, int v)
+  {
+    m_map.update([&](auto& map) { map.insert_or_assign(k, v); });
+  }
+
+  auto reader() const
+  {
+    if constexpr (Pinned)
+      return [this](const Key& k) { return value_or(m_map.get(k), 0); };
+    else
+      return [this, snapshot = m_map.snapshot(), n = 0](const Key& k) mutable {
+        if (++n % 256 == 0)
+          snapshot = m_map.snapshot();
+        return value_or(snapshot->get(k), 0);
+      };
+  }
+};
+
+// Run `threads` readers, each doing `lookups` lookups in an `M`, while one
+// writer updates it, and return millions of lookups per second.
+template <class M>
+double measure(int threads, std::size_t entries, std::size_t lookups)
+{
+  xstd::map<Key, int> init;
+  std::vector<Key> keys;
+  for (std::size_t i = 0; i < entries; ++i) {
+    keys.push_back(makeKey(i));
+    init.emplace(keys.back(), int(i));
+  }
+  M m(init);
+
+  std::atomic<bool> done = false;
+  std::thread writer([&] {
+    for (int v = 0; ! done.load(std::memory_order_relaxed); ++v) {
+      m.set(keys[v % entries], v);
+      std::this_thread::sleep_for(chrono::milliseconds(5));
+    }
+  });
+
+  std::vector<std::thread> readers;
+  std::vector<long> checksums(threads);
+  auto start = chrono::steady_clock::now();
+  for (int t = 0; t < threads; ++t)
+    readers.emplace_back([&, t] {
+      std::mt19937 gen(t);
+      std::uniform_int_distribution<std::size_t> index(0, entries - 1);
+      auto lookup = m.reader();
+      long checksum = 0;
+      for (std::size_t i = 0; i < lookups; ++i)
+        checksum += lookup(keys[index(gen)]);
+      checksums[t] = checksum;
+    });
+  for (auto& r : readers)
+    r.join();
+  auto elapsed = chrono::steady_clock::now() - start;
+  done = true;
+  writer.join();
+
+  // Use the checksums, so the lookups cannot be discarded.
+  for (long c : checksums)
+    if (c == -1)
+      std::cout << c;
+  return double(threads * lookups) /
+    chrono::duration_cast<chrono::microseconds>(elapsed).count();
+}
+
+int main(int argc, char* argv[])
+{
+  int maxThreads = argc > 1 ? std::atoi(argv[1]) :
+                              2 * std::thread::hardware_concurrency();
+  std::size_t entries = argc > 2 ? std::atol(argv[2]) : 10000;
+  std::size_t lookups = argc > 3 ? std::atol(argv[3]) : 1000000;
+
+  using xstd::frozen_index;
+
+  std::cout << "Entries: " << entries << ", hardware threads: "
+            << std::thread::hardware_concurrency() << "\n\n"
+            << "| Readers | `mutex` + `map` | `atomic_frozen_map::get` "
+               "| snapshot, hash index | snapshot, binary search |\n"
+            << "| ------: | --------------: | ------------------------: "
+               "| -------------------: | ----------------------: |"
+            << std::endl;
+  for (int threads = 1; threads <= std::max(maxThreads, 1); threads *= 2)
+    std::cout
+      << "| " << threads
+      << " | " << measure<MutexMap>(threads, entries, lookups)
+      << " | " << measure<FrozenMap<frozen_index::hash, true>>(threads,
+                                                               entries,
+                                                               lookups)
+      << " | " << measure<FrozenMap<frozen_index::hash, false>>(threads,
+                                                                entries,
+                                                                lookups)
+      << " | " << measure<FrozenMap<frozen_index::none, false>>(threads,
+                                                                entries,
+                                                                lookups)
+      << " |" << std::endl;
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,298 @@
+/* xfrozen_map.h                                                      -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * An immutable snapshot map with the P3091 `get` interface, and a holder
+ * that publishes snapshots to readers that never wait for a writer.
+ *
+ * `experimental::frozen_map` is built in one shot from an
+ * `experimental::map` (or any sorted sequence of key-value pairs) and is
+ * never modified afterward.  Its keys and mapped values are stored sorted in
+ * two parallel contiguous arrays.  By default, an open-addressing hash index
+ * of 32-bit positions into those arrays is also built, so that a lookup is a
+ * hash, usually one probe, and one key comparison; without the index, a
+ * lookup is a binary search.
+ *
+ * `experimental::atomic_frozen_map` holds the current snapshot in an
+ * `atomic<shared_ptr<const frozen_map>>`.  A writer builds a new snapshot
+ * off to the side, without blocking readers, and publishes it with a single
+ * atomic store.  Readers that obtained the previous snapshot keep using it
+ * until they release it.
+ *
+ * Loading the current snapshot is not free, and is not lock-free in every
+ * library: libstdc++'s `atomic<shared_ptr>` is not lock-free and guards
+ * each load and store with a brief internal spin lock, and every load
+ * updates the shared reference count.  Both are contended by all readers.
+ * Every `get` (and every `snapshot`) pays that cost, so a reader doing many
+ * lookups should take one `snapshot()` and hold it across them, refreshing
+ * it only as often as it needs to see updates; lookups in a held snapshot
+ * touch no shared state at all.
+ */
+
+#ifndef INCLUDED_XFROZEN_MAP
+#define INCLUDED_XFROZEN_MAP
+
+#include <xmap.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace std::experimental {
+
+// Kind of index built by `frozen_map`, in addition to the sorted arrays.
+enum class frozen_index { none, hash };
+
+template <class Key, class T, class Compare = less<Key>,
+          class Hash = hash<Key>>
+class frozen_map
+{
+  static constexpr bool __is_transparent_hash =
+    requires { typename Hash::is_transparent; };
+
+  vector<Key>                     m_keys;   // Sorted
+  vector<T>                       m_values; // `m_values[i]` is for `m_keys[i]`
+  vector<uint32_t>                m_slots;  // Hash index: position + 1, or 0
+  [[no_unique_address]] Compare   m_comp;
+  [[no_unique_address]] Hash      m_hash;
+
+  template <class K>
+  size_t home_slot(const K& k) const
+  {
+    return __static_map_hash::mix(m_hash(k)) & (m_slots.size() - 1);
+  }
+
+  template <class K>
+  bool equivalent(const Key& a, const K& b) const
+  {
+    return ! m_comp(a, b) && ! m_comp(b, a);
+  }
+
+  void build_index()
+  {
+    if (m_keys.size() >= numeric_limits<uint32_t>::max())
+      throw length_error("frozen_map: too many entries for hash index");
+
+    // At most half full, so unsuccessful probes are short.
+    m_slots.assign(std::bit_ceil(2 * m_keys.size() + 1), 0);
+    const size_t mask = m_slots.size() - 1;
+    for (size_t i = 0; i < m_keys.size(); ++i) {
+      size_t s = home_slot(m_keys[i]);
+      while (m_slots[s])
+        s = (s + 1) & mask;
+      m_slots[s] = uint32_t(i + 1);
+    }
+  }
+
+  // Return the position of `k`, or `size()` if not found.
+  template <class K>
+  size_t position(const K& k) const
+  {
+    if constexpr (is_same_v<K, Key> || __is_transparent_hash) {
+      if (! m_slots.empty()) {
+        const size_t mask = m_slots.size() - 1;
+        for (size_t s = home_slot(k); m_slots[s]; s = (s + 1) & mask)
+          if (equivalent(m_keys[m_slots[s] - 1], k))
+            return m_slots[s] - 1;
+        return m_keys.size();
+      }
+    }
+
+    auto iter = std::lower_bound(m_keys.begin(), m_keys.end(), k, m_comp);
+    if (iter == m_keys.end() || m_comp(k, *iter))
+      return m_keys.size();
+    return iter - m_keys.begin();
+  }
+
+public:
+  using key_type     = Key;
+  using mapped_type  = T;
+  using key_compare  = Compare;
+  using hasher       = Hash;
+  using size_type    = size_t;
+
+  frozen_map() = default;
+
+  // Build from the key-value pairs in `[first, last)`, which must be sorted
+  // by key according to `comp` and have no equivalent keys, e.g., the
+  // elements of a `map`.
+  template <class InputIter>
+  frozen_map(InputIter first, InputIter last,
+             frozen_index index = frozen_index::hash,
+             const Compare& comp = Compare(), const Hash& hash = Hash())
+    : m_comp(comp), m_hash(hash)
+  {
+    for (; first != last; ++first) {
+      m_keys.push_back(first->first);
+      m_values.push_back(first->second);
+    }
+    if (index == frozen_index::hash)
+      build_index();
+  }
+
+  template <class Alloc>
+  explicit frozen_map(const ::std::map<Key, T, Compare, Alloc>& m,
+                      frozen_index index = frozen_index::hash,
+                      const Hash& hash = Hash())
+    : frozen_map(m.begin(), m.end(), index, m.key_comp(), hash)
+  {
+  }
+
+  size_type size()  const noexcept { return m_keys.size(); }
+  bool      empty() const noexcept { return m_keys.empty(); }
+  bool      has_hash_index() const noexcept { return ! m_slots.empty(); }
+
+  key_compare key_comp()      const { return m_comp; }
+  hasher      hash_function() const { return m_hash; }
+
+  span<const Key> keys()   const noexcept { return m_keys; }
+  span<const T>   values() const noexcept { return m_values; }
+
+  // Lookups through the hash index require `K` to be `Key` or `Hash` to be
+  // transparent; other keys are found by binary search.  Keys that are
+  // equivalent under `Compare` must have equal hash codes.
+  template <class K>
+  [[nodiscard]] optional<const mapped_type&> get(const K& k) const
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    const size_t pos = position(k);
+    if (pos != m_keys.size())
+      return m_values[pos];
+    else
+      return nullopt;
+  }
+
+  template <class K>
+  bool contains(const K& k) const
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    return position(k) != m_keys.size();
+  }
+
+  // Return a mutable copy, e.g., to be modified and frozen again.
+  experimental::map<Key, T, Compare> thaw() const
+  {
+    experimental::map<Key, T, Compare> ret(m_comp);
+    for (size_t i = 0; i < m_keys.size(); ++i)
+      ret.emplace_hint(ret.end(), m_keys[i], m_values[i]);
+    return ret;
+  }
+};
+
+// Proxy returned by `atomic_frozen_map::get`: refers to a mapped value (or to
+// nothing) and keeps the snapshot containing it alive until destroyed.
+template <class T, class Snapshot>
+class __pinned_ref
+{
+  shared_ptr<const Snapshot> m_snapshot;
+  const T*                   m_ptr;
+
+public:
+  using value_type = T;
+
+  __pinned_ref(shared_ptr<const Snapshot> s, const T* p) noexcept
+    : m_snapshot(std::move(s)), m_ptr(p) { }
+
+  bool has_value() const noexcept { return m_ptr != nullptr; }
+  explicit operator bool() const noexcept { return m_ptr != nullptr; }
+
+  const T& operator*()  const noexcept { return *m_ptr; }
+  const T* operator->() const noexcept { return m_ptr; }
+
+  const T& value() const
+  {
+    if (! m_ptr)
+      __throw_bad_optional_access();
+    return *m_ptr;
+  }
+};
+
+template <class Key, class T, class Compare = less<Key>,
+          class Hash = hash<Key>>
+class atomic_frozen_map
+{
+public:
+  using snapshot_type = frozen_map<Key, T, Compare, Hash>;
+  using snapshot_ptr  = shared_ptr<const snapshot_type>;
+  using mapped_type   = T;
+  using pinned_reference = __pinned_ref<T, snapshot_type>;
+
+private:
+  atomic<snapshot_ptr> m_current;
+  mutex                m_writer;  // Serializes `publish` and `update`
+
+  void store(snapshot_ptr s)
+  {
+    m_current.store(std::move(s), memory_order_release);
+  }
+
+public:
+  atomic_frozen_map() : m_current(make_shared<const snapshot_type>()) { }
+
+  explicit atomic_frozen_map(snapshot_ptr s) : m_current(std::move(s)) { }
+
+  atomic_frozen_map(const atomic_frozen_map&) = delete;
+  atomic_frozen_map& operator=(const atomic_frozen_map&) = delete;
+
+  // Return the current snapshot.  A reader doing several lookups should take
+  // one snapshot and look them all up in it, both for consistency and to
+  // pay for the atomic load (and its reference-count update) only once.
+  snapshot_ptr snapshot() const { return m_current.load(memory_order_acquire); }
+
+  // Return a reference to the value mapped to `k` in the current snapshot,
+  // or a disengaged reference.  The result keeps the snapshot alive; it does
+  // not observe later updates.  Each call loads the current snapshot; see
+  // the file comment for why hot readers should use `snapshot()` instead.
+  template <class K>
+  [[nodiscard]] pinned_reference get(const K& k) const
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    snapshot_ptr s = snapshot();
+    auto v = s->get(k);
+    return { std::move(s), v ? &*v : nullptr };
+  }
+
+  // Replace the current snapshot.  A `publish` concurrent with an `update`
+  // takes effect either before the update reads the current snapshot or
+  // after it stores its result.
+  void publish(snapshot_ptr s)
+  {
+    lock_guard lock(m_writer);
+    store(std::move(s));
+  }
+
+  void publish(snapshot_type s)
+  {
+    publish(make_shared<const snapshot_type>(std::move(s)));
+  }
+
+  // Apply `f` to a mutable copy of the current contents and publish the
+  // result, frozen with the same kind of index, comparator, and hash
+  // function.  Concurrent updates and publications are applied one at a
+  // time, so none is lost; readers are never blocked.  `f` must not call
+  // `publish` or `update` on this object.
+  template <class F>
+  void update(F&& f)
+  {
+    lock_guard lock(m_writer);
+    snapshot_ptr old = snapshot();
+    auto m = old->thaw();
+    std::invoke(std::forward<F>(f), m);
+    store(make_shared<const snapshot_type>(
+            m, old->has_hash_index() ? frozen_index::hash : frozen_index::none,
+            old->hash_function()));
+  }
+};
+
+} // close namespace std::experimental
+
+#endif // ! defined(INCLUDED_XFROZEN_MAP)
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,179 @@
+/* xfrozen_map.t.cpp                                                  -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Tests for `experimental::frozen_map` and `experimental::atomic_frozen_map`
+ */
+
+#include <xfrozen_map.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <cassert>
+
+namespace xstd = std::experimental;
+
+using std::experimental::value_or;
+
+// Transparent string hash
+struct StringHash
+{
+  using is_transparent = void;
+
+  std::size_t operator()(std::string_view sv) const
+    { return std::hash<std::string_view>{}(sv); }
+};
+
+// Check a frozen map of `n` keys `0, 3, 6, ...` with each kind of index.
+void testSize(std::size_t n)
+{
+  xstd::map<int, int> m;
+  for (std::size_t i = 0; i < n; ++i)
+    m.emplace(int(3 * i), int(i));
+
+  for (auto index : { xstd::frozen_index::hash, xstd::frozen_index::none }) {
+    xstd::frozen_map<int, int> f(m, index);
+    assert(n == f.size());
+    assert((index == xstd::frozen_index::hash) == f.has_hash_index());
+    for (int k = -1; k <= int(3 * n); ++k) {
+      auto v = f.get(k);
+      if (k >= 0 && k % 3 == 0 && k < int(3 * n))
+        assert(v && k / 3 == *v && f.contains(k));
+      else
+        assert(! v && ! f.contains(k));
+    }
+
+    // Non-`Key` lookups use binary search.
+    assert(n == 0 || 0 == value_or(f.get(0L), -1));
+    assert(-1 == value_or(f.get(1L), -1));
+  }
+}
+
+void testStrings()
+{
+  xstd::map<std::string, std::string, std::less<>> m{
+    { "host", "example.com" }, { "port", "8080" }, { "mode", "fast" }
+  };
+  xstd::frozen_map<std::string, std::string, std::less<>, StringHash> f(m);
+  assert(3 == f.size() && f.has_hash_index());
+
+  // Heterogeneous lookup through the hash index
+  assert("8080" == value_or(f.get(std::string_view("port")), ""));
+  assert("none" == value_or(f.get("user"), "none"));
+
+  // Sorted, contiguous layout
+  assert("host" == f.keys()[0] && "port" == f.keys()[2]);
+  assert("fast" == f.values()[1]);
+
+  auto thawed = f.thaw();
+  assert(thawed == m);
+}
+
+void testPublish()
+{
+  using Map = xstd::atomic_frozen_map<std::string, int>;
+  Map config;
+  assert(config.snapshot()->empty());
+  assert(! config.get("timeout"));
+
+  config.publish(Map::snapshot_type(xstd::map<std::string, int>{
+    { "timeout", 30 }, { "retries", 3 }
+  }));
+  assert(30 == value_or(config.get("timeout"), 0));
+
+  // A pinned reference and a snapshot are unaffected by later updates.
+  auto pinned = config.get("timeout");
+  auto before = config.snapshot();
+  config.update([](auto& m) { m["timeout"] = 60; m.erase("retries"); });
+  assert(60 == value_or(config.get("timeout"), 0));
+  assert(! config.get("retries"));
+  assert(30 == pinned.value() && 2 == before->size());
+  assert(config.snapshot()->has_hash_index());
+}
+
+// Hash function carrying state, which an update must preserve.
+struct SeededHash
+{
+  std::size_t m_seed = 0;
+
+  std::size_t operator()(int k) const
+    { return std::hash<int>{}(k) ^ m_seed; }
+};
+
+// `update` keeps the snapshot's functors and does not discard a snapshot
+// published while it runs.
+void testUpdatePreserves()
+{
+  using Map = xstd::atomic_frozen_map<int, int, std::less<int>, SeededHash>;
+  Map m(std::make_shared<const Map::snapshot_type>(
+          xstd::map<int, int>{ { 1, 10 } }, xstd::frozen_index::hash,
+          SeededHash{ 12345 }));
+  m.update([](auto& map) { map[2] = 20; });
+  assert(12345 == m.snapshot()->hash_function().m_seed);
+  assert(10 == value_or(m.get(1), 0) && 20 == value_or(m.get(2), 0));
+
+  // The publication waits for the update to store its result, then replaces
+  // it.
+  std::thread publisher;
+  m.update([&](auto& map) {
+    publisher = std::thread([&m] {
+      m.publish(Map::snapshot_type(xstd::map<int, int>{ { 3, 30 } }));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    map[4] = 40;
+  });
+  publisher.join();
+  assert(30 == value_or(m.get(3), 0) && ! m.get(4));
+}
+
+// Readers see either the old or the new snapshot, never a mix; no update is
+// lost when several writers race.
+void testConcurrent()
+{
+  xstd::atomic_frozen_map<int, int> m;
+  m.update([](auto& map) {
+    for (int k = 0; k < 64; ++k)
+      map[k] = 0;
+  });
+
+  constexpr int writers = 2, updates = 50;
+  std::vector<std::thread> threads;
+  for (int w = 0; w < writers; ++w)
+    threads.emplace_back([&m] {
+      for (int u = 0; u < updates; ++u)
+        m.update([](auto& map) {
+          for (auto& [k, v] : map)
+            ++v;
+        });
+    });
+  threads.emplace_back([&m] {
+    for (int r = 0; r < 1000; ++r) {
+      auto s = m.snapshot();
+      int first = value_or(s->get(0), -1);
+      for (int k = 0; k < 64; ++k)
+        assert(first == value_or(s->get(k), -1));
+    }
+  });
+  for (auto& t : threads)
+    t.join();
+
+  assert(writers * updates == value_or(m.get(63), 0));
+}
+
+int main()
+{
+  for (std::size_t n : { 0, 1, 2, 3, 7, 8, 100, 1000 })
+    testSize(n);
+  testStrings();
+  testPublish();
+  testUpdatePreserves();
+  testConcurrent();
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
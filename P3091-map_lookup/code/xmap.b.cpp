@@ -0,0 +1,234 @@
+/* xmap.b.cpp                                                         -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Lookup benchmark for `experimental::map`: the cost of reading a value or a
+ * default with each lookup idiom,
+ *
+ *  - `value_or(m.get(k), 0)` on a non-const map (`optional<T&>`),
+ *  - `value_or(cm.get(k), 0)` on a const map (`optional<const T&>`),
+ *  - `find` compared against `end`, and
+ *  - `at` inside `try`, with the default returned from `catch`,
+ *
+ * for `int` and `std::string` keys, at hit rates from 0% to 100%, and for
+ * maps from L1-cache-resident (256 entries) to DRAM-resident (1M entries).
+ * A second table compares looking up every probe with `get` against one
+ * batched `get_many` call over all of them, for `map` and `unordered_map`.
+ * After an untimed warm-up pass of every idiom, the idioms are timed `reps`
+ * times each, in an order rotated from one repetition to the next, so that
+ * none of them always runs first on the caches left by the others.  Times
+ * are the best of the repetitions, in ns per lookup.
+ *
+ * Usage: xmap.b [lookups [max-size [reps]]]    (default: 200000 1048576 5)
+ */
+
+#include <xmap.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace xstd = std::experimental;
+namespace chrono = std::chrono;
+
+using std::experimental::value_or;
+
+const int hitRates[] = { 0, 50, 90, 100 };
+int       reps       = 5;
+
+// Time `lookup(k)` for every `k` in `probes`, or, if `lookup` accepts the
+// whole vector, one call `lookup(probes)`, returning ns per lookup.
+template <class Key, class F>
+double measure(const std::vector<Key>& probes, F lookup)
+{
+  long long checksum = 0;
+  auto start = chrono::steady_clock::now();
+  if constexpr (std::is_invocable_v<F&, const std::vector<Key>&>)
+    checksum = lookup(probes);
+  else
+    for (const Key& k : probes)
+      checksum += lookup(k);
+  auto elapsed = chrono::steady_clock::now() - start;
+
+  // Use the checksum, so the lookups cannot be discarded.
+  if (checksum == -1)
+    std::cout << checksum;
+  return double(chrono::duration_cast<chrono::nanoseconds>(elapsed).count()) /
+    probes.size();
+}
+
+// Time each of `lookups` over `probes` as described above, returning the
+// best ns per lookup of each, in the order given.
+template <class Key, class... F>
+std::array<double, sizeof...(F)> measureAll(const std::vector<Key>& probes,
+                                            F... lookups)
+{
+  constexpr std::size_t count = sizeof...(F);
+
+  // Time the `which`th lookup idiom.
+  auto run = [&](std::size_t which) {
+    std::size_t i = 0;
+    double t = 0;
+    ((i++ == which ? (void) (t = measure(probes, lookups)) : (void) 0), ...);
+    return t;
+  };
+
+  for (std::size_t j = 0; j < count; ++j)
+    run(j);  // Warm-up
+
+  std::array<double, count> best;
+  best.fill(std::numeric_limits<double>::infinity());
+  for (int r = 0; r < reps; ++r)
+    for (std::size_t j = 0; j < count; ++j) {
+      std::size_t which = (r + j) % count;
+      best[which] = std::min(best[which], run(which));
+    }
+  return best;
+}
+
+// Run every idiom on a map of `n` entries keyed by `makeKey(0)`,
+// `makeKey(2)`, ..., `makeKey(2n - 2)`; absent keys are odd arguments.
+template <class Key, class MakeKey>
+void benchSize(std::size_t n, std::size_t lookups, MakeKey makeKey)
+{
+  xstd::map<Key, int> m;
+  for (std::size_t i = 0; i < n; ++i)
+    m.emplace(makeKey(2 * i), int(i));
+  const xstd::map<Key, int>& cm = m;
+
+  std::mt19937 gen(n);
+  for (int hitRate : hitRates) {
+    auto probes = makeProbes<Key>(n, lookups, hitRate, gen, makeKey);
+
+    auto [tGet, tConstGet, tFind, tAt] = measureAll(probes,
+      [&](const Key& k) { return value_or(m.get(k), 0); },
+      [&](const Key& k) { return value_or(cm.get(k), 0); },
+      [&](const Key& k) {
+        auto i = m.find(k);
+        return i == m.end() ? 0 : i->second;
+      },
+      [&](const Key& k) {
+        try {
+          return m.at(k);
+        }
+        catch (const std::out_of_range&) {
+          return 0;
+        }
+      });
+
+    std::cout << "| " << n << " | " << hitRate << " | " << tGet << " | "
+              << tConstGet << " | " << tFind << " | " << tAt << " |"
+              << std::endl;
+  }
+}
+
+// Return `makeKey(2 * i + 1)` (absent) or `makeKey(2 * i)` (present) for
+// `lookups` random `i < n`, with `hitRate` percent present.
+template <class Key, class MakeKey>
+std::vector<Key> makeProbes(std::size_t n, std::size_t lookups, int hitRate,
+                            std::mt19937& gen, MakeKey makeKey)
+{
+  std::uniform_int_distribution<std::size_t> index(0, n - 1);
+  std::uniform_int_distribution<int> pct(0, 99);
+  std::vector<Key> probes;
+  probes.reserve(lookups);
+  for (std::size_t i = 0; i < lookups; ++i) {
+    bool hit = pct(gen) < hitRate;
+    probes.push_back(makeKey(2 * index(gen) + (hit ? 0 : 1)));
+  }
+  return probes;
+}
+
+// Compare `get` with `get_many` on a `map` and an `unordered_map` of `n`
+// entries, keyed as in `benchSize`.
+template <class Key, class MakeKey>
+void benchBatchSize(std::size_t n, std::size_t lookups, MakeKey makeKey)
+{
+  xstd::map<Key, int>           m;
+  xstd::unordered_map<Key, int> um;
+  for (std::size_t i = 0; i < n; ++i) {
+    m.emplace(makeKey(2 * i), int(i));
+    um.emplace(makeKey(2 * i), int(i));
+  }
+
+  std::mt19937 gen(n);
+  std::vector<xstd::optional<int&>> out(lookups);
+  auto getMany = [&](auto& map) {
+    return [&](const std::vector<Key>& probes) {
+      map.get_many(std::span<const Key>(probes), std::span(out));
+      long long checksum = 0;
+      for (auto v : out)
+        checksum += value_or(v, 0);
+      return checksum;
+    };
+  };
+
+  for (int hitRate : { 50, 100 }) {
+    auto probes = makeProbes<Key>(n, lookups, hitRate, gen, makeKey);
+    auto [tGet, tGetMany, tUGet, tUGetMany] = measureAll(probes,
+      [&](const Key& k) { return value_or(m.get(k), 0); },
+      getMany(m),
+      [&](const Key& k) { return value_or(um.get(k), 0); },
+      getMany(um));
+
+    std::cout << "| " << n << " | " << hitRate << " | " << tGet << " | "
+              << tGetMany << " | " << tUGet << " | " << tUGetMany << " |"
+              << std::endl;
+  }
+}
+
+template <class Key, class MakeKey>
+void benchKeyType(const char* name, std::size_t lookups, std::size_t maxSize,
+                  MakeKey makeKey)
+{
+  std::cout << "\n**" << name << " keys**\n\n"
+            << "| Entries | Hit % | `get` + `value_or` | `const` `get` "
+               "| `find`/`end` | `at`/`catch` |\n"
+            << "| ------: | ----: | -----------------: | ------------: "
+               "| -----------: | -----------: |" << std::endl;
+  for (std::size_t n = 256; n <= maxSize; n *= 16)
+    benchSize<Key>(n, lookups, makeKey);
+
+  std::cout << "\n**" << name << " keys, batched**\n\n"
+            << "| Entries | Hit % | `map` `get` | `map` `get_many` "
+               "| `unordered_map` `get` | `unordered_map` `get_many` |\n"
+            << "| ------: | ----: | ----------: | ---------------: "
+               "| --------------------: | -------------------------: |"
+            << std::endl;
+  for (std::size_t n = 256; n <= maxSize; n *= 16)
+    benchBatchSize<Key>(n, lookups, makeKey);
+}
+
+int main(int argc, char* argv[])
+{
+  std::size_t lookups = argc > 1 ? std::atol(argv[1]) : 200000;
+  std::size_t maxSize = argc > 2 ? std::atol(argv[2]) : 1048576;
+  if (argc > 3)
+    reps = std::atoi(argv[3]);
+
+  benchKeyType<int>("`int`", lookups, maxSize,
+                    [](std::size_t i) { return int(i); });
+
+  // 20-character keys, too long for the short-string optimization
+  benchKeyType<std::string>("`std::string`", lookups, maxSize,
+                            [](std::size_t i) {
+                              char buf[32];
+                              std::snprintf(buf, sizeof buf,
+                                            "lookup-key-%09zu", i);
+                              return std::string(buf);
+                            });
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
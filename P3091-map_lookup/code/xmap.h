@@ -10,6 +10,16 @@
 #define INCLUDED_XMAP
 
 #include <map>
+#include <unordered_map>
+#include <functional>
+#include <span>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <utility>
 #include <xoptional.h>
 
 namespace std::experimental {
@@ -19,6 +29,76 @@ concept _IsMapKeyType = is_convertible_v<K, Key> ||
   requires { typename Compare::is_transparent; };
 
 
+// Keys accepted by `get_many`: the key type itself or, with a transparent
+// comparator, any type the comparator accepts.  Other convertible types are
+// not accepted, as each would be converted to `Key` at every comparison.
+template <class Key, class Compare, class K>
+concept _IsMapLookupKeyType = is_same_v<K, Key> ||
+  requires { typename Compare::is_transparent; };
+
+// Number of lookups interleaved by `get_many`.
+inline constexpr size_t __get_many_group = 16;
+
+// Argument passed to the `mapped_type` constructor by `get_or_emplace_with`.
+// Converting it invokes `f`, so the value returned by `f` initializes the new
+// element directly, without an intermediate copy or move.
+template <class F>
+struct __invoke_result_converter
+{
+  F& m_f;
+
+  operator invoke_result_t<F&>() const { return std::invoke(m_f); }
+};
+
+// A type that no constructor of a `mapped_type` expects.  A `mapped_type`
+// constructible from it has an unconstrained converting constructor (e.g.,
+// `std::any`), which would take an `__invoke_result_converter` itself as the
+// value instead of converting it.
+struct __unrelated_arg { };
+
+template <class T, class F>
+concept __constructible_by_invoke_converter =
+  ! is_constructible_v<T, __unrelated_arg> &&
+  is_constructible_v<T, __invoke_result_converter<F>>;
+
+// Deferred constructor arguments used by `get_or_emplace_with` when the
+// converter cannot be used: `f` is invoked only when an element is inserted,
+// and the element is then constructed from the result.
+template <class F>
+struct __deferred_invoke
+{
+  F& m_f;
+};
+
+template <class Args>
+inline constexpr bool __is_deferred_invoke = false;
+template <class F>
+inline constexpr bool __is_deferred_invoke<__deferred_invoke<F>> = true;
+
+// Return `emplace(t)`, where `t` is `args` or, if `args` is a
+// `__deferred_invoke`, a tuple holding the result of invoking its functor,
+// which lives until `emplace` returns.
+template <class Args, class Emplace>
+decltype(auto) __emplace_with_args(Args&& args, Emplace&& emplace)
+{
+  if constexpr (__is_deferred_invoke<remove_cvref_t<Args>>)
+    return emplace(std::forward_as_tuple(std::invoke(args.m_f)));
+  else
+    return emplace(std::forward<Args>(args));
+}
+
+// Constructor arguments for an element inserted by `get_or_emplace_with`:
+// the result of `f()`, converted directly into the element where possible.
+template <class T, class F>
+auto __get_or_emplace_with_args(F& f)
+{
+  if constexpr (__constructible_by_invoke_converter<T, F>)
+    return std::tuple<__invoke_result_converter<F>>(
+      __invoke_result_converter<F>{ f });
+  else
+    return __deferred_invoke<F>{ f };
+}
+
 template <class Key, class T, class Compare = less<Key>,
           class Allocator = allocator<pair<const Key, T>>>
 class map : public ::std::map<Key, T, Compare, Allocator>
@@ -54,47 +134,645 @@ public:
     else
       return nullopt;
   }
+
+  // Return a reference to the value mapped to `k`, first inserting an element
+  // whose value is constructed from `args...` if there is none.  The tree is
+  // traversed once; an insertion uses the lower bound of `k` as its hint.
+  // With a transparent comparator, `k` is converted to `Key` only if an
+  // element is inserted.
+  template <class K, class... Args>
+  mapped_type& get_or_emplace(K&& k, Args&&... args)
+    requires (_IsMapKeyType<Key, Compare, remove_cvref_t<K>> &&
+              is_constructible_v<Key, K> &&
+              is_constructible_v<mapped_type, Args...>)
+  {
+    return get_or_emplace_impl(std::forward<K>(k), std::forward_as_tuple(
+                                 std::forward<Args>(args)...));
+  }
+
+  // Return a reference to the value mapped to `k`, first inserting an element
+  // whose value is initialized from the result of `f()` if there is none.
+  // `f` is not invoked if `k` is found.
+  template <class K, class F>
+  mapped_type& get_or_emplace_with(K&& k, F&& f)
+    requires (_IsMapKeyType<Key, Compare, remove_cvref_t<K>> &&
+              is_constructible_v<Key, K> &&
+              (__constructible_by_invoke_converter<mapped_type, F> ||
+               is_constructible_v<mapped_type, invoke_result_t<F&>>))
+  {
+    return get_or_emplace_impl(std::forward<K>(k),
+                               __get_or_emplace_with_args<mapped_type>(f));
+  }
+
+  // Look up each of `keys`, setting the corresponding element of `out` to
+  // refer to the mapped value or to `nullopt`, and return the number of keys
+  // found.  The behavior is undefined unless `out.size() >= keys.size()`.
+  // The lookups are interleaved so that the cache misses of up to
+  // `__get_many_group` tree traversals overlap, instead of being taken one
+  // key at a time.
+  template <class K>
+  size_t get_many(span<const K> keys, span<optional<mapped_type&>> out)
+    requires _IsMapLookupKeyType<Key, Compare, K>
+  {
+    size_t found = 0;
+    find_many(keys, [&](size_t i, const typename StdMap::value_type* v) {
+      if (v) {
+        out[i] = const_cast<mapped_type&>(v->second);
+        ++found;
+      }
+      else
+        out[i].reset();
+    });
+    return found;
+  }
+
+  template <class K>
+  size_t get_many(span<const K> keys,
+                  span<optional<const mapped_type&>> out) const
+    requires _IsMapLookupKeyType<Key, Compare, K>
+  {
+    size_t found = 0;
+    find_many(keys, [&](size_t i, const typename StdMap::value_type* v) {
+      if (v) {
+        out[i] = v->second;
+        ++found;
+      }
+      else
+        out[i].reset();
+    });
+    return found;
+  }
+
+private:
+  template <class K, class Args>
+  mapped_type& get_or_emplace_impl(K&& k, Args&& args)
+  {
+    if constexpr (requires { typename Compare::is_transparent; } ||
+                  is_same_v<remove_cvref_t<K>, Key>) {
+      auto iter = this->lower_bound(k);
+      if (iter == this->end() || this->key_comp()(k, iter->first))
+        iter = __emplace_with_args(std::move(args), [&](auto&& a) {
+          return this->emplace_hint(iter, piecewise_construct,
+                                    std::forward_as_tuple(std::forward<K>(k)),
+                                    std::move(a));
+        });
+      return iter->second;
+    }
+    else
+      // Convert once, rather than at every comparison.
+      return get_or_emplace_impl(Key(std::forward<K>(k)), std::move(args));
+  }
+
+  // Call `f(i, v)` for each `keys[i]`, where `v` points to the matching
+  // element or is null.  With libstdc++, up to `__get_many_group` lower-bound
+  // searches advance in lock step, one tree level per round, and the next
+  // node of each is prefetched before any of them is dereferenced.
+  template <class K, class F>
+  void find_many(span<const K> keys, F&& f) const
+  {
+#ifdef __GLIBCXX__
+    using NodeBase = _Rb_tree_node_base;
+    using Node     = _Rb_tree_node<typename StdMap::value_type>;
+
+    auto elem = [](const NodeBase* n) {
+      return static_cast<const Node*>(n)->_M_valptr();
+    };
+
+    const Compare   comp   = this->key_comp();
+    const NodeBase* header = this->end()._M_node;
+    const NodeBase* root   = header->_M_parent;
+
+    for (size_t first = 0; first < keys.size(); first += __get_many_group) {
+      const size_t n = std::min(__get_many_group, keys.size() - first);
+      const K* group = keys.data() + first;
+
+      const NodeBase* x[__get_many_group];  // Current node of each search
+      const NodeBase* y[__get_many_group];  // Lower bound so far
+      std::fill_n(x, n, root);
+      std::fill_n(y, n, header);
+
+      for (bool active = root != nullptr; active; ) {
+        active = false;
+        for (size_t i = 0; i < n; ++i) {
+          if (! x[i])
+            continue;
+          if (! comp(elem(x[i])->first, group[i])) {
+            y[i] = x[i];
+            x[i] = x[i]->_M_left;
+          }
+          else
+            x[i] = x[i]->_M_right;
+          if (x[i]) {
+            __builtin_prefetch(x[i]);
+            active = true;
+          }
+        }
+      }
+
+      for (size_t i = 0; i < n; ++i)
+        f(first + i, (y[i] != header && ! comp(group[i], elem(y[i])->first)) ?
+                     elem(y[i]) : nullptr);
+    }
+#else
+    for (size_t i = 0; i < keys.size(); ++i) {
+      auto iter = this->find(keys[i]);
+      f(i, iter != this->end() ? std::addressof(*iter) : nullptr);
+    }
+#endif
+  }
 };
 
-// Test constexpr get in the absence of a constexpr-enabled std::map
-template <class T, size_t SZ>
+template <class Key, class Hash, class Pred, class K>
+concept _IsUnorderedMapKeyType = is_convertible_v<K, Key> ||
+  requires {
+    typename Hash::is_transparent;
+    typename Pred::is_transparent;
+  };
+
+// A lookup key together with its hash code, as computed by the map's hash
+// function.  Passed to `find` on an `experimental::unordered_map` so that the
+// key is not hashed a second time.
+template <class K>
+struct __prehashed_key
+{
+  const K& key;
+  size_t   hash;
+};
+
+// Hash function adaptor used by `experimental::unordered_map`.  It forwards
+// to `Hash`, except that the stored hash code of a `__prehashed_key` is
+// returned as is.  The adaptor is always transparent, so that a
+// `__prehashed_key` reaches it through the heterogeneous `find`;
+// `unordered_map::get` decides whether other heterogeneous keys are used
+// as-is or first converted to `Key`.
+template <class Hash>
+struct __prehash_hasher
+{
+  using is_transparent = void;
+
+  [[no_unique_address]] Hash m_hash;
+
+  __prehash_hasher() = default;
+  __prehash_hasher(const Hash& h) : m_hash(h) { }  // Implicit
+
+  template <class K>
+  size_t operator()(const K& k) const noexcept(noexcept(m_hash(k)))
+    { return m_hash(k); }
+  template <class K>
+  size_t operator()(const __prehashed_key<K>& k) const noexcept
+    { return k.hash; }
+};
+
+// Equality adaptor used by `experimental::unordered_map`; unwraps a
+// `__prehashed_key` and forwards to `Pred`.
+template <class Pred>
+struct __prehash_equal
+{
+  using is_transparent = void;
+
+  [[no_unique_address]] Pred m_pred;
+
+  __prehash_equal() = default;
+  __prehash_equal(const Pred& p) : m_pred(p) { }  // Implicit
+
+  template <class K1, class K2>
+  bool operator()(const K1& a, const K2& b) const { return m_pred(a, b); }
+  template <class K1, class K2>
+  bool operator()(const __prehashed_key<K1>& a, const K2& b) const
+    { return m_pred(a.key, b); }
+  template <class K1, class K2>
+  bool operator()(const K1& a, const __prehashed_key<K2>& b) const
+    { return m_pred(a, b.key); }
+};
+
+template <class Key, class T, class Hash = hash<Key>,
+          class Pred = equal_to<Key>,
+          class Allocator = allocator<pair<const Key, T>>>
+class unordered_map
+  : public ::std::unordered_map<Key, T, __prehash_hasher<Hash>,
+                                __prehash_equal<Pred>, Allocator>
+{
+  using StdMap = ::std::unordered_map<Key, T, __prehash_hasher<Hash>,
+                                      __prehash_equal<Pred>, Allocator>;
+
+  static constexpr bool __is_transparent =
+    requires {
+      typename Hash::is_transparent;
+      typename Pred::is_transparent;
+    };
+
+  // Return `k` if it can be looked up directly; otherwise, convert it to
+  // `Key` once, rather than once for hashing and again for every equality
+  // comparison.
+  template <class K>
+  static decltype(auto) lookup_key(const K& k)
+  {
+    if constexpr (__is_transparent || is_same_v<K, Key>)
+      return (k);
+    else
+      return Key(k);
+  }
+
+public:
+  using key_type    = typename StdMap::key_type;
+  using mapped_type = typename StdMap::mapped_type;
+  using iterator    = typename StdMap::iterator;
+  using hasher      = Hash;
+  using key_equal   = Pred;
+
+  // Delegate all constructors to base class
+  using StdMap::unordered_map;
+
+  hasher    hash_function() const { return StdMap::hash_function().m_hash; }
+  key_equal key_eq()        const { return StdMap::key_eq().m_pred; }
+
+  template <class K>
+  [[nodiscard]] optional<mapped_type&> get(const K& k)
+    requires _IsUnorderedMapKeyType<Key, Hash, Pred, K>
+  {
+    auto iter = this->find(lookup_key(k));
+    if (iter != this->end())
+      return { iter->second };
+    else
+      return nullopt;
+  }
+
+  template <class K>
+  [[nodiscard]] optional<const mapped_type&> get(const K& k) const
+    requires _IsUnorderedMapKeyType<Key, Hash, Pred, K>
+  {
+    auto iter = this->find(lookup_key(k));
+    if (iter != this->end())
+      return iter->second;
+    else
+      return nullopt;
+  }
+
+  // Look up `k`, whose hash code, `hash_function()(k)`, is already known
+  // (e.g., because it was used to select a shard), without hashing it again.
+  template <class K>
+  [[nodiscard]] optional<mapped_type&> get(const K& k, size_t hash)
+    requires _IsUnorderedMapKeyType<Key, Hash, Pred, K>
+  {
+    const auto& lk = lookup_key(k);
+    using LK = remove_cvref_t<decltype(lk)>;
+    auto iter = this->find(__prehashed_key<LK>{ lk, hash });
+    if (iter != this->end())
+      return { iter->second };
+    else
+      return nullopt;
+  }
+
+  template <class K>
+  [[nodiscard]] optional<const mapped_type&> get(const K& k, size_t hash) const
+    requires _IsUnorderedMapKeyType<Key, Hash, Pred, K>
+  {
+    const auto& lk = lookup_key(k);
+    using LK = remove_cvref_t<decltype(lk)>;
+    auto iter = this->find(__prehashed_key<LK>{ lk, hash });
+    if (iter != this->end())
+      return iter->second;
+    else
+      return nullopt;
+  }
+
+  // Return a reference to the value mapped to `k`, first inserting an element
+  // whose value is constructed from `args...` if there is none.  If `k` is
+  // found, it is hashed once and its bucket is searched once.  With a
+  // transparent hash and equality, `k` is converted to `Key` only if an
+  // element is inserted; the new key is then hashed again.
+  template <class K, class... Args>
+  mapped_type& get_or_emplace(K&& k, Args&&... args)
+    requires (_IsUnorderedMapKeyType<Key, Hash, Pred, remove_cvref_t<K>> &&
+              is_constructible_v<Key, K> &&
+              is_constructible_v<mapped_type, Args...>)
+  {
+    return get_or_emplace_impl(std::forward<K>(k), std::forward_as_tuple(
+                                 std::forward<Args>(args)...));
+  }
+
+  // Return a reference to the value mapped to `k`, first inserting an element
+  // whose value is initialized from the result of `f()` if there is none.
+  // `f` is not invoked if `k` is found.
+  template <class K, class F>
+  mapped_type& get_or_emplace_with(K&& k, F&& f)
+    requires (_IsUnorderedMapKeyType<Key, Hash, Pred, remove_cvref_t<K>> &&
+              is_constructible_v<Key, K> &&
+              (__constructible_by_invoke_converter<mapped_type, F> ||
+               is_constructible_v<mapped_type, invoke_result_t<F&>>))
+  {
+    return get_or_emplace_impl(std::forward<K>(k),
+                               __get_or_emplace_with_args<mapped_type>(f));
+  }
+
+  // Look up each of `keys`, setting the corresponding element of `out` to
+  // refer to the mapped value or to `nullopt`, and return the number of keys
+  // found.  The behavior is undefined unless `out.size() >= keys.size()`.
+  // The keys are processed in groups of `__get_many_group`: all keys in a
+  // group are hashed, then the head of each key's bucket is loaded and the
+  // first node of its chain is prefetched, and only then are the chains
+  // searched.  Each key is hashed exactly once.
+  template <class K>
+  size_t get_many(span<const K> keys, span<optional<mapped_type&>> out)
+    requires (is_same_v<K, Key> || __is_transparent)
+  {
+    size_t found = 0;
+    find_many(keys, [&](size_t i, const typename StdMap::value_type* v) {
+      if (v) {
+        out[i] = const_cast<mapped_type&>(v->second);
+        ++found;
+      }
+      else
+        out[i].reset();
+    });
+    return found;
+  }
+
+  template <class K>
+  size_t get_many(span<const K> keys,
+                  span<optional<const mapped_type&>> out) const
+    requires (is_same_v<K, Key> || __is_transparent)
+  {
+    size_t found = 0;
+    find_many(keys, [&](size_t i, const typename StdMap::value_type* v) {
+      if (v) {
+        out[i] = v->second;
+        ++found;
+      }
+      else
+        out[i].reset();
+    });
+    return found;
+  }
+
+private:
+  template <class K, class Args>
+  mapped_type& get_or_emplace_impl(K&& k, Args&& args)
+  {
+    using RawK = remove_cvref_t<K>;
+    if constexpr (is_same_v<RawK, Key>) {
+      // `try_emplace` hashes `k` once and copies it only on insertion.  A
+      // deferred `get_or_emplace_with` functor is invoked only after `find`
+      // fails, as `try_emplace` would evaluate its arguments in any case.
+      if constexpr (__is_deferred_invoke<remove_cvref_t<Args>>) {
+        if (auto iter = this->find(k); iter != this->end())
+          return iter->second;
+      }
+      auto iter = __emplace_with_args(std::move(args), [&](auto&& t) {
+        return std::apply([&](auto&&... a) {
+          return this->try_emplace(std::forward<K>(k),
+                                   std::forward<decltype(a)>(a)...).first;
+        }, std::move(t));
+      });
+      return iter->second;
+    }
+    else if constexpr (__is_transparent) {
+      const size_t h = StdMap::hash_function()(k);
+      auto iter = this->find(__prehashed_key<RawK>{ k, h });
+      if (iter == this->end())
+        iter = __emplace_with_args(std::move(args), [&](auto&& a) {
+          return this->emplace(piecewise_construct,
+                               std::forward_as_tuple(std::forward<K>(k)),
+                               std::move(a)).first;
+        });
+      return iter->second;
+    }
+    else
+      return get_or_emplace_impl(Key(std::forward<K>(k)), std::move(args));
+  }
+
+  template <class K, class F>
+  void find_many(span<const K> keys, F&& f) const
+  {
+    const auto hf = StdMap::hash_function();
+    size_t hashes[__get_many_group];
+
+    for (size_t first = 0; first < keys.size(); first += __get_many_group) {
+      const size_t n = std::min(__get_many_group, keys.size() - first);
+      const K* group = keys.data() + first;
+
+      for (size_t i = 0; i < n; ++i)
+        hashes[i] = hf(group[i]);
+
+#ifdef __GLIBCXX__
+      // libstdc++ places hash code `h` in bucket `h % bucket_count()`.
+      // `begin(b)` loads bucket `b`'s slot and the node before its chain;
+      // those loads are independent across keys, so the misses of the whole
+      // group overlap instead of being taken one `find` at a time.  The
+      // first node of each chain, which `find` compares first, is then
+      // prefetched.
+      const size_t buckets = this->bucket_count();
+      for (size_t i = 0; i < n; ++i) {
+        const size_t b = hashes[i] % buckets;
+        auto local = this->begin(b);
+        if (local != this->end(b))
+          __builtin_prefetch(std::addressof(*local));
+      }
+#endif
+
+      for (size_t i = 0; i < n; ++i) {
+        auto iter = this->find(__prehashed_key<K>{ group[i], hashes[i] });
+        f(first + i, iter != this->end() ? std::addressof(*iter) : nullptr);
+      }
+    }
+  }
+};
+
+// Hash function used by `ArrayMap`: FNV-1a for strings and a 64-bit
+// finalizer (from SplitMix64) for integers, both usable at compile time.
+struct __static_map_hash
+{
+  static constexpr uint64_t mix(uint64_t h) noexcept
+  {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+  }
+
+  template <integral I>
+  constexpr uint64_t operator()(I k) const noexcept
+    { return mix(uint64_t(k)); }
+
+  template <class E>
+    requires is_enum_v<E>
+  constexpr uint64_t operator()(E k) const noexcept
+    { return mix(uint64_t(to_underlying(k))); }
+
+  constexpr uint64_t operator()(string_view s) const noexcept
+  {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (char c : s)
+      h = (h ^ uint64_t(static_cast<unsigned char>(c))) * 0x100000001b3ULL;
+    return mix(h);
+  }
+};
+
+// Immutable map of `N` entries, whose keys are known at compile time,
+// typically used as a `constexpr` lookup table in place of a `std::map`
+// built at startup.  The constructor, which may run at compile time, builds
+// a minimal perfect hash of the keys by "hash and displace": keys are
+// grouped into `N` buckets by their hash code, and, largest bucket first,
+// each bucket is assigned the first seed that sends all of its keys to
+// distinct unused slots of the entry array.  A lookup is then O(1): hash the
+// key once, read the seed of its bucket, compute the slot, and compare one
+// key.  Construction throws `logic_error` (and, at compile time, does not
+// compile) if two keys compare equal, or if no seed is found for some bucket,
+// which happens only if distinct keys have the same hash code.
+template <class Key, class T, size_t N, class Hash = __static_map_hash>
 class ArrayMap
 {
-  using at = array<T, SZ>;
+  using Entry   = pair<Key, T>;
+  using Entries = array<Entry, N>;
+
+  Entries                    m_entries{};
+  array<uint32_t, N>         m_seeds{};   // Indexed by bucket
+  [[no_unique_address]] Hash m_hash;
 
-  at m_contents;
+  // Number of seeds tried for a bucket before giving up.  A bucket of one key
+  // with a single free slot needs about `N` tries.
+  static constexpr uint64_t max_seeds = 64 * uint64_t(N) + 1024;
+
+  static constexpr size_t bucket(uint64_t h) noexcept { return h % N; }
+  static constexpr size_t slot(uint64_t h, uint32_t seed) noexcept
+    { return __static_map_hash::mix(h + seed * 0x9e3779b97f4a7c15ULL) % N; }
+
+  constexpr size_t find_slot(const Key& k) const
+  {
+    if constexpr (N == 0)
+      return 0;
+    else {
+      const uint64_t h = m_hash(k);
+      return slot(h, m_seeds[bucket(h)]);
+    }
+  }
 
 public:
-  constexpr ArrayMap(const at& c) : m_contents(c) { }
+  using key_type       = Key;
+  using mapped_type    = T;
+  using value_type     = Entry;
+  using iterator       = typename Entries::iterator;
+  using const_iterator = typename Entries::const_iterator;
+
+  constexpr ArrayMap(const array<Entry, N>& entries, const Hash& hash = Hash())
+    : m_hash(hash)
+  {
+    array<uint64_t, N> hashes{};
+    array<size_t, N>   bucketSize{};
+    for (size_t i = 0; i < N; ++i) {
+      hashes[i] = m_hash(entries[i].first);
+      ++bucketSize[bucket(hashes[i])];
+    }
+
+    // Buckets, largest first
+    array<size_t, N> order{};
+    for (size_t b = 0; b < N; ++b)
+      order[b] = b;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return bucketSize[a] > bucketSize[b];
+    });
+
+    array<bool, N>   used{};
+    array<size_t, N> members{};  // Entries in the current bucket
+    array<size_t, N> slots{};    // Their slots for the current seed
+    for (size_t b : order) {
+      if (bucketSize[b] == 0)
+        break;
+
+      size_t count = 0;
+      for (size_t i = 0; i < N; ++i)
+        if (bucket(hashes[i]) == b)
+          members[count++] = i;
+
+      // Equal keys have equal hash codes, so they are in the same bucket.
+      for (size_t j = 0; j < count; ++j)
+        for (size_t m = 0; m < j; ++m)
+          if (entries[members[m]].first == entries[members[j]].first)
+            throw logic_error("ArrayMap: duplicate keys");
+
+      for (uint32_t seed = 0; ; ++seed) {
+        if (seed == max_seeds)
+          throw logic_error("ArrayMap: no perfect hash for the keys");
+        bool ok = true;
+        for (size_t j = 0; ok && j < count; ++j) {
+          slots[j] = slot(hashes[members[j]], seed);
+          ok = ! used[slots[j]];
+          for (size_t m = 0; ok && m < j; ++m)
+            ok = slots[m] != slots[j];
+        }
+        if (ok) {
+          m_seeds[b] = seed;
+          for (size_t j = 0; j < count; ++j) {
+            used[slots[j]] = true;
+            m_entries[slots[j]] = entries[members[j]];
+          }
+          break;
+        }
+      }
+    }
+  }
 
-  using iterator = at::iterator;
-  using const_iterator = at::const_iterator;
+  // Iteration is over all entries, in unspecified order.
+  constexpr iterator begin() { return m_entries.begin(); }
+  constexpr const_iterator begin() const { return m_entries.begin(); }
+  constexpr iterator end() { return m_entries.end(); }
+  constexpr const_iterator end() const { return m_entries.end(); }
+  static constexpr size_t size() noexcept { return N; }
 
-  constexpr iterator begin() { return m_contents.begin(); }
-  constexpr const_iterator begin() const { return m_contents.begin(); }
-  constexpr iterator end() { return m_contents.end(); }
-  constexpr const_iterator end() const { return m_contents.end(); }
+  constexpr iterator find(const Key& k)
+  {
+    iterator i = begin() + find_slot(k);
+    return N != 0 && i->first == k ? i : end();
+  }
+  constexpr const_iterator find(const Key& k) const
+  {
+    const_iterator i = begin() + find_slot(k);
+    return N != 0 && i->first == k ? i : end();
+  }
 
-  constexpr iterator find(size_t k) { return k < SZ ? begin() + k : end(); }
-  constexpr const_iterator find(size_t k) const
-    { return k < SZ ? begin() + k : end(); }
+  constexpr bool contains(const Key& k) const { return find(k) != end(); }
 
-  constexpr optional<T&> get(size_t k) {
+  constexpr optional<T&> get(const Key& k) {
     if (auto i = find(k); i != end())
       return i->second;
     else
       return nullopt;
   }
-  constexpr optional<const T&> get(size_t k) const {
+  constexpr optional<const T&> get(const Key& k) const {
     if (auto i = find(k); i != end())
-      return *i;
+      return i->second;
     else
       return nullopt;
   }
 };
 
+// Return an `ArrayMap` of the specified `entries`, deducing `N`:
+//..
+//  constexpr auto colors = make_array_map<string_view, int>({
+//    { "red", 0xff0000 }, { "green", 0x00ff00 }, { "blue", 0x0000ff } });
+//..
+template <class Key, class T, class Hash = __static_map_hash, size_t N>
+constexpr ArrayMap<Key, T, N, Hash>
+make_array_map(const pair<Key, T> (&entries)[N], const Hash& hash = Hash())
+{
+  return ArrayMap<Key, T, N, Hash>(to_array(entries), hash);
+}
+
 }  // Close namespace std::experimental
 
+#ifdef __GLIBCXX__
+namespace std {
+
+// libstdc++ caches hash codes in the nodes of an unordered container (and
+// skips the full equality test on a hash mismatch) only for hash functions
+// that are not marked fast, such as `hash<string>`.  Keep the adaptor from
+// changing that choice.
+template <class Hash>
+struct __is_fast_hash<experimental::__prehash_hasher<Hash>>
+  : __is_fast_hash<Hash> { };
+
+}  // Close namespace std
+#endif
+
 
 #endif // ! defined(INCLUDED_XMAP)
 
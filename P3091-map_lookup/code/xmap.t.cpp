@@ -12,13 +12,22 @@
 #include <array>
 #include <vector>
 #include <span>
+#include <algorithm>
+#include <string_view>
 #include <functional>
 #include <cassert>
+#include <any>
+#include <stdexcept>
+#include <type_traits>
 
 template <class Key, class T, class Compare = std::less<Key>,
           class Allocator = std::allocator<std::pair<const Key, T>>>
 using xmap = std::experimental::map<Key, T, Compare, Allocator>;
 
+template <class Key, class T, class Hash = std::hash<Key>,
+          class Pred = std::equal_to<Key>>
+using xumap = std::experimental::unordered_map<Key, T, Hash, Pred>;
+
 template <class T> using xoptional = std::experimental::optional<T>;
 
 
@@ -461,21 +470,347 @@ void test_span()
   assert(0 == z.size());
 }
 
+// Transparent string hash that counts its invocations
+struct CountingHash
+{
+  using is_transparent = void;
+
+  static inline int s_calls = 0;
+
+  std::size_t operator()(std::string_view sv) const
+  {
+    ++s_calls;
+    return std::hash<std::string_view>{}(sv);
+  }
+};
+
+void test_unordered_get()
+{
+  using std::experimental::value_or;
+
+  {
+    xumap<std::string, std::string>        m1;
+    xumap<std::string, std::string> const& M1 = m1;
+    m1.emplace("hello", "world");
+
+    expect<std::string>("world",     value_or(M1.get("hello"), "everybody"));
+    expect<std::string>("everybody", value_or(M1.get("goodbye"), "everybody"));
+    expect<std::string>("world",     value_or(m1.get("hello"), "everybody"));
+
+    std::string& world = m1.at("hello");
+    expect<std::string*>(&world, &value_or<std::string&>(m1.get("hello"),
+                                                          world));
+
+    // Non-transparent hash: the key is converted to `std::string` once
+    std::size_t h = m1.hash_function()("hello");
+    static_assert(std::is_same_v<std::hash<std::string>,
+                                 decltype(m1.hash_function())>);
+    expect<std::string>("world",     value_or(m1.get("hello", h), "none"));
+    expect<std::string>("world",     value_or(M1.get(std::string("hello"), h),
+                                              "none"));
+    assert(1 == M1.size());
+  }
+
+  {
+    xumap<std::string, int, CountingHash, std::equal_to<>> m2;
+    m2.emplace("one", 1);
+    m2.emplace("a key long enough to make hashing it twice noticeable", 2);
+
+    // Heterogeneous lookup hashes the `string_view` once
+    CountingHash::s_calls = 0;
+    assert(1 == value_or(m2.get(std::string_view("one")), 0));
+    assert(1 == CountingHash::s_calls);
+
+    // Lookup with a precomputed hash code does not call the hash function
+    std::string_view key = "a key long enough to make hashing it twice "
+                           "noticeable";
+    std::size_t h = m2.hash_function()(key);
+    CountingHash::s_calls = 0;
+    assert(2 == value_or(m2.get(key, h), 0));
+    assert(0 == value_or(m2.get(std::string_view("two"),
+                                m2.hash_function()("two")), 0));
+    assert(1 == CountingHash::s_calls);
+
+    ++value_or<int&>(m2.get(key, h), CountingHash::s_calls);
+    assert(3 == m2.at(std::string(key)));
+  }
+}
+
+// A key type that counts its conversions from `string_view`
+struct CountedString : std::string
+{
+  static inline int s_conversions = 0;
+
+  explicit CountedString(std::string_view sv) : std::string(sv)
+    { ++s_conversions; }
+};
+
+// Check `get_or_emplace` and `get_or_emplace_with` for a map type `M` having
+// `CountedString` keys, `int` values, and transparent lookup.
+template <class M>
+void check_get_or_emplace()
+{
+  using std::experimental::value_or;
+
+  M m;
+  const std::string_view text[] = {
+    "the", "cat", "saw", "the", "other", "cat", "the"
+  };
+
+  // Word count: a key is converted only when it is inserted
+  CountedString::s_conversions = 0;
+  for (std::string_view word : text)
+    ++m.get_or_emplace(word);
+  assert(4 == m.size());
+  assert(4 == CountedString::s_conversions);
+  assert(3 == value_or(m.get(std::string_view("the")), 0));
+  assert(2 == value_or(m.get(std::string_view("cat")), 0));
+  assert(1 == value_or(m.get(std::string_view("other")), 0));
+
+  // Arguments are used only on insertion
+  int& dog = m.get_or_emplace("dog", 7);
+  assert(7 == dog);
+  assert(&dog == &m.get_or_emplace("dog", 9));
+  assert(7 == dog && 5 == m.size());
+
+  // The functor is invoked only on insertion
+  int calls = 0;
+  auto make = [&calls] { ++calls; return 42; };
+  assert(2 == m.get_or_emplace_with(std::string_view("cat"), make));
+  assert(0 == calls);
+  assert(42 == m.get_or_emplace_with(std::string_view("bird"), make));
+  assert(1 == calls && 6 == m.size());
+  assert(6 == CountedString::s_conversions);
+}
+
+void test_get_or_emplace()
+{
+  check_get_or_emplace<xmap<CountedString, int, std::less<>>>();
+  check_get_or_emplace<xumap<CountedString, int, CountingHash,
+                             std::equal_to<>>>();
+
+  {
+    // A found key is hashed only once.
+    xumap<std::string, int, CountingHash, std::equal_to<>> m;
+    m.get_or_emplace(std::string_view("one"), 1);
+    CountingHash::s_calls = 0;
+    assert(1 == ++m.get_or_emplace(std::string_view("one")) - 1);
+    assert(1 == CountingHash::s_calls);
+  }
+
+  {
+    // Non-transparent comparator: `const char*` is converted once.  A
+    // non-copyable, non-movable value is initialized from `f()` in place.
+    xmap<std::string, NonCopyable> m;
+    assert(5 == m.get_or_emplace("five", 5));
+    assert(5 == m.get_or_emplace("five", 6));
+    auto& v = m.get_or_emplace_with("three", [] { return NonCopyable(3); });
+    assert(3 == v && &v == &m.at("three"));
+    assert(2 == m.size());
+  }
+
+  {
+    xumap<std::string, NonCopyable> m;
+    std::string key("key");
+    auto& v = m.get_or_emplace(key, 1);
+    assert(&v == &m.get_or_emplace(std::move(key), 2));
+    assert("key" == key);  // Not moved from, since it was not inserted
+    assert(1 == m.get_or_emplace_with("key", [] { return NonCopyable(0); }));
+    assert(0 == m.get_or_emplace_with("other",
+                                      [] { return NonCopyable(0); }));
+    assert(2 == m.size());
+  }
+
+  {
+    // Values with unconstrained converting constructors hold the result of
+    // `f()`, not the object used to convert it.
+    xmap<int, std::any> a;
+    assert(5 == std::any_cast<int>(a.get_or_emplace_with(1, [] {
+      return std::any(5); })));
+    assert(5 == std::any_cast<int>(a.get_or_emplace_with(1, [] {
+      return std::any(6); })));
+    xumap<int, std::any> ua;
+    assert(7 == std::any_cast<int>(ua.get_or_emplace_with(1, [] {
+      return 7; })));
+
+    int calls = 0;
+    xumap<std::string, std::function<int()>> uf;
+    auto make = [&calls] {
+      ++calls;
+      return std::function<int()>([] { return 3; });
+    };
+    assert(3 == uf.get_or_emplace_with(std::string("f"), make)());
+    assert(3 == uf.get_or_emplace_with(std::string("f"), make)());
+    assert(1 == calls);
+    xmap<int, std::function<int()>> f;
+    assert(4 == f.get_or_emplace_with(0, [] { return [] { return 4; }; })());
+  }
+}
+
+// Check `get_many` against `get` for a map type `M`, with `int` keys.
+template <class M>
+void check_get_many()
+{
+  M m;
+  for (int i = 0; i < 1000; i += 3)
+    m.emplace(i, i * 10);
+  const M& M1 = m;
+
+  // More keys than one group, and a partial last group
+  std::vector<int> keys;
+  for (int k = -5; k < 1100; k += 7)
+    keys.push_back(k);
+
+  std::vector<xoptional<int&>>       out(keys.size());
+  std::vector<xoptional<const int&>> cout(keys.size());
+  std::size_t found  = m.get_many(std::span<const int>(keys), std::span(out));
+  std::size_t cfound = M1.get_many(std::span<const int>(keys), std::span(cout));
+
+  std::size_t expected = 0;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    auto single = m.get(keys[i]);
+    assert(bool(out[i]) == bool(single));
+    assert(bool(cout[i]) == bool(single));
+    if (single) {
+      ++expected;
+      assert(&*out[i] == &*single);
+      assert(&*cout[i] == &*single);
+    }
+  }
+  assert(expected == found && expected == cfound);
+  assert(expected > 0 && expected < keys.size());
+
+  // Modify through the result
+  std::size_t i3 = std::find(keys.begin(), keys.end(), 30) - keys.begin();
+  assert(i3 < keys.size());
+  *out[i3] = -1;
+  assert(-1 == m.at(30));
+
+  // Empty map and empty key list
+  M empty;
+  assert(0 == empty.get_many(std::span<const int>(keys), std::span(out)));
+  assert(! out[0] && ! out.back());
+  assert(0 == m.get_many(std::span<const int>(), std::span(out)));
+}
+
+void test_get_many()
+{
+  check_get_many<xmap<int, int>>();
+  check_get_many<xmap<int, int, std::less<>>>();
+  check_get_many<xumap<int, int>>();
+
+  // Transparent heterogeneous keys
+  xmap<std::string, int, std::less<>> m{ { "one", 1 }, { "two", 2 } };
+  xumap<std::string, int, CountingHash, std::equal_to<>> u{ { "one", 1 },
+                                                            { "two", 2 } };
+  std::string_view keys[] = { "two", "three", "one" };
+  xoptional<int&> out[3];
+  assert(2 == m.get_many(std::span<const std::string_view>(keys),
+                         std::span(out)));
+  assert(2 == *out[0] && ! out[1] && 1 == *out[2]);
+
+  CountingHash::s_calls = 0;
+  assert(2 == u.get_many(std::span<const std::string_view>(keys),
+                         std::span(out)));
+  assert(2 == *out[0] && ! out[1] && 1 == *out[2]);
+  assert(3 == CountingHash::s_calls);  // Each key hashed exactly once
+}
+
 // Test constexpr `get`
-constexpr std::experimental::ArrayMap<int, 3> AM1({ 3, 2, 1 });
+constexpr std::experimental::ArrayMap<std::size_t, int, 3> AM1({{
+  { 0, 3 }, { 1, 2 }, { 2, 1 } }});
 static_assert(AM1.get(1));
 
 static_assert(2 == AM1.get(1).value());
 static_assert(! AM1.get(10));
 
+// String keys, with `N` deduced
+enum class Color { red, green, blue, cyan, magenta, yellow, black, white };
+constexpr auto colorNames = std::experimental::make_array_map<std::string_view,
+                                                              Color>({
+  { "red",  Color::red },  { "green",   Color::green },
+  { "blue", Color::blue }, { "cyan",    Color::cyan },
+  { "magenta", Color::magenta }, { "yellow", Color::yellow },
+  { "black", Color::black }, { "white", Color::white } });
+
+static_assert(8 == colorNames.size());
+static_assert(Color::magenta == colorNames.get("magenta").value());
+static_assert(Color::black == value_or(colorNames.get("black"), Color::white));
+static_assert(! colorNames.get("purple"));
+static_assert(! colorNames.contains(""));
+
+// Every key maps to its own entry.
+static_assert([] {
+  for (const auto& [name, color] : colorNames)
+    if (&colorNames.get(name).value() != &color)
+      return false;
+  return true;
+}());
+
+// Enumerator keys, and modification through a non-const `get`
+constexpr int countColors()
+{
+  auto counts = std::experimental::make_array_map<Color, int>({
+      { Color::red, 0 }, { Color::green, 0 }, { Color::blue, 0 } });
+  for (Color c : { Color::red, Color::blue, Color::red, Color::white })
+    if (auto n = counts.get(c))
+      ++*n;
+  return 100 * counts.get(Color::red).value() +
+    10 * value_or(counts.get(Color::green)) + value_or(counts.get(Color::blue));
+}
+static_assert(201 == countColors());
+
+// Empty map
+constexpr std::experimental::ArrayMap<int, int, 0> AM0({});
+static_assert(! AM0.get(0));
+
+// Duplicate keys are rejected at compile time: `arrayMapBuilds<K>()` is a
+// constant expression only if the keys `K` and `K + Dup` are distinct.
+template <int K, int Dup>
+constexpr bool arrayMapBuilds()
+{
+  std::experimental::ArrayMap<int, int, 3> m({{ {K, 1}, {7, 2}, {K + Dup, 3} }});
+  return m.contains(K);
+}
+
+template <int K, int Dup>
+concept ArrayMapIsConstant =
+  requires { typename std::bool_constant<arrayMapBuilds<K, Dup>()>; };
+
+static_assert(ArrayMapIsConstant<1, 1>);
+static_assert(! ArrayMapIsConstant<1, 0>);
+
+// #define NEGATIVE_TEST
+#ifdef NEGATIVE_TEST
+// Error: "ArrayMap: duplicate keys" thrown in a constant expression
+constexpr std::experimental::ArrayMap<int, int, 2> AMDup({{ {1, 1}, {1, 2} }});
+#endif
+
+void test_array_map_duplicates()
+{
+  // At run time, duplicate keys are reported by an exception.
+  int k = 5;
+  try {
+    std::experimental::ArrayMap<int, int, 3> m({{ {k, 1}, {7, 2}, {k, 3} }});
+    assert(false);
+  }
+  catch (const std::logic_error& e) {
+    assert(std::string_view("ArrayMap: duplicate keys") == e.what());
+  }
+}
+
 int main()
 {
+  test_array_map_duplicates();
   test_get();
   test_get_ref();
   test_get_ref_derived();
   test_get_as();
   test_get_as_ref();
   test_span();
+  test_unordered_get();
+  test_get_or_emplace();
+  test_get_many();
 }
 
 // Local Variables:
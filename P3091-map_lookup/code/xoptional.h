@@ -7,11 +7,39 @@
 #ifndef INCLUDED_XOPTIONAL
 #define INCLUDED_XOPTIONAL
 
+#include <functional>
 #include <optional>
 #include <maybe.h>
 
 namespace std::experimental {
 
+template <class T> class optional;
+
+template <class T>
+struct __is_optional_ref : false_type {};
+template <class T>
+struct __is_optional_ref<optional<T&>> : true_type {};
+
+template <class T>
+struct __is_xoptional : false_type {};
+template <class T>
+struct __is_xoptional<optional<T>> : true_type {};
+
+// Result of `transform` on an `optional`: a function returning an lvalue
+// reference yields an `optional` reference; otherwise, the result holds a
+// value.
+template <class U>
+using __transform_result_t =
+  optional<conditional_t<is_lvalue_reference_v<U>, U, remove_cv_t<U>>>;
+
+// `value()` on a disengaged `optional` reports the error out of line, so that
+// the accessors stay small enough to be inlined everywhere.
+[[noreturn, gnu::cold, gnu::noinline]]
+inline void __throw_bad_optional_access()
+{
+  throw bad_optional_access();
+}
+
 template <class T>
 class optional : public std::optional<T> {
 public:
@@ -20,31 +48,95 @@ public:
   template <class U>
   requires (is_constructible_v<T, const U&>)
   explicit(! is_convertible_v<U, T>)
-    optional(const optional<U>& rhs) { if (rhs) *this = *rhs; }
+    constexpr optional(const optional<U>& rhs)
+    { if (rhs) this->emplace(*rhs); }
 
   template <class U>
   requires (is_constructible_v<T, U>)
   explicit(! is_convertible_v<U, T>)
-    optional(optional<U>&& rhs) { if (rhs) *this = *std::move(rhs); }
+    constexpr optional(optional<U>&& rhs)
+    { if (rhs) this->emplace(*std::move(rhs)); }
 
   template <class U = remove_cv_t<T>>
-  T value_or(U&& u) const& {
+  constexpr T value_or(U&& u) const& {
     return this->has_value() ? **this : static_cast<T>(std::forward<U>(u));
   }
   template <class U = remove_cv_t<T>>
-  T value_or(U&& u) && {
-    return this->has_value() ? **this : static_cast<T>(std::forward<U>(u));
+  constexpr T value_or(U&& u) && {
+    return this->has_value() ? std::move(**this)
+                             : static_cast<T>(std::forward<U>(u));
   }
 
-  // TBD: All monadic operations need to be re-implemented here, as the
-  // inherited ones mandate functors that return `std::optional` instead of
-  // `std::experimental::optional`.
-};
+  // Monadic operations.  These hide the inherited ones, which mandate
+  // functors that return `std::optional` and themselves return
+  // `std::optional`.  Here, `and_then` accepts a functor returning either
+  // kind of `optional`; `transform` and `or_else` return
+  // `experimental::optional`, and `transform` may yield an `optional`
+  // reference.
+  template <class F>
+  constexpr auto and_then(F&& f) &
+    { return and_then_impl(*this, std::forward<F>(f)); }
+  template <class F>
+  constexpr auto and_then(F&& f) const&
+    { return and_then_impl(*this, std::forward<F>(f)); }
+  template <class F>
+  constexpr auto and_then(F&& f) &&
+    { return and_then_impl(std::move(*this), std::forward<F>(f)); }
+  template <class F>
+  constexpr auto and_then(F&& f) const&&
+    { return and_then_impl(std::move(*this), std::forward<F>(f)); }
 
-template <class T>
-struct __is_optional_ref : false_type {};
-template <class T>
-struct __is_optional_ref<optional<T&>> : true_type {};
+  template <class F>
+  constexpr auto transform(F&& f) &
+    { return transform_impl(*this, std::forward<F>(f)); }
+  template <class F>
+  constexpr auto transform(F&& f) const&
+    { return transform_impl(*this, std::forward<F>(f)); }
+  template <class F>
+  constexpr auto transform(F&& f) &&
+    { return transform_impl(std::move(*this), std::forward<F>(f)); }
+  template <class F>
+  constexpr auto transform(F&& f) const&&
+    { return transform_impl(std::move(*this), std::forward<F>(f)); }
+
+  template <class F>
+  requires (is_copy_constructible_v<T>)
+  constexpr optional or_else(F&& f) const&
+    { return this->has_value() ? *this : optional(std::forward<F>(f)()); }
+  template <class F>
+  requires (is_move_constructible_v<T>)
+  constexpr optional or_else(F&& f) &&
+  {
+    return this->has_value() ? std::move(*this)
+                             : optional(std::forward<F>(f)());
+  }
+
+private:
+  template <class Self, class F>
+  static constexpr auto and_then_impl(Self&& self, F&& f)
+  {
+    using Elem = decltype(*std::forward<Self>(self));
+    using U    = remove_cvref_t<invoke_result_t<F, Elem>>;
+    static_assert(__is_xoptional<U>::value ||
+                  is_same_v<U, std::optional<typename U::value_type>>,
+                  "and_then requires a function returning an optional");
+    if (self.has_value())
+      return std::invoke(std::forward<F>(f), *std::forward<Self>(self));
+    else
+      return U();
+  }
+
+  template <class Self, class F>
+  static constexpr auto transform_impl(Self&& self, F&& f)
+  {
+    using Elem = decltype(*std::forward<Self>(self));
+    using R    = __transform_result_t<invoke_result_t<F, Elem>>;
+    if (self.has_value())
+      return R(std::invoke(std::forward<F>(f), *std::forward<Self>(self)));
+    else
+      return R();
+  }
+};
 
 template <class T>
 class optional<T&> {
@@ -73,7 +165,8 @@ public:
   constexpr ~optional() = default;
 
   // ?.?.1.4, assignment
-  constexpr optional& operator=(nullopt_t) noexcept { m_val = nullptr; }
+  constexpr optional& operator=(nullopt_t) noexcept
+    { m_val = nullptr; return *this; }
   constexpr optional& operator=(const optional&) noexcept = default;
   constexpr optional& operator=(optional&&) noexcept = default;
   template <class U = T>
@@ -88,11 +181,14 @@ public:
   constexpr optional& operator=(const optional<U>& v) {
     static_assert(is_lvalue_reference_v<U>);
     m_val = v.has_value() ? addressof(*v) : nullptr;
+    return *this;
   }
   template <class U>
   requires(!is_same_v<remove_cvref_t<U>, optional>)
   constexpr T& emplace(U&& v) {
-    return *this = v;
+    static_assert(is_lvalue_reference_v<U>);
+    m_val = addressof(v);
+    return *m_val;
   }
 
   // ?.?.1.5, swap
@@ -104,31 +200,29 @@ public:
   constexpr explicit operator bool() const noexcept { return m_val; }
   constexpr bool has_value() const noexcept { return m_val; }
   constexpr T& value() const {
-    if (m_val) return *m_val;
-    throw bad_optional_access();
+    if (! m_val) [[unlikely]] __throw_bad_optional_access();
+    return *m_val;
   }
   template <class U = remove_cv_t<T>>
-  remove_cv_t<T> value_or(U&& u) const {
+  constexpr remove_cv_t<T> value_or(U&& u) const {
     using X = remove_cv_t<T>;
-    return this->has_value() ? value() : static_cast<X>(std::forward<U>(u));
+    return m_val ? *m_val : static_cast<X>(std::forward<U>(u));
   }
 
   // ?.?.1.7, monadic operations
   template <class F>
   constexpr auto and_then(F&& f) const {
-    using U = invoke_result_t<F, T&>;
-    return *m_val ? invoke(std::forward<F>(f), *m_val) : U(nullopt);
+    using U = remove_cvref_t<invoke_result_t<F, T&>>;
+    return m_val ? std::invoke(std::forward<F>(f), *m_val) : U();
   }
   template <class F>
   constexpr optional or_else(F&& f) const {
-    using U = invoke_result_t<F, T&>;
-    return *m_val ? U(nullopt) : invoke(std::forward<F>(f), *m_val);
+    return m_val ? *this : optional(std::forward<F>(f)());
   }
   template <class F>
   constexpr auto transform(F&& f) const {
-    using U = remove_cv_t<invoke_result_t<F, T&>>;
-    using R = optional<U>;
-    return *m_val ? R(invoke(std::forward<F>(f), *m_val)) : R(nullopt);
+    using R = __transform_result_t<invoke_result_t<F, T&>>;
+    return m_val ? R(std::invoke(std::forward<F>(f), *m_val)) : R();
   }
 
   // ?.?.1.8, modifiers
@@ -0,0 +1,135 @@
+/* xsharded_map.b.cpp                                                 -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Multithreaded read/write benchmark: `experimental::sharded_map` vs. an
+ * `experimental::map` behind a single `std::mutex` and behind a single
+ * `std::shared_mutex`.  Each thread performs a mix of lookups,
+ * `value_or(m.get(k), 0)`, and increments of random keys, with the given
+ * percentage of writes.  Throughput is reported in millions of operations
+ * per second (all threads combined) for 1, 2, 4, ... threads.
+ *
+ * Usage: xsharded_map.b [max-threads [write-percent [ops-per-thread]]]
+ *        (default: 2 * hardware concurrency, 10, 1000000)
+ */
+
+#include <xsharded_map.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace xstd = std::experimental;
+namespace chrono = std::chrono;
+
+using std::experimental::value_or;
+
+constexpr int keyCount = 100000;
+
+// `experimental::map` protected by a single lock of type `Mutex`.
+template <class Mutex>
+class LockedMap
+{
+  mutable Mutex            m_mutex;
+  xstd::map<int, long>     m_map;
+
+public:
+  long read(int k) const
+  {
+    if constexpr (std::is_same_v<Mutex, std::shared_mutex>) {
+      std::shared_lock lock(m_mutex);
+      return value_or(m_map.get(k), 0L);
+    }
+    else {
+      std::lock_guard lock(m_mutex);
+      return value_or(m_map.get(k), 0L);
+    }
+  }
+
+  void write(int k)
+  {
+    std::lock_guard lock(m_mutex);
+    ++m_map.get_or_emplace(k);
+  }
+};
+
+class ShardedMap
+{
+  xstd::sharded_map<int, long> m_map;
+
+public:
+  // Looks up through a non-const map, as most callers do.
+  long read(int k) { return value_or(m_map.get(k), 0L); }
+  void write(int k) { m_map.update(k, [](long& v) { ++v; }); }
+};
+
+// Run `threads` threads, each doing `ops` operations on a `M`, and return
+// millions of operations per second.
+template <class M>
+double measure(int threads, int writePercent, long ops)
+{
+  M m;
+  for (int k = 0; k < keyCount; k += 2)
+    m.write(k);
+
+  std::vector<std::thread> workers;
+  std::vector<long> checksums(threads);
+  auto start = chrono::steady_clock::now();
+  for (int t = 0; t < threads; ++t)
+    workers.emplace_back([&, t] {
+      std::mt19937 gen(t);
+      std::uniform_int_distribution<int> key(0, keyCount - 1), pct(0, 99);
+      long checksum = 0;
+      for (long i = 0; i < ops; ++i) {
+        int k = key(gen);
+        if (pct(gen) < writePercent)
+          m.write(k);
+        else
+          checksum += m.read(k);
+      }
+      checksums[t] = checksum;
+    });
+  for (auto& w : workers)
+    w.join();
+  auto elapsed = chrono::steady_clock::now() - start;
+
+  // Use the checksums, so the lookups cannot be discarded.
+  for (long c : checksums)
+    if (c == -1)
+      std::cout << c;
+  return double(threads * ops) /
+    chrono::duration_cast<chrono::microseconds>(elapsed).count();
+}
+
+int main(int argc, char* argv[])
+{
+  int  maxThreads   = argc > 1 ? std::atoi(argv[1]) :
+                                 2 * std::thread::hardware_concurrency();
+  int  writePercent = argc > 2 ? std::atoi(argv[2]) : 10;
+  long ops          = argc > 3 ? std::atol(argv[3]) : 1000000;
+
+  std::cout << "Writes: " << writePercent << "%, hardware threads: "
+            << std::thread::hardware_concurrency() << "\n\n"
+            << "| Threads | `mutex` (Mops/s) | `shared_mutex` (Mops/s) "
+               "| `sharded_map` (Mops/s) |\n"
+            << "| ------: | ---------------: | ----------------------: "
+               "| ---------------------: |" << std::endl;
+  for (int threads = 1; threads <= std::max(maxThreads, 1); threads *= 2)
+    std::cout << "| " << threads
+              << " | " << measure<LockedMap<std::mutex>>(threads,
+                                                         writePercent, ops)
+              << " | " << measure<LockedMap<std::shared_mutex>>(threads,
+                                                                writePercent,
+                                                                ops)
+              << " | " << measure<ShardedMap>(threads, writePercent, ops)
+              << " |" << std::endl;
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
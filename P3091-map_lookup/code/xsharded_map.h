@@ -0,0 +1,346 @@
+/* xsharded_map.h                                                     -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * A concurrent map with the P3091 `get` interface.
+ *
+ * `experimental::sharded_map` partitions its keys, by hash code, across a
+ * power-of-two number of shards.  Each shard is an `experimental::map`
+ * protected by its own `shared_mutex` and aligned to its own cache line, so
+ * operations on keys in different shards do not contend, and readers of the
+ * same shard share its lock.
+ *
+ * `get` returns a *guarded reference*: a proxy that holds the shard's lock
+ * in shared mode for as long as it lives and otherwise behaves like
+ * `optional<const T&>`.  It models the `maybe` concept, so
+ * `value_or(m.get(k), v)` and the other functions in `maybe.h` copy the
+ * value out while the lock is still held, and concurrent readers of a shard
+ * do not exclude one another.  Modifying a value in place takes the shard's
+ * lock exclusively, through `update` or `get_for_update`.  A reference
+ * obtained from the proxy must not be used after the proxy is destroyed; use
+ * `get_copy` to keep a value without holding a lock.
+ *
+ * The locks are not recursive: a thread holding a guarded reference must not
+ * call any other operation that locks the same shard (including `get`, which
+ * may deadlock with a waiting writer) until the guard is destroyed or
+ * `reset`.
+ */
+
+#ifndef INCLUDED_XSHARDED_MAP
+#define INCLUDED_XSHARDED_MAP
+
+#include <xmap.h>
+#include <bit>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+namespace std::experimental {
+
+// Proxy returned by `sharded_map::get`, referring to a mapped value (or to
+// nothing) and holding `Lock` on the value's shard until it is destroyed or
+// `reset`.
+template <class T, class Lock>
+class __guarded_ref
+{
+  Lock m_lock;
+  T*   m_ptr;
+
+public:
+  using value_type = remove_cv_t<T>;
+
+  __guarded_ref(Lock&& lock, T* p) noexcept
+    : m_lock(std::move(lock)), m_ptr(p) { }
+
+  __guarded_ref(__guarded_ref&&) = default;
+  __guarded_ref& operator=(__guarded_ref&&) = default;
+
+  bool has_value() const noexcept { return m_ptr != nullptr; }
+  explicit operator bool() const noexcept { return m_ptr != nullptr; }
+
+  T& operator*()  const noexcept { return *m_ptr; }
+  T* operator->() const noexcept { return m_ptr; }
+
+  T& value() const
+  {
+    if (! m_ptr)
+      __throw_bad_optional_access();
+    return *m_ptr;
+  }
+
+  // Disengage and release the lock early.
+  void reset() noexcept
+  {
+    m_ptr = nullptr;
+    if (m_lock.owns_lock())
+      m_lock.unlock();
+  }
+};
+
+// Shards are aligned to this many bytes so that the locks of adjacent shards
+// do not share a cache line.
+inline constexpr size_t __shard_alignment = 64;
+
+template <class Key, class T, class Compare = less<Key>,
+          class Hash = hash<Key>,
+          class Allocator = allocator<pair<const Key, T>>>
+class sharded_map
+{
+  using Map = experimental::map<Key, T, Compare, Allocator>;
+
+  struct alignas(__shard_alignment) Shard
+  {
+    mutable shared_mutex m_mutex;
+    Map                  m_map;
+  };
+
+  static constexpr bool __is_transparent =
+    requires { typename Hash::is_transparent; };
+
+  unique_ptr<Shard[]>         m_shards;
+  size_t                      m_mask;   // Number of shards minus 1
+  [[no_unique_address]] Hash  m_hash;
+
+  // Select the shard for `k`.  A heterogeneous key is hashed directly if
+  // `Hash` is transparent; otherwise, it is converted to `Key` first.  The
+  // hash code is mixed so that hash functions that leave the low bits poorly
+  // distributed (e.g., identity hashes of aligned values) still spread keys
+  // across shards.
+  template <class K>
+  Shard& shard_for(const K& k) const
+  {
+    size_t h;
+    if constexpr (__is_transparent || is_same_v<K, Key>)
+      h = m_hash(k);
+    else
+      h = m_hash(Key(k));
+    return m_shards[__static_map_hash::mix(h) & m_mask];
+  }
+
+public:
+  using key_type        = Key;
+  using mapped_type     = T;
+  using value_type      = pair<const Key, T>;
+  using key_compare     = Compare;
+  using hasher          = Hash;
+  using allocator_type  = Allocator;
+  using size_type       = size_t;
+
+  using guarded_reference       = __guarded_ref<T, unique_lock<shared_mutex>>;
+  using const_guarded_reference =
+    __guarded_ref<const T, shared_lock<shared_mutex>>;
+
+  // Default number of shards: enough that concurrent threads rarely collide.
+  static size_t default_shard_count() noexcept
+  {
+    return std::bit_ceil(std::max(4 * thread::hardware_concurrency(), 16u));
+  }
+
+  // Create an empty map with `shards` shards, rounded up to a power of two.
+  explicit sharded_map(size_t shards = default_shard_count(),
+                       const Hash& hash = Hash(),
+                       const Allocator& alloc = Allocator())
+    : m_shards(new Shard[std::bit_ceil(std::max(shards, size_t(1)))])
+    , m_mask(std::bit_ceil(std::max(shards, size_t(1))) - 1)
+    , m_hash(hash)
+  {
+    if constexpr (! is_same_v<Allocator, allocator<value_type>>)
+      for (size_t i = 0; i <= m_mask; ++i)
+        m_shards[i].m_map = Map(alloc);
+  }
+
+  sharded_map(initializer_list<value_type> il,
+              size_t shards = default_shard_count())
+    : sharded_map(shards)
+  {
+    for (const value_type& v : il)
+      try_emplace(v.first, v.second);
+  }
+
+  sharded_map(const sharded_map&) = delete;
+  sharded_map& operator=(const sharded_map&) = delete;
+
+  size_t  shard_count()  const noexcept { return m_mask + 1; }
+  hasher  hash_function() const { return m_hash; }
+
+  // Return the index of the shard that holds (or would hold) `k`.
+  template <class K>
+  size_t shard_index(const K& k) const
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    return &shard_for(k) - m_shards.get();
+  }
+
+  // Return a guarded reference to the value mapped to `k`, or a disengaged
+  // one if there is none.  The shard holding `k` stays locked in shared mode
+  // until the result is destroyed, so lookups of a shard, on const and
+  // non-const maps alike, proceed in parallel.  A disengaged result holds no
+  // lock.
+  template <class K>
+  [[nodiscard]] const_guarded_reference get(const K& k) const
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    Shard& s = shard_for(k);
+    shared_lock lock(s.m_mutex);
+    if (auto v = as_const(s.m_map).get(k))
+      return { std::move(lock), &*v };
+    return { {}, nullptr };
+  }
+
+  // Return a guarded reference through which the value mapped to `k`, if
+  // any, can be modified.  The shard holding `k` stays locked exclusively
+  // until the result is destroyed, blocking all other access to the shard;
+  // prefer `update` for short modifications.
+  template <class K>
+  [[nodiscard]] guarded_reference get_for_update(const K& k)
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    Shard& s = shard_for(k);
+    unique_lock lock(s.m_mutex);
+    if (auto v = s.m_map.get(k))
+      return { std::move(lock), &*v };
+    return { {}, nullptr };
+  }
+
+  // Return a copy of the value mapped to `k`, or `nullopt`, taking the
+  // shard's lock in shared mode only for the duration of the copy.
+  template <class K>
+  [[nodiscard]] optional<T> get_copy(const K& k) const
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    Shard& s = shard_for(k);
+    shared_lock lock(s.m_mutex);
+    if (auto v = as_const(s.m_map).get(k))
+      return *v;
+    return nullopt;
+  }
+
+  // Return a guarded reference to the value mapped to `k`, first inserting
+  // an element whose value is constructed from `args...` if there is none.
+  template <class K, class... Args>
+  [[nodiscard]] guarded_reference get_or_emplace(K&& k, Args&&... args)
+    requires _IsMapKeyType<Key, Compare, remove_cvref_t<K>>
+  {
+    Shard& s = shard_for(k);
+    unique_lock lock(s.m_mutex);
+    T& v = s.m_map.get_or_emplace(std::forward<K>(k),
+                                  std::forward<Args>(args)...);
+    return { std::move(lock), &v };
+  }
+
+  // Call `f(v)` with the value mapped to `k`, inserting a value constructed
+  // from `args...` first if there is none, and return the result of `f`.
+  // This is the preferred way to update a value: the lock is held only
+  // while `f` runs.
+  template <class K, class F, class... Args>
+  decltype(auto) update(K&& k, F&& f, Args&&... args)
+    requires _IsMapKeyType<Key, Compare, remove_cvref_t<K>>
+  {
+    Shard& s = shard_for(k);
+    lock_guard lock(s.m_mutex);
+    return std::invoke(std::forward<F>(f),
+                       s.m_map.get_or_emplace(std::forward<K>(k),
+                                              std::forward<Args>(args)...));
+  }
+
+  // Insert an element constructed from `k` and `args...` if `k` is not
+  // present, and return whether an element was inserted.
+  template <class... Args>
+  bool try_emplace(const key_type& k, Args&&... args)
+  {
+    Shard& s = shard_for(k);
+    lock_guard lock(s.m_mutex);
+    return s.m_map.try_emplace(k, std::forward<Args>(args)...).second;
+  }
+
+  template <class... Args>
+  bool try_emplace(key_type&& k, Args&&... args)
+  {
+    Shard& s = shard_for(k);
+    lock_guard lock(s.m_mutex);
+    return s.m_map.try_emplace(std::move(k),
+                               std::forward<Args>(args)...).second;
+  }
+
+  // Set the value mapped to `k` to `obj`, inserting it if necessary, and
+  // return whether an element was inserted.
+  template <class K, class M>
+  bool insert_or_assign(K&& k, M&& obj)
+    requires _IsMapKeyType<Key, Compare, remove_cvref_t<K>>
+  {
+    Shard& s = shard_for(k);
+    lock_guard lock(s.m_mutex);
+    bool inserted = false;
+    T& v = s.m_map.get_or_emplace_with(std::forward<K>(k), [&]() -> T {
+      inserted = true;
+      return T(std::forward<M>(obj));
+    });
+    if (! inserted)
+      v = std::forward<M>(obj);
+    return inserted;
+  }
+
+  template <class K>
+  size_type erase(const K& k)
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    Shard& s = shard_for(k);
+    lock_guard lock(s.m_mutex);
+    if constexpr (requires { s.m_map.erase(k); })
+      return s.m_map.erase(k);
+    else
+      return s.m_map.erase(Key(k));
+  }
+
+  template <class K>
+  bool contains(const K& k) const
+    requires _IsMapKeyType<Key, Compare, K>
+  {
+    return bool(get(k));
+  }
+
+  // Return the number of elements.  The shards are counted one at a time, so
+  // the result is exact only if the map is not modified concurrently.
+  size_type size() const
+  {
+    size_type ret = 0;
+    for (size_t i = 0; i <= m_mask; ++i) {
+      shared_lock lock(m_shards[i].m_mutex);
+      ret += m_shards[i].m_map.size();
+    }
+    return ret;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  void clear()
+  {
+    for (size_t i = 0; i <= m_mask; ++i) {
+      lock_guard lock(m_shards[i].m_mutex);
+      m_shards[i].m_map.clear();
+    }
+  }
+
+  // Call `f(k, v)` for each element, one shard at a time, holding each
+  // shard's lock in shared mode while its elements are visited.  Elements
+  // are in key order within a shard, but not across shards.
+  template <class F>
+  void for_each(F&& f) const
+  {
+    for (size_t i = 0; i <= m_mask; ++i) {
+      shared_lock lock(m_shards[i].m_mutex);
+      for (const auto& [k, v] : m_shards[i].m_map)
+        std::invoke(f, k, v);
+    }
+  }
+};
+
+} // close namespace std::experimental
+
+#endif // ! defined(INCLUDED_XSHARDED_MAP)
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
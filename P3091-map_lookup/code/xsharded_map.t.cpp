@@ -0,0 +1,157 @@
+/* xsharded_map.t.cpp                                                 -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Tests for `experimental::sharded_map`
+ */
+
+#include <xsharded_map.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <cassert>
+#include <type_traits>
+
+namespace xstd = std::experimental;
+
+using std::experimental::value_or;
+using std::experimental::reference_or;
+
+// Transparent string hash
+struct StringHash
+{
+  using is_transparent = void;
+
+  std::size_t operator()(std::string_view sv) const
+    { return std::hash<std::string_view>{}(sv); }
+};
+
+using StringMap = xstd::sharded_map<std::string, int, std::less<>, StringHash>;
+
+static_assert(xstd::maybe<StringMap::guarded_reference>);
+static_assert(xstd::maybe<StringMap::const_guarded_reference>);
+
+void testSingleThread()
+{
+  StringMap m({ { "one", 1 }, { "two", 2 } }, 5);
+  const StringMap& M = m;
+  assert(8 == m.shard_count());
+  assert(2 == m.size());
+
+  // `maybe.h` accessors work on the guarded reference.
+  assert(1 == value_or(M.get("one"), 0));
+  assert(0 == value_or(M.get(std::string_view("zero")), 0));
+  assert(2 == M.get_copy("two").value());
+  assert(! M.get_copy("three"));
+
+  // Plain lookups on a non-const map are shared, read-only lookups.
+  static_assert(std::is_same_v<StringMap::const_guarded_reference,
+                               decltype(m.get("one"))>);
+
+  int dummy = 0;
+  ++reference_or(m.get_for_update("one"), dummy);
+  assert(2 == value_or(m.get("one"), 0));
+
+  {
+    auto v = m.get_for_update("two");
+    assert(v && 2 == *v && 2 == v.value());
+    *v = 20;
+    v.reset();  // Releases the lock
+    assert(! v);
+  }
+  assert(20 == value_or(M.get("two"), 0));
+
+  {
+    // A reader holding a guard does not block another reader of the shard.
+    auto v = m.get("two");
+    std::thread reader([&m] { assert(20 == value_or(m.get("two"), 0)); });
+    reader.join();
+  }
+
+  {
+    auto none = m.get_for_update("none");
+    assert(! none.has_value());
+    bool caught = false;
+    try { (void) none.value(); }
+    catch (const std::bad_optional_access&) { caught = true; }
+    assert(caught);
+  }
+
+  // Insertion and update
+  assert(3 == *m.get_or_emplace(std::string_view("three"), 3));
+  assert(3 == *m.get_or_emplace("three", 30));
+  assert(4 == m.update("three", [](int& v) { return ++v; }));
+  assert(1 == m.update("four", [](int& v) { return ++v; }));
+  assert(! m.try_emplace("four", 40));
+  assert(m.insert_or_assign("five", 5));
+  assert(! m.insert_or_assign("five", 50));
+  assert(50 == value_or(M.get("five"), 0));
+  assert(5 == m.size());
+
+  int sum = 0;
+  M.for_each([&](const std::string&, int v) { sum += v; });
+  assert(2 + 20 + 4 + 1 + 50 == sum);
+
+  assert(1 == m.erase("four"));
+  assert(0 == m.erase(std::string_view("four")));
+  assert(! m.contains("four") && m.contains("five"));
+
+  m.clear();
+  assert(m.empty());
+}
+
+// Non-transparent hash: a heterogeneous key is converted to `Key` to select
+// its shard.  Keys are spread across shards.
+void testShards()
+{
+  xstd::sharded_map<int, int> m(16);
+  std::vector<int> perShard(m.shard_count());
+  for (int i = 0; i < 1600; ++i) {
+    m.try_emplace(i * 64, i);
+    ++perShard[m.shard_index(i * 64)];
+  }
+  for (int n : perShard)
+    assert(n > 50);
+  assert(7 == value_or(m.get(long(7 * 64)), -1));
+}
+
+// Concurrent readers and writers: every increment is counted.
+void testConcurrent()
+{
+  xstd::sharded_map<int, long> m(8);
+  constexpr int threads = 4, keys = 100, rounds = 200;
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t)
+    workers.emplace_back([&m, t] {
+      long seen = 0;
+      for (int r = 0; r < rounds; ++r)
+        for (int k = 0; k < keys; ++k) {
+          if ((k + t) % 2)
+            m.update(k, [](long& v) { ++v; });
+          else
+            ++*m.get_or_emplace(k);
+          seen += value_or(std::as_const(m).get((k + 1) % keys), 0L);
+        }
+      assert(seen >= 0);
+    });
+  for (auto& w : workers)
+    w.join();
+
+  assert(keys == long(m.size()));
+  for (int k = 0; k < keys; ++k)
+    assert(threads * rounds == value_or(m.get_copy(k), 0L));
+}
+
+int main()
+{
+  testSingleThread();
+  testShards();
+  testConcurrent();
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -9,6 +9,10 @@ import os
 import subprocess
 import time
 
+# Shared measurement code lives in the repository root
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+from compile_perf import measureCommand
+
 options = (( "P0843R10", "NON_AA" ),
            ( "Option 0", "OPTION_0" ),
            ( "Option 1", "OPTION_1" ),
@@ -72,10 +76,10 @@ for optionName, optionMacro in options:
                            [ f"../{mainSourceFile}" ]).check_returncode()
 
             # Time how long it takes to generate `numCopies` .o files
-            cmdRes = subprocess.run([ "time", "-f", "%U" ] +
-                                    cmdLine + [ "-c" ] + srcfiles,
-                                    capture_output=True, text=True)
-            testTime = float(cmdRes.stderr)
+            cmdRes = measureCommand(cmdLine + [ "-c" ] + srcfiles)
+            if cmdRes.returncode != 0:
+                sys.exit(cmdRes.stderr)
+            testTime = round(cmdRes.userTime, 2)
 
             # Link one .o file to produce a test program and run it
             subprocess.run(cmdLine +
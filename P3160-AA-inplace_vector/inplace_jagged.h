@@ -0,0 +1,457 @@
+// -*- c++ -*-
+
+// `inplace_jagged<T, N, M>`: up to `N` rows, each holding up to `M` elements
+// of `T`, in a single fixed-capacity object.  It replaces
+// `inplace_vector<inplace_vector<T, M>, N>`, in which every inner vector
+// carries its own `size_t` size and padding.  Here, the row sizes are kept in
+// a separate array of the smallest unsigned type that can hold `M`, and the
+// elements are kept in one contiguous `N * M` array, row `i` starting at
+// element `i * M`.  A row is accessed through a lightweight view whose
+// iterators are plain pointers, so scanning a row is a simple loop over
+// contiguous memory.
+//
+// Allocator handling is shared with `inplace_vector` via
+// `__inplace_vector_base`; define the same `NON_AA` or `OPTION_n` macro as
+// for `inplace_vector.h`.  The allocator, if any, is used to construct every
+// element of every row.
+
+#ifndef INCLUDED_INPLACE_JAGGED_DOT_H
+#define INCLUDED_INPLACE_JAGGED_DOT_H
+
+#include <inplace_vector.h>
+#include <compare>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <span>
+
+namespace std::experimental
+{
+
+// Smallest unsigned integral type that can represent every value in the range
+// `[0, Max]`.
+template <size_t Max>
+using __inplace_compact_size_t =
+  conditional_t<Max <= UINT8_MAX,  uint8_t,
+  conditional_t<Max <= UINT16_MAX, uint16_t,
+  conditional_t<Max <= UINT32_MAX, uint32_t, size_t>>>;
+
+// View of one row of an `inplace_jagged`.  Like `span`, a row view is a
+// reference-like object: copying it does not copy elements, and its
+// modifiers are `const` because they modify the referenced row, not the
+// view.  `Owner` is `const` (and `Elem` is `const T`) for a read-only row.
+template <class Owner, class Elem>
+class __inplace_jagged_row
+  : public ranges::view_interface<__inplace_jagged_row<Owner, Elem>>
+{
+  Owner* m_owner = nullptr;
+  size_t m_row   = 0;
+
+  template <class, class> friend class __inplace_jagged_row;
+
+public:
+  using element_type = Elem;
+  using value_type   = remove_cv_t<Elem>;
+  using size_type    = size_t;
+  using iterator     = Elem*;
+
+  constexpr __inplace_jagged_row() noexcept = default;
+  constexpr __inplace_jagged_row(Owner* owner, size_t row) noexcept
+    : m_owner(owner), m_row(row) { }
+
+  // Conversion from a modifiable row to a read-only row.
+  template <class Owner2, class Elem2>
+    requires is_convertible_v<Owner2*, Owner*>
+  constexpr __inplace_jagged_row(const __inplace_jagged_row<Owner2, Elem2>& r)
+    noexcept
+    : m_owner(r.m_owner), m_row(r.m_row) { }
+
+  constexpr Elem* begin() const noexcept { return m_owner->row_begin(m_row); }
+  constexpr Elem* end()   const noexcept { return begin() + size(); }
+
+  constexpr size_type size() const noexcept { return m_owner->m_sizes[m_row]; }
+  static constexpr size_type capacity() noexcept
+    { return Owner::row_capacity(); }
+
+  // Index of this row within its `inplace_jagged`.
+  constexpr size_type index() const noexcept { return m_row; }
+
+  constexpr operator span<Elem>() const noexcept { return { begin(), size() }; }
+
+  // modifiers (modifiable rows only)
+  template <class... Args>
+    requires (! is_const_v<Elem>)
+  constexpr Elem& emplace_back(Args&&... args) const
+  {
+    m_owner->check_row_size(size() + 1);
+    return m_owner->row_unchecked_emplace_back(m_row,
+                                               std::forward<Args>(args)...);
+  }
+  constexpr Elem& push_back(const value_type& x) const
+    requires (! is_const_v<Elem>)
+    { return emplace_back(x); }
+  constexpr Elem& push_back(value_type&& x) const
+    requires (! is_const_v<Elem>)
+    { return emplace_back(std::move(x)); }
+
+  // Append all of `rg`, checking the row capacity once if the size of `rg`
+  // is known up front.
+  template <__container_compatible_range<value_type> R>
+    requires (! is_const_v<Elem>)
+  constexpr void append_range(R&& rg) const
+  {
+    if constexpr (ranges::sized_range<R>) {
+      m_owner->check_row_size(size() + size_type(ranges::size(rg)));
+      for (auto&& elem : rg)
+        m_owner->row_unchecked_emplace_back(m_row,
+                                            std::forward<decltype(elem)>(elem));
+    }
+    else {
+      for (auto&& elem : rg)
+        emplace_back(std::forward<decltype(elem)>(elem));
+    }
+  }
+
+  constexpr void pop_back() const requires (! is_const_v<Elem>)
+    { m_owner->row_pop_back(m_row); }
+  constexpr void clear() const noexcept requires (! is_const_v<Elem>)
+    { m_owner->row_clear(m_row); }
+
+  // Compare the elements (not the identity) of two rows.
+  template <class Owner2, class Elem2>
+  friend constexpr bool operator==(const __inplace_jagged_row& x,
+                                   const __inplace_jagged_row<Owner2, Elem2>& y)
+    { return ranges::equal(x, y); }
+};
+
+// Random-access iterator over the rows of an `inplace_jagged`.  Dereferencing
+// yields a row view by value, so this is a C++20 random-access iterator but
+// only a C++17 input iterator.
+template <class Owner, class Elem>
+class __inplace_jagged_row_iterator
+{
+  Owner*    m_owner = nullptr;
+  ptrdiff_t m_row   = 0;
+
+  template <class, class> friend class __inplace_jagged_row_iterator;
+
+public:
+  using iterator_concept  = random_access_iterator_tag;
+  using iterator_category = input_iterator_tag;
+  using value_type        = __inplace_jagged_row<Owner, Elem>;
+  using reference         = value_type;
+  using difference_type   = ptrdiff_t;
+
+  constexpr __inplace_jagged_row_iterator() noexcept = default;
+  constexpr __inplace_jagged_row_iterator(Owner* owner, ptrdiff_t row) noexcept
+    : m_owner(owner), m_row(row) { }
+
+  // Conversion from `iterator` to `const_iterator`.
+  template <class Owner2, class Elem2>
+    requires is_convertible_v<Owner2*, Owner*>
+  constexpr __inplace_jagged_row_iterator(
+    const __inplace_jagged_row_iterator<Owner2, Elem2>& i) noexcept
+    : m_owner(i.m_owner), m_row(i.m_row) { }
+
+  constexpr reference operator*() const noexcept
+    { return { m_owner, size_t(m_row) }; }
+  constexpr reference operator[](difference_type n) const noexcept
+    { return { m_owner, size_t(m_row + n) }; }
+
+  constexpr __inplace_jagged_row_iterator& operator++() noexcept
+    { ++m_row; return *this; }
+  constexpr __inplace_jagged_row_iterator operator++(int) noexcept
+    { auto ret = *this; ++m_row; return ret; }
+  constexpr __inplace_jagged_row_iterator& operator--() noexcept
+    { --m_row; return *this; }
+  constexpr __inplace_jagged_row_iterator operator--(int) noexcept
+    { auto ret = *this; --m_row; return ret; }
+  constexpr __inplace_jagged_row_iterator& operator+=(difference_type n)
+    noexcept { m_row += n; return *this; }
+  constexpr __inplace_jagged_row_iterator& operator-=(difference_type n)
+    noexcept { m_row -= n; return *this; }
+
+  friend constexpr __inplace_jagged_row_iterator
+  operator+(__inplace_jagged_row_iterator i, difference_type n) noexcept
+    { return i += n; }
+  friend constexpr __inplace_jagged_row_iterator
+  operator+(difference_type n, __inplace_jagged_row_iterator i) noexcept
+    { return i += n; }
+  friend constexpr __inplace_jagged_row_iterator
+  operator-(__inplace_jagged_row_iterator i, difference_type n) noexcept
+    { return i -= n; }
+  friend constexpr difference_type
+  operator-(const __inplace_jagged_row_iterator& x,
+            const __inplace_jagged_row_iterator& y) noexcept
+    { return x.m_row - y.m_row; }
+
+  friend constexpr bool operator==(const __inplace_jagged_row_iterator& x,
+                                   const __inplace_jagged_row_iterator& y)
+    noexcept { return x.m_row == y.m_row; }
+  friend constexpr strong_ordering
+  operator<=>(const __inplace_jagged_row_iterator& x,
+              const __inplace_jagged_row_iterator& y) noexcept
+    { return x.m_row <=> y.m_row; }
+};
+
+#if defined(NON_AA)
+template <class T, size_t N, size_t M>
+class inplace_jagged : public __inplace_vector_base<T>
+{
+  using Base = __inplace_vector_base<T>;
+#elif defined(OPTION_0)
+template <class T, size_t N, size_t M, class Alloc = allocator<T>>
+class inplace_jagged : public __inplace_vector_base<T, Alloc>
+{
+  using Base = __inplace_vector_base<T, Alloc>;
+#elif defined(OPTION_1)
+template <class T, size_t N, size_t M, class Alloc = void>
+class inplace_jagged : public __inplace_vector_base<T, Alloc>
+{
+  using Base = __inplace_vector_base<T, Alloc>;
+#elif defined(OPTION_2)
+template <class T, size_t N, size_t M>
+class inplace_jagged :
+    public __inplace_vector_base<T, typename __deduced_alloc<T>::type>
+{
+  using Base = __inplace_vector_base<T, typename __deduced_alloc<T>::type>;
+#elif defined(OPTION_3)
+template <class T, size_t N, size_t M,
+          class Alloc = typename __deduced_alloc<T>::type>
+class inplace_jagged : public __inplace_vector_base<T, Alloc>
+{
+  using Base = __inplace_vector_base<T, Alloc>;
+#endif
+
+  using AllocArg    = typename Base::AllocArg;
+  using AllocTraits = typename Base::AllocTraits;
+
+  using ArrayType = array<T, N * M>;
+  using RowSize   = __inplace_compact_size_t<M>;
+  using RowCount  = __inplace_compact_size_t<N>;
+
+  // Element storage, as for `inplace_vector`: uninitialized at run time, and
+  // value-initialized during constant evaluation if `T` permits.
+  static constexpr bool __constant_storage =
+    is_default_constructible_v<T> && is_trivially_destructible_v<T>;
+
+  union Data {
+    ArrayType value;
+
+    constexpr Data()
+    {
+      if consteval {
+        if constexpr (__constant_storage)
+          std::construct_at(&value);
+      }
+    }
+    constexpr ~Data() requires is_trivially_destructible_v<T> = default;
+    constexpr ~Data() { }
+  };
+
+  Data                m_data;
+  array<RowSize, N>   m_sizes{};
+  RowCount            m_rows = 0;
+
+  friend class __inplace_jagged_row<inplace_jagged, T>;
+  friend class __inplace_jagged_row<const inplace_jagged, const T>;
+
+  static constexpr void check_row_size(size_t n)
+    { if (n > M) [[unlikely]] __inplace_vector_throw_bad_alloc(); }
+
+  static constexpr void destroy_elem(T& elem)
+  {
+    if constexpr (! is_trivially_destructible_v<T>)
+      std::destroy_at(std::addressof(elem));
+  }
+
+  constexpr T*       row_begin(size_t r) noexcept
+    { return m_data.value.data() + r * M; }
+  constexpr const T* row_begin(size_t r) const noexcept
+    { return m_data.value.data() + r * M; }
+
+  template <class... Args>
+  constexpr T& row_unchecked_emplace_back(size_t r, Args&&... args)
+  {
+    T* elem = row_begin(r) + m_sizes[r];
+#ifdef NON_AA
+    construct_at(elem, std::forward<Args>(args)...);
+#else
+    this->construct_elem(elem, std::forward<Args>(args)...);
+#endif
+    ++m_sizes[r];
+    return *elem;
+  }
+
+  constexpr void row_pop_back(size_t r)
+    { destroy_elem(row_begin(r)[--m_sizes[r]]); }
+
+  constexpr void row_clear(size_t r) noexcept
+  {
+    if constexpr (! is_trivially_destructible_v<T>)
+      std::destroy(row_begin(r), row_begin(r) + m_sizes[r]);
+    m_sizes[r] = 0;
+  }
+
+public:
+  // types:
+  using element_type        = T;
+  using size_type           = size_t;
+  using difference_type     = ptrdiff_t;
+  using row_size_type       = RowSize;
+  using reference           = __inplace_jagged_row<inplace_jagged, T>;
+  using const_reference     = __inplace_jagged_row<const inplace_jagged,
+                                                   const T>;
+  using iterator            = __inplace_jagged_row_iterator<inplace_jagged, T>;
+  using const_iterator      =
+    __inplace_jagged_row_iterator<const inplace_jagged, const T>;
+
+  // construct/copy/destroy
+  constexpr inplace_jagged() noexcept = default;
+  constexpr explicit inplace_jagged(const type_identity_t<AllocArg>& a) noexcept
+    : Base(a) { }
+
+  constexpr inplace_jagged(initializer_list<initializer_list<T>> il)
+  {
+    if (il.size() > N) [[unlikely]] __inplace_vector_throw_bad_alloc();
+    for (auto& row : il)
+      push_back(row);
+  }
+
+  constexpr inplace_jagged(const inplace_jagged& rhs)
+    : Base(AllocTraits::select_on_container_copy_construction(rhs.get_allocator()))
+    { *this = rhs; }
+  constexpr inplace_jagged(const inplace_jagged& rhs,
+                           const type_identity_t<AllocArg>& a) : Base(a)
+    { *this = rhs; }
+  constexpr inplace_jagged(inplace_jagged&& rhs)
+    noexcept(N == 0 || M == 0 ||
+             __is_nothrow_ua_constructible_v<T, AllocArg, T&&>)
+    : Base(rhs.get_allocator()) { *this = std::move(rhs); }
+  constexpr inplace_jagged(inplace_jagged&& rhs,
+                           const type_identity_t<AllocArg>& a)
+    noexcept(N == 0 || M == 0 ||
+             __is_nothrow_ua_constructible_v<T, AllocArg, T&&>)
+    : Base(a) { *this = std::move(rhs); }
+
+  constexpr ~inplace_jagged() requires is_trivially_destructible_v<T> = default;
+  constexpr ~inplace_jagged() { clear(); }
+
+  constexpr inplace_jagged& operator=(const inplace_jagged& other)
+  {
+    if (this != &other) {
+      clear();
+      for (const_reference row : other)
+        append_row(row);
+    }
+    return *this;
+  }
+
+  constexpr inplace_jagged& operator=(inplace_jagged&& other)
+  {
+    if (this != &other) {
+      clear();
+      for (reference row : other) {
+        reference dst = emplace_row();
+        for (T& elem : row)
+          row_unchecked_emplace_back(dst.index(), std::move(elem));
+      }
+    }
+    return *this;
+  }
+
+  // iterators (over rows)
+  constexpr iterator       begin()        noexcept { return { this, 0 }; }
+  constexpr const_iterator begin()  const noexcept { return { this, 0 }; }
+  constexpr iterator       end()          noexcept { return { this, m_rows }; }
+  constexpr const_iterator end()    const noexcept { return { this, m_rows }; }
+  constexpr const_iterator cbegin() const noexcept { return begin(); }
+  constexpr const_iterator cend()   const noexcept { return end(); }
+
+  // size/capacity
+  [[nodiscard]] constexpr bool empty() const noexcept { return m_rows == 0; }
+  constexpr size_type size() const noexcept { return m_rows; }
+  static constexpr size_type max_size() noexcept { return N; }
+  static constexpr size_type capacity() noexcept { return N; }
+  static constexpr size_type row_capacity() noexcept { return M; }
+
+  // Sizes of all rows, in order, without touching the element storage.
+  constexpr span<const row_size_type> row_sizes() const noexcept
+    { return { m_sizes.data(), m_rows }; }
+
+  // Total number of elements in all rows.
+  constexpr size_type element_count() const noexcept
+  {
+    size_type n = 0;
+    for (row_size_type s : row_sizes())
+      n += s;
+    return n;
+  }
+
+  // row access
+  constexpr reference       operator[](size_type r) { return { this, r }; }
+  constexpr const_reference operator[](size_type r) const { return { this, r }; }
+  constexpr reference at(size_type r)
+  {
+    if (r >= m_rows) [[unlikely]] __inplace_vector_throw_out_of_range();
+    return { this, r };
+  }
+  constexpr const_reference at(size_type r) const
+  {
+    if (r >= m_rows) [[unlikely]] __inplace_vector_throw_out_of_range();
+    return { this, r };
+  }
+  constexpr reference       front()       { return { this, 0 }; }
+  constexpr const_reference front() const { return { this, 0 }; }
+  constexpr reference       back()        { return { this, m_rows - 1u }; }
+  constexpr const_reference back()  const { return { this, m_rows - 1u }; }
+
+  // modifiers
+
+  // Append an empty row and return a view of it.
+  constexpr reference emplace_row()
+  {
+    if (m_rows == N) [[unlikely]] __inplace_vector_throw_bad_alloc();
+    m_sizes[m_rows] = 0;
+    return { this, m_rows++ };
+  }
+
+  // Append a row holding the elements of `rg` and return a view of it.  If
+  // the size of `rg` is known up front and is too large, no row is appended.
+  template <__container_compatible_range<T> R>
+  constexpr reference append_row(R&& rg)
+  {
+    if constexpr (ranges::sized_range<R>)
+      check_row_size(size_type(ranges::size(rg)));
+    reference row = emplace_row();
+    row.append_range(std::forward<R>(rg));
+    return row;
+  }
+  constexpr reference push_back(initializer_list<T> il)
+    { return append_row(il); }
+
+  constexpr void pop_back() { row_clear(--m_rows); }
+
+  constexpr void clear() noexcept
+  {
+    while (m_rows)
+      row_clear(--m_rows);
+  }
+
+  friend constexpr bool operator==(const inplace_jagged& x,
+                                   const inplace_jagged& y)
+  {
+    return ranges::equal(x.row_sizes(), y.row_sizes()) &&
+      ranges::equal(x, y, [](const_reference a, const_reference b) {
+        return ranges::equal(a, b);
+      });
+  }
+};
+
+}  // close namespace std::experimental
+
+#endif // ! defined(INCLUDED_INPLACE_JAGGED_DOT_H)
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,173 @@
+/* inplace_jagged.t.cpp                                               -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Test `inplace_jagged`, the flattened replacement for
+ * `inplace_vector<inplace_vector<T, M>, N>`.  Build with each of `NON_AA`,
+ * `OPTION_0`, ... `OPTION_3` defined to test each allocator option.
+ */
+
+#include <inplace_jagged.h>
+#include <memory_resource>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <cassert>
+
+namespace xstd = std::experimental;
+
+using IntJagged = xstd::inplace_jagged<int, 4, 5>;
+
+// Layout: the row sizes are stored compactly, apart from the elements.
+static_assert(std::is_same_v<IntJagged::row_size_type, std::uint8_t>);
+static_assert(std::is_same_v<xstd::inplace_jagged<int, 2, 300>::row_size_type,
+                             std::uint16_t>);
+static_assert(2 * sizeof(xstd::inplace_jagged<char, 8, 6>) <=
+              sizeof(xstd::inplace_vector<xstd::inplace_vector<char, 6>, 8>));
+
+// Rows are contiguous ranges; the container is a random-access range of rows.
+static_assert(std::ranges::random_access_range<IntJagged>);
+static_assert(std::ranges::random_access_range<const IntJagged>);
+static_assert(std::ranges::contiguous_range<IntJagged::reference>);
+static_assert(std::ranges::contiguous_range<IntJagged::const_reference>);
+static_assert(std::is_trivially_destructible_v<IntJagged>);
+static_assert(! std::is_trivially_destructible_v<
+                xstd::inplace_jagged<std::string, 2, 2>>);
+
+constexpr bool testModifiers()
+{
+  IntJagged j{ { 1, 2 }, { }, { 3, 4, 5 } };
+  if (j.size() != 3 || j.element_count() != 5) return false;
+  if (j[0].size() != 2 || ! j[1].empty() || j[2].back() != 5) return false;
+
+  j[1].push_back(9);                      // { 1 2 } { 9 } { 3 4 5 }
+  j[1].emplace_back(8);                   // { 1 2 } { 9 8 } { 3 4 5 }
+  j.back().pop_back();                    // { 1 2 } { 9 8 } { 3 4 }
+  auto row = j.emplace_row();             // { 1 2 } { 9 8 } { 3 4 } { }
+  int more[] = { 6, 7, 8, 9, 10 };
+  row.append_range(more);                 // ... { 6 7 8 9 10 }
+  if (row.size() != j.row_capacity() || row.index() != 3) return false;
+
+  const auto sizes = j.row_sizes();
+  if (sizes.size() != 4 || sizes[0] != 2 || sizes[3] != 5) return false;
+
+  // Row `i` starts at element `i * M` of one contiguous array.
+  if (j[1].data() != j[0].data() + j.row_capacity()) return false;
+
+  IntJagged k = j;
+  if (k != j) return false;
+  k[0][1] = 0;
+  if (k == j || k[0] == j[0] || k[1] != j[1]) return false;
+
+  j.pop_back();
+  j[0].clear();
+  if (j != IntJagged{ { }, { 9, 8 }, { 3, 4 } }) return false;
+
+  k = std::move(j);
+  if (k != IntJagged{ { }, { 9, 8 }, { 3, 4 } }) return false;
+
+  int sum = 0;
+  for (auto r : std::as_const(k))
+    sum = std::accumulate(r.begin(), r.end(), sum);
+  if (sum != 24) return false;
+
+  k.clear();
+  return k.empty();
+}
+static_assert(testModifiers());
+
+constexpr bool testStrings()
+{
+  xstd::inplace_jagged<std::string, 3, 2> j{ { "a", "bc" }, { "def" } };
+  j[1].push_back("ghij");
+  auto copy = j;
+  copy.pop_back();
+  return copy.size() == 1 && j[1][1] == "ghij" && copy[0][1] == "bc";
+}
+static_assert(testStrings());
+
+// A table built at compile time: row `i` holds the divisors of `i + 1`.
+constexpr auto divisors = [] {
+  xstd::inplace_jagged<int, 12, 6> ret;
+  for (int n = 1; n <= 12; ++n) {
+    auto row = ret.emplace_row();
+    for (int d = 1; d <= n; ++d)
+      if (n % d == 0)
+        row.push_back(d);
+  }
+  return ret;
+}();
+static_assert(divisors.size() == 12);
+static_assert(std::ranges::equal(divisors[11],
+                                 std::array{ 1, 2, 3, 4, 6, 12 }));
+static_assert(divisors[6].size() == 2);
+
+void testErrors()
+{
+  IntJagged j;
+  auto row = j.emplace_row();
+  row.append_range(std::views::iota(0, 5));
+
+  bool caught = false;
+  try { row.push_back(5); }
+  catch (const std::bad_alloc&) { caught = true; }
+  assert(caught && row.size() == 5);
+
+  // A sized range that does not fit is rejected before any element is added.
+  caught = false;
+  try { j.append_row(std::views::iota(0, 6)); }
+  catch (const std::bad_alloc&) { caught = true; }
+  assert(caught && j.size() == 1);
+
+  while (j.size() < j.capacity())
+    j.emplace_row();
+  caught = false;
+  try { j.emplace_row(); }
+  catch (const std::bad_alloc&) { caught = true; }
+  assert(caught && j.size() == j.capacity());
+
+  caught = false;
+  try { j.at(j.size()); }
+  catch (const std::out_of_range&) { caught = true; }
+  assert(caught);
+}
+
+#ifndef NON_AA
+// Every element of every row is constructed using the container's allocator.
+void testAllocator()
+{
+  using Alloc = std::pmr::polymorphic_allocator<std::pmr::string>;
+# ifdef OPTION_2
+  using Jagged = xstd::inplace_jagged<std::pmr::string, 3, 4>;
+# else
+  using Jagged = xstd::inplace_jagged<std::pmr::string, 3, 4, Alloc>;
+# endif
+
+  std::pmr::monotonic_buffer_resource pool;
+  Jagged j(&pool);
+  j.push_back({ "a string long enough to need an allocation", "b" });
+  j.emplace_row().emplace_back("c");
+  for (auto row : j)
+    for (auto& s : row)
+      assert(s.get_allocator().resource() == &pool);
+
+  Jagged copy(j, Alloc{});
+  assert(copy == j);
+  for (auto row : copy)
+    for (auto& s : row)
+      assert(s.get_allocator().resource() == std::pmr::get_default_resource());
+}
+#endif
+
+int main()
+{
+  testErrors();
+#ifndef NON_AA
+  testAllocator();
+#endif
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,264 @@
+/* inplace_vector.b.cpp                                               -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Run-time benchmark for the allocator options of `inplace_vector`.  Build
+ * once for each of `NON_AA`, `OPTION_0`, ... `OPTION_3` (see `make bench`);
+ * each build prints one markdown table row per (element type, operation) with
+ * the best-of-`reps` time in nanoseconds per element.  For `int` elements,
+ * every option should produce identical times, as the allocator machinery is
+ * compiled away.  For `pmr::string` elements, the allocator-aware options
+ * construct elements from the vector's allocator, whereas `NON_AA` must pass
+ * the allocator to every element explicitly.
+ */
+
+#include <inplace_vector.h>
+#include <memory_resource>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+
+namespace xstd = std::experimental;
+namespace chrono = std::chrono;
+
+#if defined(NON_AA)
+const char optionName[] = "NON_AA";
+#elif defined(OPTION_0)
+const char optionName[] = "OPTION_0";
+#elif defined(OPTION_1)
+const char optionName[] = "OPTION_1";
+#elif defined(OPTION_2)
+const char optionName[] = "OPTION_2";
+#elif defined(OPTION_3)
+const char optionName[] = "OPTION_3";
+#endif
+
+constexpr std::size_t capacity = 64;
+
+// `Vec<T>` is the `inplace_vector` that an application would use for `T`
+// under the selected option: allocator-aware element types get a
+// `pmr::polymorphic_allocator` wherever the option allows one to be named.
+#if defined(NON_AA) || defined(OPTION_2)
+template <class T> using Vec = xstd::inplace_vector<T, capacity>;
+#else
+template <class T>
+using VecAlloc = std::conditional_t<
+  std::uses_allocator_v<T, std::pmr::polymorphic_allocator<T>>,
+  std::pmr::polymorphic_allocator<T>,
+# if defined(OPTION_0)
+  std::allocator<T>
+# elif defined(OPTION_1)
+  void
+# else
+  typename xstd::__deduced_alloc<T>::type
+# endif
+  >;
+template <class T> using Vec = xstd::inplace_vector<T, capacity, VecAlloc<T>>;
+#endif
+
+// Prevent the optimizer from discarding the computation of `*p`.
+template <class T>
+inline void doNotOptimize(T* p)
+{
+  asm volatile("" : : "g"(p) : "memory");
+}
+
+int reps = 200;
+
+// Invoke `f()` `reps` times and print the best time, divided by `elements`,
+// the number of elements processed by each call.  `setup()`, if supplied, is
+// invoked untimed before each call to `f()`.
+template <class Setup, class F>
+void measure(const char* typeName, const char* opName, std::size_t elements,
+             Setup&& setup, F&& f)
+{
+  auto best = chrono::nanoseconds::max();
+  for (int r = 0; r < reps; ++r) {
+    setup();
+    auto start = chrono::steady_clock::now();
+    f();
+    auto elapsed = chrono::steady_clock::now() - start;
+    best = std::min(best, chrono::duration_cast<chrono::nanoseconds>(elapsed));
+  }
+
+  std::cout << "| " << optionName << " | " << typeName << " | " << opName
+            << " | " << double(best.count()) / elements << " |" << std::endl;
+}
+
+template <class F>
+void measure(const char* typeName, const char* opName, std::size_t elements,
+             F&& f)
+{
+  measure(typeName, opName, elements, []{ }, std::forward<F>(f));
+}
+
+// Storage for vectors constructed and destroyed explicitly, so that the
+// construction, copy, move, and destruction can be timed separately.
+template <class V>
+struct Slot
+{
+  alignas(V) unsigned char m_buf[sizeof(V)];
+  V* get() { return reinterpret_cast<V*>(m_buf); }
+};
+
+constexpr int         numVecs  = 16;
+constexpr std::size_t allElems = numVecs * capacity;
+
+void benchInt()
+{
+  using V = Vec<int>;
+  Slot<V> slots[numVecs], copies[numVecs];
+
+  measure("int", "push_back", allElems, [&]{
+    for (auto& s : slots) {
+      V* v = ::new (s.m_buf) V;
+      for (std::size_t i = 0; i < capacity; ++i)
+        v->push_back(int(i));
+      doNotOptimize(v);
+      v->~V();
+    }
+  });
+
+  for (auto& s : slots) {
+    V* v = ::new (s.m_buf) V;
+    for (std::size_t i = 0; i < capacity; ++i)
+      v->push_back(int(i));
+  }
+
+  measure("int", "copy construct", allElems, [&]{
+    for (int n = 0; n < numVecs; ++n) {
+      V* c = ::new (copies[n].m_buf) V(*slots[n].get());
+      doNotOptimize(c);
+      c->~V();
+    }
+  });
+
+  measure("int", "move construct", allElems, [&]{
+    for (int n = 0; n < numVecs; ++n) {
+      V* c = ::new (copies[n].m_buf) V(std::move(*slots[n].get()));
+      doNotOptimize(c);
+      c->~V();
+    }
+  });
+
+  for (auto& s : slots) s.get()->~V();
+
+  measure("int", "emplace (front)", allElems / 2, [&]{
+    for (auto& s : slots) {
+      V* v = ::new (s.m_buf) V;
+      for (std::size_t i = 0; i < capacity / 2; ++i)
+        v->emplace(v->begin(), int(i));
+      doNotOptimize(v);
+      v->~V();
+    }
+  });
+}
+
+void benchString()
+{
+  using V = Vec<std::pmr::string>;
+
+  // Strings long enough to require an allocation from the pool
+  const char value[] = "a string that is too long for the small buffer";
+
+  std::pmr::unsynchronized_pool_resource pool;
+  Slot<V> slots[numVecs], copies[numVecs];
+
+  auto makeVec = [&](Slot<V>& s) -> V* {
+#ifdef NON_AA
+    return ::new (s.m_buf) V;
+#else
+    return ::new (s.m_buf) V(&pool);
+#endif
+  };
+
+  // Append `n` elements to `v`, constructed using the pool.
+  auto fill = [&](V* v, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+#ifdef NON_AA
+      v->emplace_back(value, &pool);          // allocator passed explicitly
+#else
+      v->emplace_back(value);                 // uses-allocator construction
+#endif
+    }
+  };
+
+  measure("pmr::string", "push_back", allElems, [&]{
+    for (auto& s : slots) {
+      V* v = makeVec(s);
+      fill(v, capacity);
+      doNotOptimize(v);
+      v->~V();
+    }
+  });
+
+  for (auto& s : slots) fill(makeVec(s), capacity);
+
+  measure("pmr::string", "copy construct", allElems, [&]{
+    for (int n = 0; n < numVecs; ++n) {
+      V* c = ::new (copies[n].m_buf) V(*slots[n].get());
+      doNotOptimize(c);
+      c->~V();
+    }
+  });
+
+  // Moving leaves the source strings empty, so refill them before each
+  // repetition.
+  auto refill = [&]{
+    for (auto& s : slots) {
+      s.get()->~V();
+      fill(makeVec(s), capacity);
+    }
+  };
+  measure("pmr::string", "move construct", allElems, refill, [&]{
+    for (int n = 0; n < numVecs; ++n) {
+      V* c = ::new (copies[n].m_buf) V(std::move(*slots[n].get()));
+      doNotOptimize(c);
+      c->~V();
+    }
+  });
+
+  for (auto& s : slots) s.get()->~V();
+
+  measure("pmr::string", "emplace (front)", allElems / 2, [&]{
+    for (auto& s : slots) {
+      V* v = makeVec(s);
+      for (std::size_t i = 0; i < capacity / 2; ++i) {
+#ifdef NON_AA
+        v->emplace(v->begin(), value, &pool);
+#else
+        v->emplace(v->begin(), value);
+#endif
+      }
+      doNotOptimize(v);
+      v->~V();
+    }
+  });
+
+  // Time destruction separately from construction.
+  auto best = chrono::nanoseconds::max();
+  for (int r = 0; r < reps; ++r) {
+    for (auto& s : slots) fill(makeVec(s), capacity);
+    auto start = chrono::steady_clock::now();
+    for (auto& s : slots) s.get()->~V();
+    auto elapsed = chrono::steady_clock::now() - start;
+    best = std::min(best, chrono::duration_cast<chrono::nanoseconds>(elapsed));
+  }
+  std::cout << "| " << optionName << " | pmr::string | destroy | "
+            << double(best.count()) / allElems << " |" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1)
+    reps = std::atoi(argv[1]);
+
+  benchInt();
+  benchString();
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -7,9 +7,17 @@
 // OPTION_2: inplace_vector<class T, size_t N>  (allocator is deduced)
 // OPTION_3: inplace_vector<class T, size_t N, class Alloc = deduced>
 
+#ifndef INCLUDED_INPLACE_VECTOR_DOT_H
+#define INCLUDED_INPLACE_VECTOR_DOT_H
+
+#include <algorithm>
 #include <array>
+#include <compare>
 #include <type_traits>
 #include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <cstdlib>
 
 #ifdef VERBOSE
 #include <iostream>
@@ -40,16 +48,18 @@ namespace std::experimental
 {
 
 // exposition only trait `is-nothrow-ua-constructible-v`
+template <class T, class ArgsTuple>
+struct ____is_nothrow_constructible_from_tuple;
+
 template <class T, class... Y>
-consteval bool ____is_nothrow_ua_constructible_check(tuple<Y...>&&)
-{
-  return is_nothrow_constructible_v<T, Y...>;
-}
+struct ____is_nothrow_constructible_from_tuple<T, tuple<Y...>>
+  : bool_constant<is_nothrow_constructible_v<T, Y...>> { };
 
 template <class T, class A, class... X>
 constexpr bool __is_nothrow_ua_constructible_v =
-  ____is_nothrow_ua_constructible_check<T>(
-    uses_allocator_construction_args<T>(declval<const A&>(), declval<X>()...));
+  ____is_nothrow_constructible_from_tuple<T,
+    decltype(uses_allocator_construction_args<T>(declval<const A&>(),
+                                                 declval<X>()...))>::value;
 
 // non-allocator that meets the allocator requirements
 template <class T>
@@ -181,6 +191,9 @@ protected:
   template <class... Args>
   constexpr void construct_elem(T* elem, Args&&... args)
     { construct_at(elem, std::forward<Args>(args)...); }
+
+  // Used only for uniform handling of copy construction.
+  constexpr AllocArg get_allocator() const { return {}; }
 };
 
 #elif defined(OPTION_2)  // `allocator_type` exists only if `T::allocator_type`
@@ -251,6 +264,9 @@ protected:
   template <class... Args>
   constexpr void construct_elem(T* elem, Args&&... args)
     { construct_at(elem, std::forward<Args>(args)...); }
+
+  // Used only for uniform handling of copy construction.
+  constexpr AllocArg get_allocator() const { return {}; }
 };
 
 #elif defined(OPTION_3) // Default allocator is `T::allocator_type`
@@ -321,12 +337,38 @@ public:
   constexpr allocator<T> get_allocator() const { return {}; }
 };
 
+// Specialization for `void` allocator (`T` is not allocator-aware)
+template <class T>
+class __inplace_vector_base<T, void>
+{
+protected:
+  using AllocArg    = __non_allocator<T>;
+  using AllocTraits = allocator_traits<AllocArg>;
+
+#if VERBOSE
+  __inplace_vector_base() { std::cout << "Option 3 no allocator\n"; }
+  explicit __inplace_vector_base(const AllocArg&)
+    { std::cout << "Option 3 no allocator\n"; }
+#else
+  constexpr __inplace_vector_base() = default;
+  constexpr explicit __inplace_vector_base(const AllocArg&) { }
+#endif
+
+  template <class... Args>
+  constexpr void construct_elem(T* elem, Args&&... args)
+    { construct_at(elem, std::forward<Args>(args)...); }
+
+  // Used only for uniform handling of copy construction.
+  constexpr AllocArg get_allocator() const { return {}; }
+};
+
 #else // if non-AA `inplace_vector`
 
 # if ! defined(NON_AA)
 #  define NON_AA
 # endif
 
+template <class T>
 class __inplace_vector_base
 {
 protected:
@@ -335,25 +377,62 @@ protected:
 
 #if VERBOSE
   __inplace_vector_base() { std::cout << "Non-AA `inplace_vector`\n"; }
+  explicit __inplace_vector_base(const AllocArg&)
+    { std::cout << "Non-AA `inplace_vector`\n"; }
+#else
+  constexpr __inplace_vector_base() = default;
+  constexpr explicit __inplace_vector_base(const AllocArg&) { }
 #endif
+
+  // Used only for uniform handling of copy construction.
+  constexpr AllocArg get_allocator() const { return {}; }
 };
 
 #endif // NON_AA
 
-template <class Tp>
-union __uninitialized
+#if ! __cpp_lib_containers_ranges
+// Disambiguation tag for construction from a range (C++23)
+struct from_range_t { explicit from_range_t() = default; };
+inline constexpr from_range_t from_range{};
+#else
+using std::from_range_t;
+using std::from_range;
+#endif
+
+// Exposition-only concept `container-compatible-range`
+template <class R, class T>
+concept __container_compatible_range =
+  ranges::input_range<R> && convertible_to<ranges::range_reference_t<R>, T>;
+
+// Capacity and range errors are reported out of line so that the inlined fast
+// paths contain only a compare and a branch.  When exceptions are disabled
+// (e.g., `-fno-exceptions`), these errors abort instead.  In a constant
+// expression, reaching either function is a compile-time error.
+[[noreturn, gnu::cold, gnu::noinline]]
+inline void __inplace_vector_throw_bad_alloc()
 {
-  char trivial;
-  Tp   object;
+#if __cpp_exceptions
+  throw bad_alloc{};
+#else
+  std::abort();
+#endif
+}
 
-  constexpr __uninitialized() {}
-};
+[[noreturn, gnu::cold, gnu::noinline]]
+inline void __inplace_vector_throw_out_of_range()
+{
+#if __cpp_exceptions
+  throw out_of_range("inplace_vector::at");
+#else
+  std::abort();
+#endif
+}
 
 #if defined(NON_AA)
 template <class T, size_t N>
-class inplace_vector : public __inplace_vector_base
+class inplace_vector : public __inplace_vector_base<T>
 {
-  using Base = __inplace_vector_base;
+  using Base = __inplace_vector_base<T>;
 #elif defined(OPTION_0)
 template <class T, size_t N, class Alloc = allocator<T>>
 class inplace_vector : public __inplace_vector_base<T, Alloc>
@@ -382,18 +461,41 @@ class inplace_vector : public __inplace_vector_base<T, Alloc>
 
   using ArrayType = array<T, N>;
 
+  // Element storage.  At run time, the array is left uninitialized.  During
+  // constant evaluation, the array is value-initialized if `T` permits, so
+  // that every element is a constant and an `inplace_vector` can be the value
+  // of a `constexpr` variable.  Other element types are still usable in
+  // (transient) constant evaluation.
+  static constexpr bool __constant_storage =
+    is_default_constructible_v<T> && is_trivially_destructible_v<T>;
+
   union Data {
-    array<__uninitialized<T>, N> raw_mem;
-    ArrayType                    value;
+    ArrayType value;
 
-    constexpr Data() { }
+    constexpr Data()
+    {
+      if consteval {
+        if constexpr (__constant_storage)
+          std::construct_at(&value);
+      }
+    }
+    constexpr ~Data() requires is_trivially_destructible_v<T> = default;
     constexpr ~Data() { }
   };
 
   Data   m_data;
   size_t m_size = 0;
 
-  static constexpr void check_size(size_t n) { if (n > N) throw bad_alloc{}; }
+  static constexpr void check_size(size_t n)
+    { if (n > N) [[unlikely]] __inplace_vector_throw_bad_alloc(); }
+
+  // Trivially destructible elements are never destroyed, so that, during
+  // constant evaluation, the storage never contains dead objects.
+  static constexpr void destroy_elem(T& elem)
+  {
+    if constexpr (! is_trivially_destructible_v<T>)
+      std::destroy_at(std::addressof(elem));
+  }
 
 public:
   // types:
@@ -411,6 +513,8 @@ public:
 
   // [containers.sequences.inplace.vector.cons], construct/copy/destroy
   constexpr inplace_vector() noexcept = default;
+  constexpr explicit inplace_vector(const type_identity_t<AllocArg>& a) noexcept
+    : Base(a) { }
 
   constexpr explicit inplace_vector(size_type n)
   {
@@ -419,11 +523,13 @@ public:
       unchecked_emplace_back();
   }
 
-  constexpr inplace_vector(size_type n, const T& value);
-  template <class InputIterator>
-  constexpr inplace_vector(InputIterator first, InputIterator last);
-  // template <container-compatible-range<T> R>
-  // constexpr inplace_vector(from_range_t, R&& rg);
+  constexpr inplace_vector(size_type n, const T& value) { assign(n, value); }
+  template <input_iterator InputIterator>
+  constexpr inplace_vector(InputIterator first, InputIterator last)
+    { assign(first, last); }
+  template <__container_compatible_range<T> R>
+  constexpr inplace_vector(from_range_t, R&& rg)
+    { append_range(std::forward<R>(rg)); }
   constexpr inplace_vector(const inplace_vector& rhs)
     : Base(AllocTraits::select_on_container_copy_construction(rhs.get_allocator()))
     { *this = rhs; };
@@ -431,14 +537,15 @@ public:
                            const type_identity_t<AllocArg>& a) : Base(a)
     { *this = rhs; };
   constexpr inplace_vector(inplace_vector&& rhs)
-    noexcept(N == 0 || __is_nothrow_ua_constructible_v<T, Alloc, T&&>)
+    noexcept(N == 0 || __is_nothrow_ua_constructible_v<T, AllocArg, T&&>)
     : Base(rhs.get_allocator()) { *this = std::move(rhs); };
   constexpr inplace_vector(inplace_vector&& rhs,
                            const type_identity_t<AllocArg>& a)
-    noexcept(N == 0 || __is_nothrow_ua_constructible_v<T, Alloc, T&&>)
+    noexcept(N == 0 || __is_nothrow_ua_constructible_v<T, AllocArg, T&&>)
     : Base(a) { *this = std::move(rhs); };
-  constexpr inplace_vector(initializer_list<T> il);
+  constexpr inplace_vector(initializer_list<T> il) { assign(il); }
 
+  constexpr ~inplace_vector() requires is_trivially_destructible_v<T> = default;
   constexpr ~inplace_vector() { this->clear(); }
 
   constexpr inplace_vector& operator=(const inplace_vector& other)
@@ -467,16 +574,16 @@ public:
   }
 
   constexpr inplace_vector& operator=(initializer_list<T> il)
-    { check_size(il.size()); for (const T& elem : il) unchecked_push_back(elem); }
+    { assign(il.begin(), il.end()); return *this; }
 
-  template <class InputIterator>
+  template <input_iterator InputIterator>
   constexpr void assign(InputIterator first, InputIterator last)
-    { while (first != last) push_back(*first++); }
+    { clear(); while (first != last) emplace_back(*first++); }
 
   // template<container-compatible-range<T> R>
   // constexpr void assign_range(R&& rg);
   constexpr void assign(size_type n, const T& u)
-    { check_size(n); while (n--) unchecked_push_back(u); }
+    { check_size(n); clear(); while (n--) unchecked_push_back(u); }
   constexpr void assign(initializer_list<T> il) { *this = il; }
 
   // iterators
@@ -521,44 +628,79 @@ public:
   constexpr reference       operator[](size_type n) { return m_data.value[n]; }
   constexpr const_reference operator[](size_type n) const
     { return m_data.value[n]; }
-  constexpr const_reference at(size_type n) const;
-  constexpr reference       at(size_type n);
+  constexpr const_reference at(size_type n) const
+  {
+    if (n >= m_size) [[unlikely]] __inplace_vector_throw_out_of_range();
+    return m_data.value[n];
+  }
+  constexpr reference       at(size_type n)
+  {
+    if (n >= m_size) [[unlikely]] __inplace_vector_throw_out_of_range();
+    return m_data.value[n];
+  }
   constexpr reference       front()       { return m_data.value[0]; }
   constexpr const_reference front() const { return m_data.value[0]; }
   constexpr reference       back()       { return m_data.value[m_size - 1]; }
   constexpr const_reference back() const { return m_data.value[m_size - 1]; }
 
   // [containers.sequences.inplace.vector.data], data access
-  constexpr       T* data()       noexcept;
-  constexpr const T* data() const noexcept;
+  constexpr       T* data()       noexcept { return m_data.value.data(); }
+  constexpr const T* data() const noexcept { return m_data.value.data(); }
 
   // [containers.sequences.inplace.vector.modifiers], modifiers
   template <class... Args> constexpr T& emplace_back(Args&&... args)
   {
     check_size(m_size + 1);
-#ifdef NON_AA
-    construct_at(&m_data.value[m_size], std::forward<Args>(args)...);
-#else
-    this->construct_elem(&m_data.value[m_size], std::forward<Args>(args)...);
-#endif
-    return m_data.value[m_size++];
+    return unchecked_emplace_back(std::forward<Args>(args)...);
   }
 
   constexpr T& push_back(const T& x) { return emplace_back(x); }
   constexpr T& push_back(T&& x) { return emplace_back(std::move(x)); }
-  // template<container-compatible-range<T> R>
-  // constexpr void append_range(R&& rg);
+
+  // Append all of `rg`.  If the size of `rg` is known up front, capacity is
+  // checked once, before any element is appended; otherwise, each element is
+  // checked as it is appended.
+  template <__container_compatible_range<T> R>
+  constexpr void append_range(R&& rg)
+  {
+    if constexpr (ranges::sized_range<R>) {
+      check_size(m_size + size_type(ranges::size(rg)));
+      for (auto&& elem : rg)
+        unchecked_emplace_back(std::forward<decltype(elem)>(elem));
+    }
+    else {
+      for (auto&& elem : rg)
+        emplace_back(std::forward<decltype(elem)>(elem));
+    }
+  }
   constexpr void pop_back()
   {
-    m_data.value[--m_size].~T();
+    destroy_elem(m_data.value[--m_size]);
   }
 
+  // Fallible modifiers: return a null pointer instead of throwing if the
+  // vector is full.
   template<class... Args>
-  constexpr T* try_emplace_back(Args&&... args);
-  constexpr T* try_push_back(const T& x);
-  constexpr T* try_push_back(T&& x);
-  // template<container-compatible-range<T> R>
-  // constexpr ranges::borrowed_iterator_t<R> try_append_range(R&& rg);
+  constexpr T* try_emplace_back(Args&&... args)
+  {
+    if (m_size == N) [[unlikely]]
+      return nullptr;
+    return std::addressof(unchecked_emplace_back(std::forward<Args>(args)...));
+  }
+  constexpr T* try_push_back(const T& x) { return try_emplace_back(x); }
+  constexpr T* try_push_back(T&& x) { return try_emplace_back(std::move(x)); }
+
+  // Append elements of `rg` until either `rg` or the capacity is exhausted,
+  // returning an iterator to the first element of `rg` not appended.
+  template <__container_compatible_range<T> R>
+  constexpr ranges::borrowed_iterator_t<R> try_append_range(R&& rg)
+  {
+    auto first = ranges::begin(rg);
+    auto last  = ranges::end(rg);
+    for ( ; m_size != N && first != last; ++first)
+      unchecked_emplace_back(*first);
+    return first;
+  }
 
   template<class... Args>
   constexpr T& unchecked_emplace_back(Args&&... args)
@@ -576,25 +718,53 @@ public:
     { return unchecked_emplace_back(std::move(x)); }
 
   template <class... Args>
-  constexpr iterator emplace(const_iterator position, Args&&... args);
-  constexpr iterator insert(const_iterator position, const T& x);
-  constexpr iterator insert(const_iterator position, T&& x);
-  constexpr iterator insert(const_iterator position, size_type n, const T& x);
-  template <class InputIterator>
-  constexpr iterator insert(const_iterator position, InputIterator first, InputIterator last);
+  constexpr iterator emplace(const_iterator position, Args&&... args)
+  {
+    // Construct the new element at the end, then rotate it into place.
+    iterator pos = begin() + (position - cbegin());
+    emplace_back(std::forward<Args>(args)...);
+    std::rotate(pos, end() - 1, end());
+    return pos;
+  }
+  constexpr iterator insert(const_iterator position, const T& x)
+    { return emplace(position, x); }
+  constexpr iterator insert(const_iterator position, T&& x)
+    { return emplace(position, std::move(x)); }
+  constexpr iterator insert(const_iterator position, size_type n, const T& x)
+  {
+    iterator pos = begin() + (position - cbegin());
+    check_size(m_size + n);
+    size_type old_size = m_size;
+    while (n--)
+      unchecked_push_back(x);
+    std::rotate(pos, begin() + old_size, end());
+    return pos;
+  }
+  template <input_iterator InputIterator>
+  constexpr iterator insert(const_iterator position, InputIterator first, InputIterator last)
+  {
+    // Append the new elements, then rotate them into place.
+    iterator pos = begin() + (position - cbegin());
+    size_type old_size = m_size;
+    while (first != last)
+      emplace_back(*first++);
+    std::rotate(pos, begin() + old_size, end());
+    return pos;
+  }
   // template<container-compatible-range<T> R>
   // constexpr iterator insert_range(const_iterator position, R&& rg); //
 
-  constexpr iterator insert(const_iterator position, initializer_list<T> il);
+  constexpr iterator insert(const_iterator position, initializer_list<T> il)
+    { return insert(position, il.begin(), il.end()); }
   constexpr iterator erase(const_iterator position)
     { return erase(position, position + 1); }
   constexpr iterator erase(const_iterator first, const_iterator last) {
     size_type n = last - first;
     iterator first2 = begin() + (first - cbegin());
     iterator last2  = begin() + (last  - cbegin());
-    iterator ebeg   = move(last2, end(), first2);
+    iterator ebeg   = std::move(last2, end(), first2);
     for (iterator i = ebeg; i != end(); ++i)
-      i->~T();
+      destroy_elem(*i);
     m_size -= n;
     return first2;
   }
@@ -613,8 +783,8 @@ public:
     // conditionally swap allocators
     using AllocTraits = typename Base::AllocTraits;
     if constexpr (AllocTraits::propagate_on_container_swap::value &&
-                  ! AllocTraits::always_compare_equal::value)
-      swap(this->m_alloc, x.m_alloc);
+                  ! AllocTraits::is_always_equal::value)
+      std::swap(static_cast<Base&>(*this), static_cast<Base&>(x));
 #endif
 
     // Swap first n elements
@@ -638,8 +808,13 @@ public:
         return false;
     return true;
   }
-  // constexpr friend synth-three-way-result<T>
-  // operator<=>(const inplace_vector& x, const inplace_vector& y);
+  constexpr friend auto operator<=>(const inplace_vector& x,
+                                    const inplace_vector& y)
+    requires three_way_comparable<T>
+  {
+    return lexicographical_compare_three_way(x.begin(), x.end(),
+                                             y.begin(), y.end());
+  }
   constexpr friend void swap(inplace_vector& x, inplace_vector& y)
     noexcept(N == 0 || (is_nothrow_swappable_v<T> && is_nothrow_move_constructible_v<T>))
     { x.swap(y); }
@@ -647,6 +822,8 @@ public:
 
 }  // close namespace std::experimental
 
+#endif // ! defined(INCLUDED_INPLACE_VECTOR_DOT_H)
+
 // Local Variables:
 // c-basic-offset: 2
 // End:
@@ -0,0 +1,99 @@
+/* inplace_vector_append.b.cpp                                        -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Microbenchmark comparing the ways of appending to an `inplace_vector`:
+ * throwing (`push_back`), fallible (`try_push_back`, `try_append_range`),
+ * unchecked (`unchecked_push_back`), and bulk (`append_range`, which checks
+ * capacity once).  Each variant is a separate non-inlined function in
+ * namespace `appenders`, so that its code size can be read from the symbol
+ * table (see `make append-bench`, which also builds with `-fno-exceptions`).
+ */
+
+#include <inplace_vector.h>
+#include <span>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <cstdlib>
+
+namespace xstd = std::experimental;
+namespace chrono = std::chrono;
+
+constexpr std::size_t capacity = 256;
+using Vec = xstd::inplace_vector<int, capacity>;
+
+namespace appenders {
+
+[[gnu::noinline]] void pushBack(Vec& v, std::span<const int> src)
+{
+  for (int x : src)
+    v.push_back(x);
+}
+
+[[gnu::noinline]] bool tryPushBack(Vec& v, std::span<const int> src)
+{
+  for (int x : src)
+    if (! v.try_push_back(x))
+      return false;
+  return true;
+}
+
+[[gnu::noinline]] void uncheckedPushBack(Vec& v, std::span<const int> src)
+{
+  for (int x : src)
+    v.unchecked_push_back(x);
+}
+
+[[gnu::noinline]] void appendRange(Vec& v, std::span<const int> src)
+{
+  v.append_range(src);
+}
+
+[[gnu::noinline]] bool tryAppendRange(Vec& v, std::span<const int> src)
+{
+  return v.try_append_range(src) == src.end();
+}
+
+}  // close namespace appenders
+
+int reps = 100000;
+
+template <class F>
+void measure(const char* name, F f)
+{
+  static int src[capacity];
+  std::iota(src, src + capacity, 0);
+
+  auto best = chrono::nanoseconds::max();
+  for (int r = 0; r < reps; ++r) {
+    Vec v;
+    auto start = chrono::steady_clock::now();
+    f(v, std::span<const int>(src));
+    auto elapsed = chrono::steady_clock::now() - start;
+    best = std::min(best, chrono::duration_cast<chrono::nanoseconds>(elapsed));
+    if (v.size() != capacity) std::abort();
+  }
+
+  std::cout << "| " << name << " | " << double(best.count()) / capacity
+            << " |" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1)
+    reps = std::atoi(argv[1]);
+
+  std::cout << "| Function | Time (ns/elem) |\n"
+            << "| -------- | -------------: |" << std::endl;
+  measure("push_back",           appenders::pushBack);
+  measure("try_push_back",       appenders::tryPushBack);
+  measure("unchecked_push_back", appenders::uncheckedPushBack);
+  measure("append_range",        appenders::appendRange);
+  measure("try_append_range",    appenders::tryAppendRange);
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
@@ -0,0 +1,341 @@
+/* inplace_vector_constexpr.t.cpp                                     -*-C++-*-
+ *
+ * Copyright (C) 2024 Pablo Halpern <phalpern@halpernwightsoftware.com>
+ * Distributed under the Boost Software License - Version 1.0
+ *
+ * Test `inplace_vector` in constant evaluation.  Besides exercising the
+ * interface in `static_assert`s, this test builds two lookup tables entirely
+ * at compile time -- a minimal perfect hash of keywords and the state table
+ * of a small tokenizer -- and stores them in `constexpr` variables, which the
+ * compiler places in read-only data rather than initializing at startup.
+ */
+
+#include <inplace_vector.h>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cassert>
+
+namespace xstd = std::experimental;
+
+///////////////////////////////////////////////////////////////////////////////
+// Interface tests
+///////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+using ivec = xstd::inplace_vector<T, 10>;
+
+constexpr bool testModifiers()
+{
+  ivec<int> v{ 1, 2, 3 };
+  if (v.size() != 3 || v.at(2) != 3) return false;
+
+  v.push_back(4);                         // 1 2 3 4
+  v.emplace(v.begin(), 0);                // 0 1 2 3 4
+  v.insert(v.begin() + 2, 9);             // 0 1 9 2 3 4
+  v.insert(v.end(), 2, 7);                // 0 1 9 2 3 4 7 7
+  v.erase(v.begin() + 2);                 // 0 1 2 3 4 7 7
+  v.erase(v.end() - 2, v.end());          // 0 1 2 3 4
+  int more[] = { 5, 6 };
+  v.insert(v.end(), more, more + 2);      // 0 1 2 3 4 5 6
+  v.insert(v.begin(), { -2, -1 });        // -2 -1 0 1 2 3 4 5 6
+  v.pop_back();                           // -2 -1 0 1 2 3 4 5
+
+  if (v != ivec<int>{ -2, -1, 0, 1, 2, 3, 4, 5 }) return false;
+  if (*v.data() != -2 || v.front() != -2 || v.back() != 5) return false;
+
+  v.resize(3);
+  if (v != ivec<int>{ -2, -1, 0 }) return false;
+  v.resize(5, 8);
+  if (v != ivec<int>{ -2, -1, 0, 8, 8 }) return false;
+
+  ivec<int> w(4, 1);
+  v.swap(w);
+  if (v != ivec<int>{ 1, 1, 1, 1 } || w.size() != 5) return false;
+
+  v.assign({ 3, 2, 1 });
+  if (v != ivec<int>{ 3, 2, 1 }) return false;
+  if (! (w < v) || ! (v > ivec<int>{ 3, 2 })) return false;
+
+  v.clear();
+  return v.empty();
+}
+static_assert(testModifiers());
+
+constexpr bool testFallible()
+{
+  xstd::inplace_vector<int, 4> v;
+  int* p = v.try_push_back(1);
+  if (! p || *p != 1 || v.try_emplace_back(2) != &v[1]) return false;
+
+  const int more[] = { 3, 4, 5, 6 };
+  auto rest = v.try_append_range(more);   // Appends only 3 and 4
+  if (rest != more + 2 || v.size() != 4 || v.back() != 4) return false;
+  if (v.try_push_back(5) != nullptr || v.size() != 4) return false;
+
+  v.clear();
+  v.unchecked_push_back(9);
+  v.append_range(std::string_view("ab"));   // Sized range: checked once
+  if (v != xstd::inplace_vector<int, 4>{ 9, 'a', 'b' }) return false;
+
+  xstd::inplace_vector<int, 4> w(xstd::from_range, more);
+  return w.size() == 4 && w[3] == 6;
+}
+static_assert(testFallible());
+
+// Element types with non-trivial lifetimes can be used transiently.
+constexpr bool testStrings()
+{
+  ivec<std::string> v;
+  v.push_back("world");
+  v.insert(v.begin(), "hello");
+  v.emplace_back(3, '!');
+  v.erase(v.begin() + 1);
+
+  ivec<std::string> copy(v);
+  return copy.size() == 2 && copy[0] == "hello" && copy[1] == "!!!";
+}
+static_assert(testStrings());
+
+///////////////////////////////////////////////////////////////////////////////
+// Minimal perfect hash of keywords, using "hash and displace": keys are
+// distributed into buckets by one hash; then, largest bucket first, each
+// bucket is given a seed for a second hash that maps all of its keys to free
+// slots.  Single-key buckets simply take the next free slot.
+///////////////////////////////////////////////////////////////////////////////
+
+constexpr std::string_view keywords[] = {
+  "alignas", "auto", "bool", "break", "case", "catch", "char", "class",
+  "const", "constexpr", "continue", "default", "delete", "do", "double",
+  "else", "enum", "explicit", "false", "float", "for", "if", "inline", "int",
+  "long", "namespace", "new", "private", "return", "static", "struct",
+  "switch", "template", "this", "true", "using", "void", "while"
+};
+
+constexpr std::size_t numKeys    = std::size(keywords);
+constexpr std::size_t numBuckets = numKeys / 3 + 1;
+
+// FNV-1a, with a final avalanche so that the low bits depend on every byte.
+constexpr std::uint32_t hashKey(std::string_view s, std::uint32_t seed)
+{
+  std::uint32_t h = 2166136261u ^ (seed * 16777619u);
+  for (char c : s)
+    h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  return h;
+}
+
+struct KeywordTable
+{
+  // `seeds[b] >= 0` is the seed for bucket `b`; `seeds[b] < 0` encodes the
+  // slot `-seeds[b] - 1` for a bucket with exactly one key.
+  xstd::inplace_vector<std::int16_t, numBuckets> seeds;
+  xstd::inplace_vector<std::uint8_t, numKeys>    slots;  // slot -> keyword
+
+  constexpr int find(std::string_view s) const
+  {
+    std::int16_t seed = seeds[hashKey(s, 0) % numBuckets];
+    std::size_t  slot = seed < 0 ? -seed - 1 : hashKey(s, seed) % numKeys;
+    std::uint8_t k    = slots[slot];
+    return keywords[k] == s ? k : -1;
+  }
+};
+
+constexpr KeywordTable makeKeywordTable()
+{
+  using Bucket = xstd::inplace_vector<std::uint8_t, numKeys>;
+
+  xstd::inplace_vector<Bucket, numBuckets> buckets(numBuckets);
+  for (std::uint8_t k = 0; k < numKeys; ++k)
+    buckets[hashKey(keywords[k], 0) % numBuckets].push_back(k);
+
+  // Order the buckets from largest to smallest (insertion sort).
+  xstd::inplace_vector<std::uint8_t, numBuckets> order;
+  for (std::uint8_t b = 0; b < numBuckets; ++b) {
+    auto pos = order.begin();
+    while (pos != order.end() && buckets[*pos].size() >= buckets[b].size())
+      ++pos;
+    order.insert(pos, b);
+  }
+
+  constexpr std::uint8_t unused = 0xff;
+  KeywordTable table;
+  table.seeds.resize(numBuckets, 0);
+  table.slots.resize(numKeys, unused);
+
+  for (std::uint8_t b : order) {
+    const Bucket& bucket = buckets[b];
+    if (bucket.size() <= 1)
+      continue;   // Single-key buckets are handled below
+    bool placed = false;
+    for (std::int16_t seed = 1; ! placed; ++seed) {
+      Bucket trial;
+      for (std::uint8_t k : bucket) {
+        std::uint8_t slot = hashKey(keywords[k], seed) % numKeys;
+        if (table.slots[slot] != unused ||
+            std::find(trial.begin(), trial.end(), slot) != trial.end())
+          break;
+        trial.push_back(slot);
+      }
+      if (trial.size() == bucket.size()) {
+        for (std::size_t i = 0; i < bucket.size(); ++i)
+          table.slots[trial[i]] = bucket[i];
+        table.seeds[b] = seed;
+        placed = true;
+      }
+    }
+  }
+
+  // Give each single-key bucket one of the remaining free slots.
+  xstd::inplace_vector<std::uint8_t, numKeys> freeSlots;
+  for (std::uint8_t slot = 0; slot < numKeys; ++slot)
+    if (table.slots[slot] == unused)
+      freeSlots.push_back(slot);
+
+  for (std::uint8_t b : order) {
+    if (buckets[b].size() != 1)
+      continue;
+    std::uint8_t slot = freeSlots.back();
+    freeSlots.erase(freeSlots.end() - 1);
+    table.slots[slot] = buckets[b][0];
+    table.seeds[b]    = -std::int16_t(slot) - 1;
+  }
+
+  return table;
+}
+
+constexpr KeywordTable keywordTable = makeKeywordTable();
+
+static_assert(keywordTable.find("namespace") >= 0);
+static_assert(keywordTable.find("namespaces") < 0);
+
+///////////////////////////////////////////////////////////////////////////////
+// Tokenizer state table.  Transitions are given as a list of rules; later
+// rules override earlier ones.  The rules are sorted and de-duplicated, then
+// expanded into a dense `state x character-class` table in which a missing
+// transition (`st_end`) ends the current token.
+///////////////////////////////////////////////////////////////////////////////
+
+enum CharClass : std::uint8_t { cc_other, cc_space, cc_alpha, cc_digit,
+                                cc_dot, numCharClasses };
+enum State : std::uint8_t { st_start, st_space, st_ident, st_int, st_real,
+                            st_punct, st_end, numStates };
+
+struct Rule
+{
+  State     from;
+  CharClass cc;
+  State     to;
+
+  constexpr bool operator<(const Rule& r) const
+    { return from != r.from ? from < r.from : cc < r.cc; }
+};
+
+constexpr Rule rules[] = {
+  { st_start, cc_space, st_space }, { st_start, cc_alpha, st_ident },
+  { st_start, cc_digit, st_int   }, { st_start, cc_dot,   st_punct },
+  { st_start, cc_other, st_punct },
+  { st_space, cc_space, st_space },
+  { st_ident, cc_alpha, st_ident }, { st_ident, cc_digit, st_ident },
+  { st_int,   cc_digit, st_int   }, { st_int,   cc_dot,   st_real  },
+  { st_real,  cc_digit, st_real  },
+  { st_start, cc_dot,   st_real  },   // Overrides the rule above: ".5"
+};
+
+struct Tokenizer
+{
+  xstd::inplace_vector<std::uint8_t, 256> charClass;
+  xstd::inplace_vector<xstd::inplace_vector<State, numCharClasses>,
+                       numStates>         next;
+
+  // Return the number of tokens in `s`, not counting whitespace.
+  constexpr int countTokens(std::string_view s) const
+  {
+    int   tokens = 0;
+    State state  = st_start;
+    for (std::size_t i = 0; i < s.size(); ) {
+      State to = next[state][charClass[static_cast<unsigned char>(s[i])]];
+      if (to == st_end) {
+        // End of token; rescan the current character from the start state.
+        tokens += (state != st_space);
+        state = st_start;
+      }
+      else {
+        state = to;
+        ++i;
+      }
+    }
+    return tokens + (state != st_start && state != st_space);
+  }
+};
+
+constexpr Tokenizer makeTokenizer()
+{
+  Tokenizer t;
+
+  t.charClass.resize(256, cc_other);
+  for (char c : std::string_view(" \t\n"))
+    t.charClass[c] = cc_space;
+  for (unsigned char c = 'a'; c <= 'z'; ++c)
+    t.charClass[c] = t.charClass[c - 'a' + 'A'] = cc_alpha;
+  t.charClass['_'] = cc_alpha;
+  for (unsigned char c = '0'; c <= '9'; ++c)
+    t.charClass[c] = cc_digit;
+  t.charClass['.'] = cc_dot;
+
+  // Sort the rules, keeping only the last rule for each (state, class).
+  xstd::inplace_vector<Rule, std::size(rules)> sorted;
+  for (const Rule& r : rules) {
+    auto pos = std::lower_bound(sorted.begin(), sorted.end(), r);
+    if (pos != sorted.end() && ! (r < *pos))
+      pos = sorted.erase(pos);
+    sorted.insert(pos, r);
+  }
+
+  t.next.assign(numStates, xstd::inplace_vector<State, numCharClasses>(
+                  numCharClasses, st_end));
+  for (const Rule& r : sorted)
+    t.next[r.from][r.cc] = r.to;
+
+  return t;
+}
+
+constexpr Tokenizer tokenizer = makeTokenizer();
+
+static_assert(tokenizer.next[st_start][cc_dot] == st_real);
+static_assert(tokenizer.countTokens("int x2 = 42;") == 5);
+
+///////////////////////////////////////////////////////////////////////////////
+// Run-time tests, using the tables built at compile time
+///////////////////////////////////////////////////////////////////////////////
+
+void testKeywordTable()
+{
+  for (std::size_t k = 0; k < numKeys; ++k)
+    assert(keywordTable.find(keywords[k]) == int(k));
+
+  const char* nonKeywords[] = { "", "a", "autos", "Class", "whilst", "x" };
+  for (const char* s : nonKeywords)
+    assert(keywordTable.find(s) < 0);
+}
+
+void testTokenizer()
+{
+  std::string program = "while (count < 2.5) count += .5;";
+  assert(11 == tokenizer.countTokens(program));  // "+=" is two tokens
+  assert(2 == tokenizer.countTokens(" .5 3. "));
+  assert(0 == tokenizer.countTokens("   "));
+  assert(0 == tokenizer.countTokens(""));
+}
+
+int main()
+{
+  testKeywordTable();
+  testTokenizer();
+}
+
+// Local Variables:
+// c-basic-offset: 2
+// End:
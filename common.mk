@@ -3,6 +3,7 @@ CXX      ?= g++
 CXXOPT   ?= -g
 CXXSTD   ?= c++23
 CXXFLAGS ?= -Wall $(CXXOPT) -std=$(CXXSTD) -I.
+BENCHOPT ?= -O2 -DNDEBUG
 OBJDIR   ?= obj
 
 GIT_ROOT := $(shell git rev-parse --show-toplevel)
@@ -11,6 +12,7 @@ FROM_MD = $(GIT_ROOT)/make-from-md.py
 vpath %.cpp .
 vpath %.h .
 vpath %.t $(OBJDIR)
+vpath %.b $(OBJDIR)
 vpath %.o $(OBJDIR)
 
 # Remember compiler and flags from previous run. If they change, regenerate
@@ -37,6 +39,13 @@ $(CXX_CONFIG_FILE) : $(REBUILD_CONFIG)
 %.t : %.t.cpp *.h $(CXX_CONFIG_FILE)
 	$(CXX) $(CXXFLAGS) -o $(OBJDIR)/$@ $<
 
+# Benchmarks (`*.b.cpp`) are always built optimized.
+%.bench : %.b
+	$(OBJDIR)/$*.b $(BENCH_ARGS)
+
+%.b : %.b.cpp *.h $(CXX_CONFIG_FILE)
+	$(CXX) $(CXXFLAGS) $(BENCHOPT) -o $(OBJDIR)/$@ $<
+
 %.html : %.md
 	$(FROM_MD) --html $<
 
@@ -50,9 +59,9 @@ $(CXX_CONFIG_FILE) : $(REBUILD_CONFIG)
 	$(FROM_MD) --pdf --view $<
 
 clean : .FORCE
-	rm -rf $(OBJDIR)/*.t $(OBJDIR)/*.o
+	rm -rf $(OBJDIR)/*.t $(OBJDIR)/*.b $(OBJDIR)/*.o
 	rm -rf generated/*.html generated/*.pdf
 
 .FORCE:
 
-.PRECIOUS: %.t %.html %.pdf
+.PRECIOUS: %.t %.b %.html %.pdf
@@ -0,0 +1,313 @@
+#! /usr/bin/python3
+
+# Measure the build cost of the test drivers (`*.t.cpp`) in this repository.
+#
+# Usage: compile_perf.py [ options ] [ source.t.cpp ... ]
+#
+# Each source file is compiled (but not linked) as a separate translation
+# unit.  For each TU, the following are recorded:
+#
+#  * user + system CPU time of the compiler (seconds)
+#  * peak resident set size of the compiler (KiB)
+#  * object-file size and `text` size as reported by `size` (bytes; this
+#    includes `.rodata` as well as `.text`)
+#  * with `--time-trace` (clang only), the template instantiations that took
+#    the most time, as reported by `-ftime-trace`.
+#
+# If no source files are specified, every `*.t.cpp` under git control is
+# measured.  Each source file is compiled from within its own directory, with
+# `-I.` added to the command line, matching the `common.mk` build.
+#
+# Results are printed as a markdown table and, unless `--no-history` is given,
+# appended as one JSON object per line to a history file (default
+# `compile_perf_history.jsonl` in the repository root), tagged with the
+# current git commit.  `--compare REV` prints the change in each metric
+# relative to the most recent history entry for commit `REV` (default: the
+# most recent entry for any other commit) that was recorded with the same
+# compiler flags and `-D` definitions.
+#
+# This file can also be imported as a module; `measureCommand` and `compileTU`
+# are used by per-prototype scripts such as
+# `P3160-AA-inplace_vector/compile-time_test.py`.
+
+import sys
+import os
+import json
+import time
+import shlex
+import argparse
+import functools
+import tempfile
+import subprocess
+
+defaultFlags = [ "-std=c++23", "-Wall", "-O2" ]
+
+@functools.cache
+def gitRoot():
+    """Return the root of the repository containing this script, wherever it
+    is run from."""
+    here = os.path.dirname(os.path.abspath(__file__))
+    return subprocess.run([ "git", "rev-parse", "--show-toplevel" ],
+                          cwd=here, capture_output=True, text=True,
+                          check=True).stdout.strip()
+
+def gitCommit():
+    """Return the abbreviated hash of HEAD, with a `+` suffix if the working
+    tree has uncommitted changes."""
+    head = subprocess.run([ "git", "rev-parse", "--short", "HEAD" ],
+                          cwd=gitRoot(), capture_output=True,
+                          text=True).stdout.strip()
+    dirty = subprocess.run([ "git", "diff", "--quiet", "HEAD" ],
+                           cwd=gitRoot()).returncode
+    return head + ("+" if dirty else "")
+
+class Measurement:
+    """Resource usage of one (possibly multi-process) command."""
+    def __init__(self, returncode, userTime, sysTime, wallTime, maxRssKiB,
+                 stderr):
+        self.returncode = returncode
+        self.userTime   = userTime
+        self.sysTime    = sysTime
+        self.wallTime   = wallTime
+        self.maxRssKiB  = maxRssKiB
+        self.stderr     = stderr
+
+    def cpuTime(self):
+        return self.userTime + self.sysTime
+
+def measureCommand(cmdLine, cwd=None):
+    """Run `cmdLine` and return a `Measurement`.  The rusage returned by
+    `wait4` includes every descendant that the child waited for, so the
+    compiler proper (e.g., `cc1plus`) is accounted for even though it is
+    spawned by the driver.  On Linux, `ru_maxrss` is in KiB."""
+    start = time.monotonic()
+    proc  = subprocess.Popen(cmdLine, cwd=cwd, stdout=subprocess.DEVNULL,
+                             stderr=subprocess.PIPE, text=True)
+    stderr = proc.stderr.read()
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall = time.monotonic() - start
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    return Measurement(proc.returncode, usage.ru_utime, usage.ru_stime, wall,
+                       usage.ru_maxrss, stderr)
+
+def textSize(objFile):
+    """Return the `text` column reported by `size` for `objFile` (the size of
+    `.text` plus read-only data such as `.rodata`), or `None` if `size` is
+    not available."""
+    try:
+        out = subprocess.run([ "size", objFile ], capture_output=True,
+                             text=True, check=True).stdout.splitlines()
+        return int(out[1].split()[0])
+    except (OSError, subprocess.CalledProcessError, IndexError, ValueError):
+        return None
+
+def supportsTimeTrace(compiler):
+    """Return `True` if `compiler` accepts `-ftime-trace` (clang >= 9)."""
+    res = subprocess.run([ compiler, "-x", "c++", "-ftime-trace", "-fsyntax-only",
+                           "-" ], input="", capture_output=True, text=True)
+    return res.returncode == 0
+
+def instantiationHotSpots(traceFile, count):
+    """Read a clang `-ftime-trace` JSON file and return the `count` template
+    instantiations with the largest total time, as a list of
+    `(milliseconds, kind, name)` tuples."""
+    try:
+        with open(traceFile) as f:
+            events = json.load(f)["traceEvents"]
+    except (OSError, ValueError, KeyError):
+        return [ ]
+
+    totals = { }
+    for ev in events:
+        kind = ev.get("name", "")
+        if ev.get("ph") != "X" or not kind.startswith("Instantiate"):
+            continue
+        key = (kind, ev.get("args", {}).get("detail", "?"))
+        totals[key] = totals.get(key, 0) + ev.get("dur", 0)
+
+    hot = sorted(totals.items(), key=lambda kv: kv[1], reverse=True)[:count]
+    return [ (round(us / 1000, 1), kind, name) for (kind, name), us in hot ]
+
+def compileTU(compiler, flags, srcFile, objDir, repeat=1, timeTrace=False,
+              hotSpotCount=10):
+    """Compile `srcFile` to an object file in `objDir` `repeat` times and
+    return a dictionary of results.  Times are the minimum over all
+    repetitions; the peak RSS is the maximum."""
+    srcFile = os.path.abspath(srcFile)
+    srcDir  = os.path.dirname(srcFile)
+    base    = os.path.basename(srcFile).removesuffix(".cpp")
+    objFile = os.path.join(objDir, base + ".o")
+    cmdLine = [ compiler ] + flags + [ "-I.", "-c", srcFile, "-o", objFile ]
+    if timeTrace:
+        cmdLine.append("-ftime-trace")
+
+    result = { "file": os.path.relpath(srcFile, gitRoot()),
+               "compiler": compiler, "status": "ok" }
+    runs = [ measureCommand(cmdLine, cwd=srcDir) for _ in range(repeat) ]
+    failed = [ m for m in runs if m.returncode != 0 ]
+    if failed:
+        result["status"] = "error"
+        errors = [ line for line in failed[0].stderr.splitlines()
+                   if "error" in line ]
+        result["error"]  = errors[:1]
+        return result
+
+    result["cpu_s"]     = round(min(m.cpuTime() for m in runs), 3)
+    result["wall_s"]    = round(min(m.wallTime for m in runs), 3)
+    result["rss_kib"]   = max(m.maxRssKiB for m in runs)
+    result["obj_bytes"] = os.path.getsize(objFile)
+    result["text_bytes"] = textSize(objFile)
+    if timeTrace:
+        traceFile = objFile.removesuffix(".o") + ".json"
+        result["hot_spots"] = instantiationHotSpots(traceFile, hotSpotCount)
+    return result
+
+def findTestDrivers(root):
+    out = subprocess.run([ "git", "ls-files", "*.t.cpp" ], cwd=root,
+                         capture_output=True, text=True, check=True).stdout
+    return [ os.path.join(root, f) for f in out.split() ]
+
+def loadHistory(historyFile):
+    entries = [ ]
+    try:
+        with open(historyFile) as f:
+            for line in f:
+                if line.strip():
+                    entries.append(json.loads(line))
+    except OSError:
+        pass
+    return entries
+
+def findBaseline(history, compareRev, currentCommit, flags):
+    """Return the most recent history entry recorded with `flags` for
+    `compareRev`, or, if `compareRev` is empty, the most recent such entry for
+    a commit other than `currentCommit`.  Entries recorded with different
+    flags or definitions measure a different configuration and are never
+    compared."""
+    history = [ e for e in history if e.get("flags") == flags ]
+    if compareRev:
+        rev = subprocess.run([ "git", "rev-parse", "--short", compareRev ],
+                             cwd=gitRoot(), capture_output=True,
+                             text=True).stdout.strip()
+        matches = [ e for e in history
+                    if e["commit"].rstrip("+") in (rev, compareRev) ]
+    else:
+        matches = [ e for e in history if e["commit"] != currentCommit ]
+    return matches[-1] if matches else None
+
+def percent(new, old):
+    if not old or new is None:
+        return ""
+    return f"{round((new / old) * 100 - 100):+d}%"
+
+def resultKey(result, flags):
+    """Return the key identifying the configuration measured by `result`."""
+    return (result["file"], result["compiler"], tuple(flags))
+
+def printTable(results, flags, baseline):
+    old = { }
+    if baseline:
+        old = { resultKey(r, baseline["flags"]): r
+                for r in baseline["results"] }
+        print(f"\nCompared against commit {baseline['commit']} "
+              f"({baseline['date']})\n")
+
+    print("| TU | Compiler | CPU (s) | Peak RSS (MiB) | Object (KiB) | "
+          "text+rodata (size) (KiB) |" +
+          (" CPU | RSS | text+rodata |" if baseline else ""))
+    print("| -- | -------- | ------: | -------------: | -----------: | "
+          "-----------------------: |" +
+          (" --: | --: | ----------: |" if baseline else ""))
+    for r in results:
+        if r["status"] != "ok":
+            err = (r.get("error") or [ "" ])[0].replace("|", "\\|")[:60]
+            print(f"| {r['file']} | {r['compiler']} | error: {err} | | | |" +
+                  (" | | |" if baseline else ""))
+            continue
+        text = r["text_bytes"]
+        row = (f"| {r['file']} | {r['compiler']} | {r['cpu_s']} | "
+               f"{r['rss_kib'] / 1024:.1f} | {r['obj_bytes'] / 1024:.1f} | "
+               + (f"{text / 1024:.1f}" if text is not None else "") + " |")
+        if baseline:
+            o = old.get(resultKey(r, flags))
+            if o and o["status"] == "ok":
+                row += (f" {percent(r['cpu_s'], o['cpu_s'])} |"
+                        f" {percent(r['rss_kib'], o['rss_kib'])} |"
+                        f" {percent(text, o.get('text_bytes'))} |")
+            else:
+                row += " new | | |"
+        print(row)
+
+    for r in results:
+        if r.get("hot_spots"):
+            print(f"\n**Instantiation hot spots: {r['file']} "
+                  f"({r['compiler']})**\n")
+            print("| Time (ms) | Kind | Template |\n"
+                  "| --------: | ---- | -------- |")
+            for ms, kind, name in r["hot_spots"]:
+                print(f"| {ms} | {kind} | `{name}` |")
+
+def main():
+    root = gitRoot()
+    parser = argparse.ArgumentParser(
+        description="Measure per-TU compile cost of the repository's tests")
+    parser.add_argument("sources", nargs="*",
+                        help="source files (default: all *.t.cpp in the repo)")
+    parser.add_argument("--cxx", action="append",
+                        help="compiler to use (repeatable; default g++)")
+    parser.add_argument("--flags", default=" ".join(defaultFlags),
+                        help="compiler flags (default: %(default)s)")
+    parser.add_argument("-D", dest="defines", action="append", default=[],
+                        help="add a preprocessor definition (repeatable)")
+    parser.add_argument("--repeat", type=int, default=1,
+                        help="compile each TU N times and keep the minimum")
+    parser.add_argument("--time-trace", action="store_true",
+                        help="collect -ftime-trace hot spots (clang only)")
+    parser.add_argument("--hot-spots", type=int, default=10,
+                        help="number of instantiation hot spots to report")
+    parser.add_argument("--history",
+                        default=os.path.join(root, "compile_perf_history.jsonl"),
+                        help="history file (default: %(default)s)")
+    parser.add_argument("--no-history", action="store_true",
+                        help="do not append results to the history file")
+    parser.add_argument("--compare", nargs="?", const="", default=None,
+                        metavar="REV",
+                        help="compare against a previous commit's results")
+    args = parser.parse_args()
+
+    compilers = args.cxx or [ "g++" ]
+    flags     = shlex.split(args.flags) + [ "-D" + d for d in args.defines ]
+    sources   = args.sources or findTestDrivers(root)
+    commit    = gitCommit()
+
+    results = [ ]
+    with tempfile.TemporaryDirectory(prefix="compile_perf.") as objDir:
+        for compiler in compilers:
+            timeTrace = args.time_trace and supportsTimeTrace(compiler)
+            if args.time_trace and not timeTrace:
+                print(f"note: {compiler} does not support -ftime-trace",
+                      file=sys.stderr)
+            for src in sources:
+                print(f"compiling {src} with {compiler}", file=sys.stderr)
+                results.append(compileTU(compiler, flags, src, objDir,
+                                         args.repeat, timeTrace,
+                                         args.hot_spots))
+
+    baseline = None
+    if args.compare is not None:
+        baseline = findBaseline(loadHistory(args.history), args.compare,
+                                commit, flags)
+        if baseline is None:
+            print("note: no history entry to compare against", file=sys.stderr)
+
+    printTable(results, flags, baseline)
+
+    if not args.no_history:
+        entry = { "commit": commit,
+                  "date": time.strftime("%Y-%m-%d %H:%M:%S"),
+                  "flags": flags, "results": results }
+        with open(args.history, "a") as f:
+            print(json.dumps(entry), file=f)
+
+if __name__ == "__main__":
+    main()